@@ -0,0 +1,179 @@
+//========================================================================
+//
+// BufferPool.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "poppler/goo/gmem.h"
+#include "BufferPool.h"
+
+//------------------------------------------------------------------------
+
+// The smallest size class is 2^bufferPoolMinShift bytes.
+#define bufferPoolMinShift 12
+
+// Each buffer is preceded by a header, padded to keep the buffer
+// suitably aligned.
+#define bufferPoolHeaderSize 32
+
+// Buffers at least this large are mapped directly.
+#define bufferPoolMapThreshold (8 * 1024 * 1024)
+
+// Size class marks for buffers that aren't pooled.
+#define bufferPoolClassHeap -1	// allocated with gmalloc
+#define bufferPoolClassMapped -2	// allocated with mmap
+
+struct BufferPoolBlock {
+  BufferPoolBlock *next;	// next free block in this class
+  size_t size;			// class size
+  int cls;			// size class, or bufferPoolClassHeap or
+				//   bufferPoolClassMapped
+};
+
+//------------------------------------------------------------------------
+// BufferPool
+//------------------------------------------------------------------------
+
+BufferPool::BufferPool(size_t maxFreeA) {
+  int i;
+
+  for (i = 0; i < bufferPoolNClasses; ++i) {
+    freeLists[i] = NULL;
+  }
+  maxFree = maxFreeA;
+  nAllocs = nReused = nMapped = 0;
+  usedBytes = maxUsedBytes = 0;
+  freeBytes = maxFreeBytes = 0;
+}
+
+BufferPool::~BufferPool() {
+  flush();
+}
+
+void *BufferPool::alloc(size_t size) {
+  BufferPoolBlock *blk;
+  size_t classSize;
+  int cls;
+
+  ++nAllocs;
+  if (size >= bufferPoolMapThreshold && (blk = mapBlock(size))) {
+    ++nMapped;
+    usedBytes += blk->size;
+    if (usedBytes > maxUsedBytes) {
+      maxUsedBytes = usedBytes;
+    }
+    return (char *)blk + bufferPoolHeaderSize;
+  }
+  cls = getClass(size, &classSize);
+  if (cls >= 0 && freeLists[cls]) {
+    blk = freeLists[cls];
+    freeLists[cls] = blk->next;
+    freeBytes -= classSize;
+    ++nReused;
+  } else {
+    blk = (BufferPoolBlock *)gmalloc(bufferPoolHeaderSize + classSize);
+    blk->size = classSize;
+    blk->cls = cls;
+  }
+  blk->next = NULL;
+  usedBytes += classSize;
+  if (usedBytes > maxUsedBytes) {
+    maxUsedBytes = usedBytes;
+  }
+  return (char *)blk + bufferPoolHeaderSize;
+}
+
+void BufferPool::release(void *p) {
+  BufferPoolBlock *blk;
+
+  if (!p) {
+    return;
+  }
+  blk = (BufferPoolBlock *)((char *)p - bufferPoolHeaderSize);
+  usedBytes -= blk->size;
+  if (blk->cls == bufferPoolClassMapped) {
+    munmap(blk, blk->size);
+    return;
+  }
+  if (blk->cls < 0 || freeBytes + blk->size > maxFree) {
+    gfree(blk);
+    return;
+  }
+  blk->next = freeLists[blk->cls];
+  freeLists[blk->cls] = blk;
+  freeBytes += blk->size;
+  if (freeBytes > maxFreeBytes) {
+    maxFreeBytes = freeBytes;
+  }
+}
+
+void BufferPool::flush() {
+  BufferPoolBlock *blk;
+  int i;
+
+  for (i = 0; i < bufferPoolNClasses; ++i) {
+    while ((blk = freeLists[i])) {
+      freeLists[i] = blk->next;
+      gfree(blk);
+    }
+  }
+  freeBytes = 0;
+}
+
+// Find the size class for a <size>-byte buffer: a multiple of 2^(e-2)
+// in (2^e, 2^(e+1)], so no more than 25% is wasted.  Returns
+// bufferPoolClassHeap (with *<classSize> = <size>) for sizes too large
+// to pool.
+int BufferPool::getClass(size_t size, size_t *classSize) {
+  size_t step;
+  int e, k, cls;
+
+  if (size <= ((size_t)1 << bufferPoolMinShift)) {
+    *classSize = (size_t)1 << bufferPoolMinShift;
+    return 0;
+  }
+  for (e = bufferPoolMinShift; ((size_t)2 << e) < size; ++e) ;
+  step = (size_t)1 << (e - 2);
+  k = (int)((size - ((size_t)1 << e) + step - 1) / step);
+  cls = (e - bufferPoolMinShift) * 4 + k;
+  if (cls >= bufferPoolNClasses) {
+    *classSize = size;
+    return bufferPoolClassHeap;
+  }
+  *classSize = ((size_t)1 << e) + k * step;
+  return cls;
+}
+
+// Map a block for a <size>-byte buffer, rounded up to whole pages.
+// Returns NULL if the mapping fails (the caller then falls back to
+// the heap).
+BufferPoolBlock *BufferPool::mapBlock(size_t size) {
+  BufferPoolBlock *blk;
+  size_t pageSize, mapSize;
+  void *p;
+
+  pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  mapSize = (bufferPoolHeaderSize + size + pageSize - 1) & ~(pageSize - 1);
+  p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+	   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(p, mapSize, MADV_HUGEPAGE);
+#endif
+  blk = (BufferPoolBlock *)p;
+  blk->next = NULL;
+  blk->size = mapSize;
+  blk->cls = bufferPoolClassMapped;
+  return blk;
+}
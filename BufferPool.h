@@ -0,0 +1,79 @@
+//========================================================================
+//
+// BufferPool.h
+//
+//========================================================================
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+
+struct BufferPoolBlock;
+
+#define bufferPoolNClasses 128
+
+//------------------------------------------------------------------------
+// BufferPool
+//------------------------------------------------------------------------
+
+// A size-classed pool of large buffers, used for the pixel storage
+// that is allocated and freed for every tile (XImage data, compression
+// buffers).  Sizes are rounded up to one of four classes per power of
+// two, starting at 4 KB, and released buffers are kept on a free list
+// per class, up to a total size limit, so that tiles of the same size
+// keep reusing the same memory instead of churning the heap.
+//
+// Very large buffers (e.g., for a tile at a high zoom factor) are
+// instead mapped directly, with transparent huge pages where
+// available, and unmapped as soon as they are released, so they never
+// stay in the process after the tile is gone.
+class BufferPool {
+public:
+
+  // Keep at most <maxFreeA> bytes of unused buffers.
+  BufferPool(size_t maxFreeA);
+  ~BufferPool();
+
+  // Return a buffer of at least <size> bytes.
+  void *alloc(size_t size);
+
+  // Return <p>, which must have come from alloc(), to the pool.  Does
+  // nothing if <p> is NULL.
+  void release(void *p);
+
+  // Free all of the unused buffers.
+  void flush();
+
+  //----- statistics
+
+  int getNAllocs() { return nAllocs; }
+  int getNReused() { return nReused; }
+  int getNMapped() { return nMapped; }
+  double getUsedBytes() { return usedBytes; }
+  double getMaxUsedBytes() { return maxUsedBytes; }
+  double getFreeBytes() { return freeBytes; }
+  double getMaxFreeBytes() { return maxFreeBytes; }
+
+private:
+
+  static int getClass(size_t size, size_t *classSize);
+  static BufferPoolBlock *mapBlock(size_t size);
+
+  BufferPoolBlock *freeLists[bufferPoolNClasses];
+  size_t maxFree;
+  int nAllocs;			// calls to alloc()
+  int nReused;			// ... of which were served from the pool
+  int nMapped;			// ... of which were mapped directly
+  double usedBytes, maxUsedBytes; // bytes handed out (and high-water mark)
+  double freeBytes, maxFreeBytes; // bytes on the free lists (and
+				  //   high-water mark)
+};
+
+#endif
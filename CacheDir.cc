@@ -0,0 +1,359 @@
+//========================================================================
+//
+// CacheDir.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "poppler/goo/gmem.h"
+#include "poppler/goo/GooString.h"
+#include "poppler/goo/GooHash.h"
+#include "poppler/goo/gfile.h"
+#include "CacheDir.h"
+
+//------------------------------------------------------------------------
+
+// Temporary files are named with this prefix, plus the mkstemp
+// suffix.
+#define cacheDirTmpPrefix "tmp-"
+
+// Temporary files older than this (in seconds) were left behind by a
+// process that died while writing, and are removed by scan().
+#define cacheDirStaleTmpAge 3600
+
+// When the directory is over one of its limits, remove files until it
+// is under this fraction of the limit, so that it isn't trimmed again
+// on every write.
+#define cacheDirTrimFactor 0.9
+
+struct CacheDirEntry {
+  GooString *name;		// file name, without the directory
+  double size;			// file size, in bytes
+  CacheDirEntry *prev, *next;	// LRU list links
+};
+
+struct CacheDirFile {
+  GooString *name;
+  time_t mtime;
+  double size;
+};
+
+static int cmpCacheDirFiles(const void *p1, const void *p2) {
+  const CacheDirFile *f1 = (const CacheDirFile *)p1;
+  const CacheDirFile *f2 = (const CacheDirFile *)p2;
+
+  if (f1->mtime < f2->mtime) {
+    return -1;
+  }
+  if (f1->mtime > f2->mtime) {
+    return 1;
+  }
+  return 0;
+}
+
+static bool hasSuffix(const char *name, const char *suffix) {
+  int n, m;
+
+  n = strlen(name);
+  m = strlen(suffix);
+  return n > m && !strcmp(name + n - m, suffix);
+}
+
+//------------------------------------------------------------------------
+// CacheDir
+//------------------------------------------------------------------------
+
+CacheDir::CacheDir(GooString *dirA, const char *suffixA,
+		   double maxSizeA, int maxFilesA) {
+  dir = dirA;
+  suffix = suffixA;
+  maxSize = maxSizeA;
+  maxFiles = maxFilesA;
+  size = 0;
+  nFiles = 0;
+  entries = new GooHash(true);
+  lruHead = lruTail = NULL;
+  pthread_mutex_init(&mutex, NULL);
+  mkdir(dir->getCString(), 0700);
+  scan();
+}
+
+CacheDir::~CacheDir() {
+  CacheDirEntry *entry;
+
+  while ((entry = lruHead)) {
+    lruHead = entry->next;
+    delete entry->name;
+    delete entry;
+  }
+  delete entries;
+  pthread_mutex_destroy(&mutex);
+  delete dir;
+}
+
+// Map <key> to a file name, using a 64-bit FNV-1a hash.
+GooString *CacheDir::getName(GooString *key) {
+  unsigned long long h;
+  char buf[32];
+  int i;
+
+  h = 14695981039346656037ULL;
+  for (i = 0; i < key->getLength(); ++i) {
+    h ^= (unsigned char)key->getChar(i);
+    h *= 1099511628211ULL;
+  }
+  sprintf(buf, "%016llx", h);
+  return (new GooString(buf))->append(suffix);
+}
+
+GooString *CacheDir::getPath(GooString *key) {
+  GooString *name, *path;
+
+  name = getName(key);
+  path = appendToPath(dir->copy(), name->getCString());
+  delete name;
+  return path;
+}
+
+bool CacheDir::write(GooString *key, const void **bufs, const size_t *lens,
+		     int nBufs) {
+  GooString *name, *path, *tmpPath;
+  CacheDirEntry *entry;
+  const char *p;
+  size_t n;
+  ssize_t k;
+  double total;
+  bool ok;
+  int fd, i;
+
+  tmpPath = appendToPath(dir->copy(), cacheDirTmpPrefix "XXXXXX");
+  if ((fd = mkstemp(tmpPath->getCString())) < 0) {
+    delete tmpPath;
+    return false;
+  }
+  ok = true;
+  total = 0;
+  for (i = 0; ok && i < nBufs; ++i) {
+    p = (const char *)bufs[i];
+    n = lens[i];
+    while (n > 0) {
+      if ((k = ::write(fd, p, n)) < 0) {
+	if (errno == EINTR) {
+	  continue;
+	}
+	ok = false;
+	break;
+      }
+      p += k;
+      n -= k;
+    }
+    total += lens[i];
+  }
+  if (close(fd) != 0) {
+    ok = false;
+  }
+  name = getName(key);
+  path = appendToPath(dir->copy(), name->getCString());
+  if (ok && rename(tmpPath->getCString(), path->getCString()) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    unlink(tmpPath->getCString());
+  }
+  delete path;
+  delete tmpPath;
+
+  if (ok) {
+    pthread_mutex_lock(&mutex);
+    if ((entry = (CacheDirEntry *)entries->lookup(name))) {
+      size += total - entry->size;
+      entry->size = total;
+      unlinkEntry(entry);
+      appendEntry(entry);
+      delete name;
+    } else {
+      addEntry(name, total);
+    }
+    if (isOverLimit(1)) {
+      trim();
+    }
+    pthread_mutex_unlock(&mutex);
+  } else {
+    delete name;
+  }
+  return ok;
+}
+
+void CacheDir::touch(GooString *key) {
+  GooString *name, *path;
+  CacheDirEntry *entry;
+
+  name = getName(key);
+  path = appendToPath(dir->copy(), name->getCString());
+  utime(path->getCString(), NULL);
+  delete path;
+  pthread_mutex_lock(&mutex);
+  if ((entry = (CacheDirEntry *)entries->lookup(name))) {
+    unlinkEntry(entry);
+    appendEntry(entry);
+  }
+  pthread_mutex_unlock(&mutex);
+  delete name;
+}
+
+void CacheDir::remove(GooString *key) {
+  GooString *name, *path;
+  CacheDirEntry *entry;
+
+  name = getName(key);
+  path = appendToPath(dir->copy(), name->getCString());
+  unlink(path->getCString());
+  delete path;
+  pthread_mutex_lock(&mutex);
+  if ((entry = (CacheDirEntry *)entries->lookup(name))) {
+    removeEntry(entry);
+  }
+  pthread_mutex_unlock(&mutex);
+  delete name;
+}
+
+// Build the LRU list from the cache files, oldest first, and remove
+// any stale temporary files.
+void CacheDir::scan() {
+  DIR *d;
+  struct dirent *ent;
+  CacheDirFile *files;
+  GooString *path;
+  struct stat st;
+  time_t now;
+  int filesSize, n, i;
+
+  if (!(d = opendir(dir->getCString()))) {
+    return;
+  }
+  files = NULL;
+  n = filesSize = 0;
+  now = time(NULL);
+  while ((ent = readdir(d))) {
+    if (!strncmp(ent->d_name, cacheDirTmpPrefix,
+		 strlen(cacheDirTmpPrefix))) {
+      path = appendToPath(dir->copy(), ent->d_name);
+      if (stat(path->getCString(), &st) == 0 &&
+	  now - st.st_mtime > cacheDirStaleTmpAge) {
+	unlink(path->getCString());
+      }
+      delete path;
+    } else if (hasSuffix(ent->d_name, suffix)) {
+      path = appendToPath(dir->copy(), ent->d_name);
+      if (stat(path->getCString(), &st) == 0) {
+	if (n == filesSize) {
+	  filesSize = filesSize ? 2 * filesSize : 64;
+	  files = (CacheDirFile *)greallocn(files, filesSize,
+					    sizeof(CacheDirFile));
+	}
+	files[n].name = new GooString(ent->d_name);
+	files[n].mtime = st.st_mtime;
+	files[n].size = st.st_size;
+	++n;
+      }
+      delete path;
+    }
+  }
+  closedir(d);
+
+  qsort(files, n, sizeof(CacheDirFile), &cmpCacheDirFiles);
+  for (i = 0; i < n; ++i) {
+    addEntry(files[i].name, files[i].size);
+  }
+  gfree(files);
+  if (isOverLimit(1)) {
+    trim();
+  }
+}
+
+// Remove the least recently used files until the directory is under
+// cacheDirTrimFactor of its limits.  The mutex must be locked (or
+// the CacheDir still being constructed).
+void CacheDir::trim() {
+  GooString *path;
+
+  while (lruHead && isOverLimit(cacheDirTrimFactor)) {
+    path = appendToPath(dir->copy(), lruHead->name->getCString());
+    unlink(path->getCString());
+    delete path;
+    removeEntry(lruHead);
+  }
+}
+
+// Returns true if the directory is over <factor> times either of its
+// limits.
+bool CacheDir::isOverLimit(double factor) {
+  return (maxSize > 0 && size > factor * maxSize) ||
+         (maxFiles > 0 && nFiles > factor * maxFiles);
+}
+
+// Add a file <name> (which is taken over) of <entrySize> bytes, as the
+// most recently used one.
+void CacheDir::addEntry(GooString *name, double entrySize) {
+  CacheDirEntry *entry;
+
+  entry = new CacheDirEntry;
+  entry->name = name;
+  entry->size = entrySize;
+  entries->add(name->copy(), entry);
+  appendEntry(entry);
+  size += entrySize;
+  ++nFiles;
+}
+
+// Take <entry> out of the LRU list.
+void CacheDir::unlinkEntry(CacheDirEntry *entry) {
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    lruHead = entry->next;
+  }
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    lruTail = entry->prev;
+  }
+  entry->prev = entry->next = NULL;
+}
+
+// Put <entry> at the most recently used end of the LRU list.
+void CacheDir::appendEntry(CacheDirEntry *entry) {
+  entry->prev = lruTail;
+  entry->next = NULL;
+  if (lruTail) {
+    lruTail->next = entry;
+  } else {
+    lruHead = entry;
+  }
+  lruTail = entry;
+}
+
+// Forget about <entry>, whose file has been removed, and free it.
+void CacheDir::removeEntry(CacheDirEntry *entry) {
+  unlinkEntry(entry);
+  entries->remove(entry->name);
+  size -= entry->size;
+  --nFiles;
+  delete entry->name;
+  delete entry;
+}
@@ -0,0 +1,90 @@
+//========================================================================
+//
+// CacheDir.h
+//
+//========================================================================
+
+#ifndef CACHEDIR_H
+#define CACHEDIR_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include <pthread.h>
+
+class GooString;
+class GooHash;
+struct CacheDirEntry;
+
+//------------------------------------------------------------------------
+// CacheDir
+//------------------------------------------------------------------------
+
+// A directory of cache files, each named after a hash of its key.  A
+// file is written to a temporary file (from mkstemp) and then renamed
+// into place, so a reader -- possibly in another process -- never
+// sees a partial file.  The modification time serves as the last use
+// time: when the directory goes over its size or file count limit,
+// the least recently used files are removed.
+//
+// The directory is only read once, when the CacheDir is created;
+// after that, the files are tracked in an in-memory LRU list, so
+// trimming only has to remove the files at the head of the list.
+// (Files written by other processes are picked up the next time the
+// directory is scanned.)  All of the functions can be called from any
+// thread.
+class CacheDir {
+public:
+
+  // Use directory <dirA> (which is created if needed), for files
+  // whose names end with <suffixA>.  Keep it under <maxSizeA> bytes
+  // and <maxFilesA> files; either limit can be 0 for none.  Takes
+  // ownership of <dirA>.
+  CacheDir(GooString *dirA, const char *suffixA,
+	   double maxSizeA, int maxFilesA);
+  ~CacheDir();
+
+  // Return the path of the file for <key>.
+  GooString *getPath(GooString *key);
+
+  // Write the <nBufs> buffers in <bufs> (with lengths <lens>) to the
+  // file for <key>, replacing it if it exists, and trim the directory
+  // if needed.  Returns true on success.
+  bool write(GooString *key, const void **bufs, const size_t *lens,
+	     int nBufs);
+
+  // Mark the file for <key> as recently used.
+  void touch(GooString *key);
+
+  // Remove the file for <key>.
+  void remove(GooString *key);
+
+private:
+
+  GooString *getName(GooString *key);
+  void scan();
+  void trim();
+  bool isOverLimit(double factor);
+  void addEntry(GooString *name, double entrySize);
+  void unlinkEntry(CacheDirEntry *entry);
+  void appendEntry(CacheDirEntry *entry);
+  void removeEntry(CacheDirEntry *entry);
+
+  GooString *dir;
+  const char *suffix;
+  double maxSize;		// size limit, in bytes (0 = none)
+  int maxFiles;			// file count limit (0 = none)
+  double size;			// current (approximate) size, in bytes
+  int nFiles;			// current (approximate) number of files
+  GooHash *entries;		// CacheDirEntry for each file, indexed by
+				//   file name
+  CacheDirEntry *lruHead;	// least recently used file
+  CacheDirEntry *lruTail;	// most recently used file
+  pthread_mutex_t mutex;	// protects the size, count, and entries
+};
+
+#endif
@@ -12,24 +12,278 @@
 #pragma implementation
 #endif
 
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include "poppler/goo/gmem.h"
+#include "poppler/goo/GooList.h"
+#include "poppler/splash/Splash.h"
+#include "poppler/splash/SplashBitmap.h"
+#include "poppler/splash/SplashClip.h"
+#include "poppler/Error.h"
 #include "poppler/Object.h"
+#include "poppler/Stream.h"
+#include "poppler/GfxState.h"
+#include "poppler/GfxFont.h"
+#include "poppler/Function.h"
+#include "poppler/Gfx.h"
+#include "poppler/Page.h"
+#include "poppler/PDFDoc.h"
+#include "poppler/OptionalContent.h"
 #include "poppler/TextOutputDev.h"
 #include "CoreOutputDev.h"
 #include "GlobalParamsGUI.h"
 
+//------------------------------------------------------------------------
+// CoreImageCacheEntry
+//------------------------------------------------------------------------
+
+class CoreImageCacheEntry {
+public:
+
+  CoreImageCacheEntry(Ref refA, Guchar *dataA, size_t sizeA)
+    { ref = refA; data = dataA; size = sizeA; }
+  ~CoreImageCacheEntry() { gfree(data); }
+
+  Ref ref;
+  Guchar *data;			// decoded stream data
+  size_t size;			// length of <data>
+};
+
+//------------------------------------------------------------------------
+// CoreImageCache
+//------------------------------------------------------------------------
+
+CoreImageCache::CoreImageCache() {
+  entries = new GooList();
+  size = 0;
+}
+
+CoreImageCache::~CoreImageCache() {
+  deleteGooList(entries, CoreImageCacheEntry);
+}
+
+Stream *CoreImageCache::getImage(Object *ref, Stream *str,
+				 int width, int height,
+				 int nComps, int nBits) {
+  CoreImageCacheEntry *entry;
+  Object obj;
+  Ref r;
+  Guchar *data;
+  size_t maxSize, rowSize, dataSize;
+  int n, i;
+
+  if (!ref || !ref->isRef() || width <= 0 || height <= 0 ||
+      nComps <= 0 || nBits <= 0) {
+    return NULL;
+  }
+  maxSize = (size_t)globalParamsGUI->getImageCacheSize() << 20;
+  rowSize = ((size_t)width * nComps * nBits + 7) >> 3;
+  if (rowSize == 0 || (size_t)height > maxSize / rowSize ||
+      (size_t)height > INT_MAX / rowSize) {
+    return NULL;
+  }
+  dataSize = rowSize * height;
+  r = ref->getRef();
+
+  // look for the image in the cache
+  entry = NULL;
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (CoreImageCacheEntry *)entries->get(i);
+    if (entry->ref.num == r.num && entry->ref.gen == r.gen) {
+      break;
+    }
+  }
+  if (i < entries->getLength() && entry->size != dataSize) {
+    // same object drawn with different parameters -- decode it again
+    entries->del(i);
+    size -= entry->size;
+    delete entry;
+    i = entries->getLength();
+  }
+
+  // decode the image and add it to the cache
+  if (i == entries->getLength()) {
+    data = (Guchar *)gmalloc(dataSize);
+    str->reset();
+    n = str->doGetChars((int)dataSize, data);
+    str->close();
+    if (n < 0) {
+      n = 0;
+    }
+    if ((size_t)n < dataSize) {
+      memset(data + n, 0, dataSize - n);
+    }
+    // drop the least recently used images to stay under the limit
+    size += dataSize;
+    while (size > maxSize && entries->getLength() > 0) {
+      entry = (CoreImageCacheEntry *)entries->del(entries->getLength() - 1);
+      size -= entry->size;
+      delete entry;
+    }
+    entry = new CoreImageCacheEntry(r, data, dataSize);
+    entries->insert(0, entry);
+  } else if (i > 0) {
+    entries->del(i);
+    entries->insert(0, entry);
+  }
+
+  obj.initNull();
+  return new MemStream((char *)entry->data, 0, entry->size, &obj);
+}
+
+void CoreImageCache::remove(Ref ref) {
+  CoreImageCacheEntry *entry;
+  int i;
+
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (CoreImageCacheEntry *)entries->get(i);
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen) {
+      entries->del(i);
+      size -= entry->size;
+      delete entry;
+      return;
+    }
+  }
+}
+
+void CoreImageCache::clear() {
+  while (entries->getLength() > 0) {
+    delete (CoreImageCacheEntry *)entries->del(0);
+  }
+  size = 0;
+}
+
+//------------------------------------------------------------------------
+
+// Max nesting level of form XObjects (matches Gfx).
+#define coreMaxFormDepth 100
+
+//------------------------------------------------------------------------
+// CoreFormCacheEntry
+//------------------------------------------------------------------------
+
+class CoreFormCacheEntry {
+public:
+
+  CoreFormCacheEntry(CoreFormKey *keyA, SplashBitmap *bitmapA, size_t sizeA)
+    { key = *keyA; bitmap = bitmapA; size = sizeA; }
+  ~CoreFormCacheEntry() { delete bitmap; }
+
+  CoreFormKey key;
+  SplashBitmap *bitmap;
+  size_t size;			// memory used by <bitmap>
+};
+
+static bool formKeysEqual(CoreFormKey *k1, CoreFormKey *k2) {
+  return k1->ref.num == k2->ref.num && k1->ref.gen == k2->ref.gen &&
+         k1->mat[0] == k2->mat[0] && k1->mat[1] == k2->mat[1] &&
+         k1->mat[2] == k2->mat[2] && k1->mat[3] == k2->mat[3] &&
+         k1->fracX == k2->fracX && k1->fracY == k2->fracY &&
+         k1->fill.r == k2->fill.r && k1->fill.g == k2->fill.g &&
+         k1->fill.b == k2->fill.b &&
+         k1->stroke.r == k2->stroke.r && k1->stroke.g == k2->stroke.g &&
+         k1->stroke.b == k2->stroke.b &&
+         k1->fillCS == k2->fillCS && k1->strokeCS == k2->strokeCS &&
+         k1->lineWidth == k2->lineWidth &&
+         k1->lineCap == k2->lineCap && k1->lineJoin == k2->lineJoin &&
+         k1->miterLimit == k2->miterLimit &&
+         k1->flatness == k2->flatness &&
+         k1->strokeAdjust == k2->strokeAdjust &&
+         k1->font.num == k2->font.num && k1->font.gen == k2->font.gen &&
+         k1->fontSize == k2->fontSize &&
+         k1->charSpace == k2->charSpace &&
+         k1->wordSpace == k2->wordSpace &&
+         k1->horizScaling == k2->horizScaling &&
+         k1->leading == k2->leading && k1->rise == k2->rise &&
+         k1->render == k2->render &&
+         k1->antialias == k2->antialias &&
+         k1->reverseVideo == k2->reverseVideo;
+}
+
+//------------------------------------------------------------------------
+// CoreFormCache
+//------------------------------------------------------------------------
+
+CoreFormCache::CoreFormCache() {
+  entries = new GooList();
+  size = 0;
+}
+
+CoreFormCache::~CoreFormCache() {
+  deleteGooList(entries, CoreFormCacheEntry);
+}
+
+SplashBitmap *CoreFormCache::lookup(CoreFormKey *key) {
+  CoreFormCacheEntry *entry;
+  int i;
+
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (CoreFormCacheEntry *)entries->get(i);
+    if (formKeysEqual(&entry->key, key)) {
+      if (i > 0) {
+	entries->del(i);
+	entries->insert(0, entry);
+      }
+      return entry->bitmap;
+    }
+  }
+  return NULL;
+}
+
+void CoreFormCache::add(CoreFormKey *key, SplashBitmap *bitmap) {
+  CoreFormCacheEntry *entry;
+  size_t maxSize, bitmapSize;
+
+  // drop the least recently used forms to stay under the limit
+  maxSize = (size_t)globalParamsGUI->getFormCacheSize() << 20;
+  bitmapSize = (size_t)bitmap->getRowSize() * bitmap->getHeight() +
+               (size_t)bitmap->getWidth() * bitmap->getHeight();
+  size += bitmapSize;
+  while (size > maxSize && entries->getLength() > 0) {
+    entry = (CoreFormCacheEntry *)entries->del(entries->getLength() - 1);
+    size -= entry->size;
+    delete entry;
+  }
+  entries->insert(0, new CoreFormCacheEntry(key, bitmap, bitmapSize));
+}
+
+void CoreFormCache::clear() {
+  while (entries->getLength() > 0) {
+    delete (CoreFormCacheEntry *)entries->del(0);
+  }
+  size = 0;
+}
+
 //------------------------------------------------------------------------
 // CoreOutputDev
 //------------------------------------------------------------------------
 
 CoreOutputDev::CoreOutputDev(SplashColorMode colorModeA, int bitmapRowPadA,
 			     bool reverseVideoA, SplashColorPtr paperColorA,
-			     bool incrementalUpdateA,
+			     bool allowAntialiasA, bool incrementalUpdateA,
 			     CoreOutRedrawCbk redrawCbkA,
 			     void *redrawCbkDataA):
-	SplashOutputDev(colorModeA, bitmapRowPadA, reverseVideoA, paperColorA),
+	SplashOutputDev(colorModeA, bitmapRowPadA, reverseVideoA, paperColorA,
+			gTrue, allowAntialiasA),
 	incrementalUpdate(incrementalUpdateA), redrawCbk(redrawCbkA),
 	redrawCbkData(redrawCbkDataA)
 {
+  colorMode = colorModeA;
+  reverseVideo = reverseVideoA;
+  splashColorCopy(paperColor, paperColorA);
+  allowAntialias = allowAntialiasA;
+  imageCache = NULL;
+  formCache = NULL;
+  doc = NULL;
+  pageNum = 0;
+  curState = NULL;
+  pageBitmap = NULL;
+  paperAlpha = 0;
+  formDepth = 0;
+  saveLevel = 0;
+  nativeFormLevel = -1;
+  pendingNativeForm = false;
   setFreeTypeHinting(globalParamsGUI->getEnableFreeTypeHinting(),
                      globalParamsGUI->getEnableFreeTypeSlightHinting());
 }
@@ -37,9 +291,35 @@ CoreOutputDev::CoreOutputDev(SplashColorMode colorModeA, int bitmapRowPadA,
 CoreOutputDev::~CoreOutputDev() {
 }
 
+void CoreOutputDev::startDoc(PDFDoc *docA) {
+  doc = docA;
+  SplashOutputDev::startDoc(doc ? doc->getXRef() : (XRef *)NULL);
+}
+
+void CoreOutputDev::startPage(int pageNumA, GfxState *state) {
+  SplashBitmap *bitmap;
+
+  SplashOutputDev::startPage(pageNumA, state);
+  pageNum = pageNumA;
+  curState = state;
+  saveLevel = 0;
+  nativeFormLevel = -1;
+  pendingNativeForm = false;
+
+  // remember what the freshly cleared bitmap looks like, so
+  // drawCachedForm can tell which areas haven't been drawn on yet
+  pageBitmap = bitmap = getBitmap();
+  if (bitmap->getDataPtr()) {
+    memcpy(paperPixel, bitmap->getDataPtr(),
+	   splashColorModeNComps[bitmap->getMode()]);
+  }
+  paperAlpha = bitmap->getAlphaPtr() ? bitmap->getAlphaPtr()[0] : 0;
+}
+
 void CoreOutputDev::endPage() {
   SplashOutputDev::endPage();
-  if (!incrementalUpdate) {
+  curState = NULL;
+  if (!incrementalUpdate && redrawCbk) {
     (*redrawCbk)(redrawCbkData, 0, 0, getBitmapWidth(), getBitmapHeight(),
 		 true);
   }
@@ -48,7 +328,7 @@ void CoreOutputDev::endPage() {
 void CoreOutputDev::dump() {
   int x0, y0, x1, y1;
 
-  if (incrementalUpdate) {
+  if (incrementalUpdate && redrawCbk) {
     getModRegion(&x0, &y0, &x1, &y1);
     clearModRegion();
     if (x1 >= x0 && y1 >= y0) {
@@ -57,6 +337,515 @@ void CoreOutputDev::dump() {
   }
 }
 
+// <state> is the state being saved -- the new one isn't made until
+// after this returns, and is passed to the update functions.
+void CoreOutputDev::saveState(GfxState *state) {
+  SplashOutputDev::saveState(state);
+  curState = state;
+  ++saveLevel;
+  if (pendingNativeForm) {
+    nativeFormLevel = saveLevel;
+    pendingNativeForm = false;
+  }
+}
+
+void CoreOutputDev::restoreState(GfxState *state) {
+  SplashOutputDev::restoreState(state);
+  curState = state;
+  if (saveLevel == nativeFormLevel) {
+    nativeFormLevel = -1;
+  }
+  --saveLevel;
+}
+
+void CoreOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
+				  int width, int height, GBool invert,
+				  GBool interpolate, GBool inlineImg) {
+  Stream *cached;
+
+  if (imageCache && !inlineImg &&
+      (cached = imageCache->getImage(ref, str, width, height, 1, 1))) {
+    SplashOutputDev::drawImageMask(state, ref, cached, width, height,
+				   invert, interpolate, inlineImg);
+    delete cached;
+  } else {
+    SplashOutputDev::drawImageMask(state, ref, str, width, height,
+				   invert, interpolate, inlineImg);
+  }
+}
+
+void CoreOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
+			      int width, int height,
+			      GfxImageColorMap *colorMap, GBool interpolate,
+			      int *maskColors, GBool inlineImg) {
+  Stream *cached;
+
+  if (imageCache && !inlineImg &&
+      (cached = imageCache->getImage(ref, str, width, height,
+				     colorMap->getNumPixelComps(),
+				     colorMap->getBits()))) {
+    SplashOutputDev::drawImage(state, ref, cached, width, height, colorMap,
+			       interpolate, maskColors, inlineImg);
+    delete cached;
+  } else {
+    SplashOutputDev::drawImage(state, ref, str, width, height, colorMap,
+			       interpolate, maskColors, inlineImg);
+  }
+}
+
+// Forms are only taken over from Gfx when they may be copied from the
+// raster cache: at the top level of the page, where the page's
+// resources are the ones a form without a resource dictionary falls
+// back on, and in a graphics state that a cached raster can reproduce.
+// Everything else -- including the forms nested in a form that Gfx is
+// interpreting -- is left to Gfx::doForm.
+GBool CoreOutputDev::useDrawForm() {
+  bool use;
+
+  use = formCache && doc && colorMode != splashModeMono1 &&
+        globalParamsGUI->getFormCacheSize() > 0 &&
+        formDepth == 0 && nativeFormLevel < 0 && canCacheForm();
+  // Gfx starts a form with a saveState (unless it skips the form
+  // altogether, in which case the next saveState is marked instead,
+  // which only means that forms aren't cached until its restoreState)
+  pendingNativeForm = !use && formDepth == 0 && nativeFormLevel < 0;
+  return use;
+}
+
+// Check that the current graphics state is one that a raster of a
+// form, drawn onto blank paper, can reproduce.
+bool CoreOutputDev::canCacheForm() {
+  double *dash;
+  double dashStart;
+  int dashLength, i;
+
+  if (!curState || getBitmap() != pageBitmap ||
+      !pageBitmap->getDataPtr() || !pageBitmap->getAlphaPtr() ||
+      curState->getBlendMode() != gfxBlendNormal ||
+      curState->getFillOpacity() != 1 ||
+      curState->getStrokeOpacity() != 1 ||
+      curState->getFillColorSpace()->getMode() == csPattern ||
+      curState->getStrokeColorSpace()->getMode() == csPattern ||
+      curState->getFillOverprint() || curState->getStrokeOverprint() ||
+      getSplash()->getSoftMask() ||
+      getSplash()->getClip()->getNumPaths() > 0) {
+    return false;
+  }
+  curState->getLineDash(&dash, &dashLength, &dashStart);
+  if (dashLength > 0) {
+    return false;
+  }
+  for (i = 0; i < 4; ++i) {
+    if (curState->getTransfer()[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Called by Gfx instead of interpreting a form XObject.  This does
+// what Gfx::doForm would, but first tries to copy the form from the
+// raster cache.
+void CoreOutputDev::drawForm(Ref id) {
+  OCGs *optContent;
+  Object refObj, formObj, bboxObj, matrixObj, resObj, groupObj;
+  Object obj1, obj2;
+  Dict *dict, *resDict;
+  double m[6], bbox[4];
+  bool transpGroup;
+  int i;
+
+  if (!curState || formDepth >= coreMaxFormDepth) {
+    return;
+  }
+  refObj.initRef(id.num, id.gen);
+  refObj.fetch(doc->getXRef(), &formObj);
+  refObj.free();
+  if (!formObj.isStream()) {
+    formObj.free();
+    return;
+  }
+  dict = formObj.streamGetDict();
+
+  // check for optional content key
+  optContent = doc->getOptContentConfig();
+  dict->lookupNF("OC", &obj1);
+  if (optContent && !optContent->optContentIsVisible(&obj1)) {
+    obj1.free();
+    formObj.free();
+    return;
+  }
+  obj1.free();
+
+  // get bounding box
+  dict->lookup("BBox", &bboxObj);
+  if (!bboxObj.isArray() || bboxObj.arrayGetLength() != 4) {
+    bboxObj.free();
+    formObj.free();
+    error(errSyntaxError, -1, "Bad form bounding box");
+    return;
+  }
+  for (i = 0; i < 4; ++i) {
+    bboxObj.arrayGet(i, &obj1);
+    bbox[i] = obj1.isNum() ? obj1.getNum() : 0;
+    obj1.free();
+  }
+  bboxObj.free();
+
+  // get matrix
+  dict->lookup("Matrix", &matrixObj);
+  if (matrixObj.isArray() && matrixObj.arrayGetLength() == 6) {
+    for (i = 0; i < 6; ++i) {
+      matrixObj.arrayGet(i, &obj1);
+      m[i] = obj1.isNum() ? obj1.getNum() : 0;
+      obj1.free();
+    }
+  } else {
+    m[0] = 1; m[1] = 0;
+    m[2] = 0; m[3] = 1;
+    m[4] = 0; m[5] = 0;
+  }
+  matrixObj.free();
+
+  // get resources
+  dict->lookup("Resources", &resObj);
+  resDict = resObj.isDict() ? resObj.getDict() : (Dict *)NULL;
+
+  // check for a transparency group
+  transpGroup = false;
+  if (dict->lookup("Group", &groupObj)->isDict()) {
+    transpGroup = groupObj.dictLookup("S", &obj2)->isName("Transparency");
+    obj2.free();
+  }
+
+  // draw it
+  ++formDepth;
+  if (transpGroup || !drawCachedForm(id, &formObj, resDict, m, bbox)) {
+    drawFormDirect(&formObj, resDict, m, bbox,
+		   transpGroup ? &groupObj : (Object *)NULL);
+  }
+  --formDepth;
+
+  groupObj.free();
+  resObj.free();
+  formObj.free();
+}
+
+// Create a Gfx that draws into <dev>, with the current graphics state,
+// shifted by (-<tx>, -<ty>), and a <w> x <h> pixel page.
+Gfx *CoreOutputDev::makeFormGfx(OutputDev *dev, int tx, int ty,
+				int w, int h) {
+  PDFRectangle box;
+  Page *page;
+  Dict *resDict;
+  Gfx *gfx;
+  GfxState *state;
+  GfxFont *font;
+  Function *funcs[4];
+  double *ctm, *dash, *dashCopy;
+  double dashStart;
+  int dashLength, i;
+
+  // forms without a resource dictionary use the page's resources
+  page = doc->getCatalog()->getPage(pageNum);
+  resDict = page ? page->getResourceDict() : (Dict *)NULL;
+
+  box.x1 = 0;
+  box.y1 = 0;
+  box.x2 = w;
+  box.y2 = h;
+  gfx = new Gfx(doc, dev, resDict, &box, NULL);
+
+  // copy the inherited parts of the graphics state
+  state = gfx->getState();
+  ctm = curState->getCTM();
+  state->setCTM(ctm[0], ctm[1], ctm[2], ctm[3], ctm[4] - tx, ctm[5] - ty);
+  state->setFillColorSpace(curState->getFillColorSpace()->copy());
+  state->setFillColor(curState->getFillColor());
+  if (curState->getFillPattern()) {
+    state->setFillPattern(curState->getFillPattern()->copy());
+  }
+  state->setStrokeColorSpace(curState->getStrokeColorSpace()->copy());
+  state->setStrokeColor(curState->getStrokeColor());
+  if (curState->getStrokePattern()) {
+    state->setStrokePattern(curState->getStrokePattern()->copy());
+  }
+  state->setBlendMode(curState->getBlendMode());
+  state->setFillOpacity(curState->getFillOpacity());
+  state->setStrokeOpacity(curState->getStrokeOpacity());
+  state->setFillOverprint(curState->getFillOverprint());
+  state->setStrokeOverprint(curState->getStrokeOverprint());
+  state->setOverprintMode(curState->getOverprintMode());
+  for (i = 0; i < 4; ++i) {
+    funcs[i] = curState->getTransfer()[i] ?
+                 curState->getTransfer()[i]->copy() : (Function *)NULL;
+  }
+  state->setTransfer(funcs);
+  state->setLineWidth(curState->getLineWidth());
+  curState->getLineDash(&dash, &dashLength, &dashStart);
+  dashCopy = NULL;
+  if (dashLength > 0) {
+    dashCopy = (double *)gmallocn(dashLength, sizeof(double));
+    memcpy(dashCopy, dash, dashLength * sizeof(double));
+  }
+  state->setLineDash(dashCopy, dashLength, dashStart);
+  state->setFlatness(curState->getFlatness());
+  state->setLineJoin(curState->getLineJoin());
+  state->setLineCap(curState->getLineCap());
+  state->setMiterLimit(curState->getMiterLimit());
+  state->setStrokeAdjust(curState->getStrokeAdjust());
+  if ((font = curState->getFont())) {
+    font->incRefCnt();
+  }
+  state->setFont(font, curState->getFontSize());
+  state->setCharSpace(curState->getCharSpace());
+  state->setWordSpace(curState->getWordSpace());
+  state->setHorizScaling(curState->getHorizScaling());
+  state->setLeading(curState->getLeading());
+  state->setRise(curState->getRise());
+  state->setRender(curState->getRender());
+  dev->updateAll(state);
+
+  return gfx;
+}
+
+// Draw a form from the raster cache, rasterizing and caching it first
+// if needed.  The cached raster was drawn onto blank paper, so it is
+// only used if the area it covers is still blank; this is what makes
+// the result identical to interpreting the form.  Returns false if
+// the form has to be drawn the normal way.
+bool CoreOutputDev::drawCachedForm(Ref id, Object *str, Dict *resDict,
+				   double *m, double *bbox) {
+  CoreFormKey key;
+  CoreOutputDev *layerOut;
+  GfxState *layerState;
+  PDFRectangle box;
+  SplashBitmap *bitmap, *formBitmap;
+  SplashClip *clip;
+  GfxFont *font;
+  Gfx *gfx;
+  SplashColorPtr p, q;
+  Guchar *alpha, *formAlpha;
+  double *ctm;
+  double mat[6], xMin, yMin, xMax, yMax, x, y, tx, ty;
+  int ix0, iy0, ix1, iy1, cx0, cy0, cx1, cy1, x0, y0, x1, y1;
+  int nComps, i, xx, yy;
+
+  // useDrawForm has already checked the graphics state
+  bitmap = getBitmap();
+
+  // compute the form's bounding box in device space, with a one
+  // pixel margin
+  ctm = curState->getCTM();
+  mat[0] = m[0] * ctm[0] + m[1] * ctm[2];
+  mat[1] = m[0] * ctm[1] + m[1] * ctm[3];
+  mat[2] = m[2] * ctm[0] + m[3] * ctm[2];
+  mat[3] = m[2] * ctm[1] + m[3] * ctm[3];
+  mat[4] = m[4] * ctm[0] + m[5] * ctm[2] + ctm[4];
+  mat[5] = m[4] * ctm[1] + m[5] * ctm[3] + ctm[5];
+  xMin = yMin = xMax = yMax = 0;
+  for (i = 0; i < 4; ++i) {
+    x = bbox[(i & 1) ? 2 : 0];
+    y = bbox[(i & 2) ? 3 : 1];
+    tx = mat[0] * x + mat[2] * y + mat[4];
+    ty = mat[1] * x + mat[3] * y + mat[5];
+    if (i == 0 || tx < xMin) {
+      xMin = tx;
+    }
+    if (i == 0 || tx > xMax) {
+      xMax = tx;
+    }
+    if (i == 0 || ty < yMin) {
+      yMin = ty;
+    }
+    if (i == 0 || ty > yMax) {
+      yMax = ty;
+    }
+  }
+  if (!(xMax - xMin < 32768 && yMax - yMin < 32768)) {
+    return false;
+  }
+  ix0 = (int)floor(xMin) - 1;
+  iy0 = (int)floor(yMin) - 1;
+  ix1 = (int)ceil(xMax) + 1;
+  iy1 = (int)ceil(yMax) + 1;
+  nComps = splashColorModeNComps[colorMode];
+  if ((double)(ix1 - ix0) * (iy1 - iy0) * (nComps + 1) >
+      (double)globalParamsGUI->getFormCacheSize() * 1024 * 1024) {
+    return false;
+  }
+
+  // the clip region has to be a rectangle, and pixels on a fractional
+  // clip edge (which may be partially covered) can't be copied
+  // exactly
+  clip = getSplash()->getClip();
+  cx0 = (int)ceil(clip->getXMin());
+  cy0 = (int)ceil(clip->getYMin());
+  cx1 = (int)floor(clip->getXMax());
+  cy1 = (int)floor(clip->getYMax());
+  if ((cx0 != clip->getXMin() && ix0 < cx0 && ix1 >= cx0) ||
+      (cy0 != clip->getYMin() && iy0 < cy0 && iy1 >= cy0) ||
+      (cx1 != clip->getXMax() && ix0 <= cx1 && ix1 > cx1) ||
+      (cy1 != clip->getYMax() && iy0 <= cy1 && iy1 > cy1)) {
+    return false;
+  }
+  x0 = ix0 > cx0 ? ix0 : cx0;
+  y0 = iy0 > cy0 ? iy0 : cy0;
+  x1 = ix1 < cx1 ? ix1 : cx1;
+  y1 = iy1 < cy1 ? iy1 : cy1;
+  if (x0 < 0) {
+    x0 = 0;
+  }
+  if (y0 < 0) {
+    y0 = 0;
+  }
+  if (x1 > bitmap->getWidth()) {
+    x1 = bitmap->getWidth();
+  }
+  if (y1 > bitmap->getHeight()) {
+    y1 = bitmap->getHeight();
+  }
+  if (x0 >= x1 || y0 >= y1) {
+    // entirely clipped out
+    return true;
+  }
+
+  // check that the area hasn't been drawn on
+  for (yy = y0; yy < y1; ++yy) {
+    p = bitmap->getDataPtr() + yy * bitmap->getRowSize() + x0 * nComps;
+    alpha = bitmap->getAlphaPtr() + yy * bitmap->getWidth() + x0;
+    for (xx = x0; xx < x1; ++xx) {
+      if (*alpha != paperAlpha || memcmp(p, paperPixel, nComps)) {
+	return false;
+      }
+      p += nComps;
+      ++alpha;
+    }
+  }
+
+  key.ref = id;
+  for (i = 0; i < 4; ++i) {
+    key.mat[i] = ctm[i];
+  }
+  key.fracX = ctm[4] - floor(ctm[4]);
+  key.fracY = ctm[5] - floor(ctm[5]);
+  curState->getFillRGB(&key.fill);
+  curState->getStrokeRGB(&key.stroke);
+  key.fillCS = curState->getFillColorSpace()->getMode();
+  key.strokeCS = curState->getStrokeColorSpace()->getMode();
+  key.lineWidth = curState->getLineWidth();
+  key.lineCap = curState->getLineCap();
+  key.lineJoin = curState->getLineJoin();
+  key.miterLimit = curState->getMiterLimit();
+  key.flatness = curState->getFlatness();
+  key.strokeAdjust = curState->getStrokeAdjust();
+  if ((font = curState->getFont())) {
+    key.font = *font->getID();
+  } else {
+    key.font.num = key.font.gen = -1;
+  }
+  key.fontSize = curState->getFontSize();
+  key.charSpace = curState->getCharSpace();
+  key.wordSpace = curState->getWordSpace();
+  key.horizScaling = curState->getHorizScaling();
+  key.leading = curState->getLeading();
+  key.rise = curState->getRise();
+  key.render = curState->getRender();
+  key.antialias = allowAntialias;
+  key.reverseVideo = reverseVideo;
+
+  // rasterize the form onto blank paper, using the same settings as
+  // this device
+  if (!(formBitmap = formCache->lookup(&key))) {
+    layerOut = new CoreOutputDev(colorMode, 1, reverseVideo, paperColor,
+				 allowAntialias, false, NULL, NULL);
+    layerOut->setImageCache(imageCache);
+    layerOut->startDoc(doc);
+    box.x1 = 0;
+    box.y1 = 0;
+    box.x2 = ix1 - ix0;
+    box.y2 = iy1 - iy0;
+    layerState = new GfxState(72, 72, &box, 0, gTrue);
+    layerOut->startPage(pageNum, layerState);
+    gfx = makeFormGfx(layerOut, ix0, iy0, ix1 - ix0, iy1 - iy0);
+    gfx->drawForm(str, resDict, m, bbox);
+    delete gfx;
+    formBitmap = layerOut->takeBitmap();
+    delete layerState;
+    delete layerOut;
+    formCache->add(&key, formBitmap);
+  }
+
+  // copy it to the page
+  for (yy = y0; yy < y1; ++yy) {
+    p = bitmap->getDataPtr() + yy * bitmap->getRowSize() + x0 * nComps;
+    q = formBitmap->getDataPtr() + (yy - iy0) * formBitmap->getRowSize() +
+        (x0 - ix0) * nComps;
+    memcpy(p, q, (x1 - x0) * nComps);
+    alpha = bitmap->getAlphaPtr() + yy * bitmap->getWidth() + x0;
+    formAlpha = formBitmap->getAlphaPtr() +
+                (yy - iy0) * formBitmap->getWidth() + (x0 - ix0);
+    memcpy(alpha, formAlpha, x1 - x0);
+  }
+  if (incrementalUpdate && redrawCbk) {
+    (*redrawCbk)(redrawCbkData, x0, y0, x1 - 1, y1 - 1, false);
+  }
+
+  return true;
+}
+
+// Interpret a form with a nested Gfx drawing into this device.  This
+// is for the forms that drawForm has taken over but can't copy from
+// the cache (transparency groups, and forms drawn over something).
+// Those are at the top level of the page, so the nested Gfx sees the
+// same resources Gfx::doForm would; forms nested in this one are left
+// to it, as useDrawForm turns them down.
+void CoreOutputDev::drawFormDirect(Object *str, Dict *resDict,
+				   double *m, double *bbox,
+				   Object *groupObj) {
+  GfxState *savedState;
+  GfxColorSpace *blendingColorSpace;
+  Gfx *gfx;
+  Object obj1;
+  GBool isolated, knockout;
+
+  savedState = curState;
+  SplashOutputDev::saveState(curState);
+  gfx = makeFormGfx(this, 0, 0, getBitmapWidth(), getBitmapHeight());
+
+  blendingColorSpace = NULL;
+  isolated = knockout = gFalse;
+  if (groupObj) {
+    if (!groupObj->dictLookup("CS", &obj1)->isNull()) {
+      blendingColorSpace = GfxColorSpace::parse(&obj1, gfx);
+    }
+    obj1.free();
+    if (groupObj->dictLookup("I", &obj1)->isBool()) {
+      isolated = obj1.getBool();
+    }
+    obj1.free();
+    if (groupObj->dictLookup("K", &obj1)->isBool()) {
+      knockout = obj1.getBool();
+    }
+    obj1.free();
+  }
+
+  gfx->drawForm(str, resDict, m, bbox, groupObj != NULL, gFalse,
+		blendingColorSpace, isolated, knockout);
+  delete gfx;
+  if (blendingColorSpace) {
+    delete blendingColorSpace;
+  }
+
+  curState = savedState;
+  SplashOutputDev::restoreState(curState);
+}
+
+void CoreOutputDev::setReverseVideo(bool reverseVideoA) {
+  reverseVideo = reverseVideoA;
+  SplashOutputDev::setReverseVideo(reverseVideoA);
+}
+
 void CoreOutputDev::clear() {
   startDoc(NULL);
   startPage(0, NULL);
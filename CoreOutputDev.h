@@ -14,15 +14,114 @@
 #endif
 
 #include "poppler/splash/SplashTypes.h"
+#include "poppler/Object.h"
+#include "poppler/GfxState.h"
 #include "poppler/SplashOutputDev.h"
 
 class TextPage;
+class GooList;
+class Stream;
+class PDFDoc;
+class Gfx;
+class SplashBitmap;
+class CoreImageCache;
+class CoreFormCache;
 
 //------------------------------------------------------------------------
 
 typedef void (*CoreOutRedrawCbk)(void *data, int x0, int y0, int x1, int y1,
 				 bool composited);
 
+//------------------------------------------------------------------------
+// CoreImageCache
+//------------------------------------------------------------------------
+
+// Decoded samples of image XObjects, keyed by object reference, so
+// that an image drawn in several tiles or at several zoom factors is
+// only decoded once.  The cache holds images of a single document; it
+// must be cleared when the document changes.
+class CoreImageCache {
+public:
+
+  CoreImageCache();
+  ~CoreImageCache();
+
+  // Return a stream that produces the decoded data of image <ref>,
+  // which is read from <str> (and cached) if it isn't in the cache
+  // yet.  Returns NULL if the image can't be cached, in which case
+  // <str> is left untouched.  The returned stream must be deleted by
+  // the caller before the next call.
+  Stream *getImage(Object *ref, Stream *str, int width, int height,
+		   int nComps, int nBits);
+
+  // Discard image <ref>, if it is in the cache.
+  void remove(Ref ref);
+
+  // Discard all cached images.
+  void clear();
+
+private:
+
+  GooList *entries;		// cached images [CoreImageCacheEntry],
+				//   most recently used first
+  size_t size;			// total size of cached data, in bytes
+};
+
+//------------------------------------------------------------------------
+// CoreFormCache
+//------------------------------------------------------------------------
+
+// Everything that determines the pixels of a rasterized form XObject:
+// the form itself, the CTM (up to an integer translation), and the
+// graphics state parameters the form inherits.  (Forms are only
+// cached when the rest of the inherited state -- line dash, transfer
+// functions, overprint -- has its default value.)
+struct CoreFormKey {
+  Ref ref;
+  double mat[4];		// CTM, without the translation
+  double fracX, fracY;		// fractional part of the CTM translation
+  GfxRGB fill, stroke;		// inherited fill and stroke colors
+  int fillCS, strokeCS;		// ... and their color space modes
+  double lineWidth;		// inherited line style
+  int lineCap, lineJoin;
+  double miterLimit;
+  int flatness;
+  bool strokeAdjust;
+  Ref font;			// inherited text state (<font>.num is -1
+				//   if no font is set)
+  double fontSize;
+  double charSpace, wordSpace;
+  double horizScaling, leading, rise;
+  int render;
+  bool antialias;
+  bool reverseVideo;
+};
+
+// Rasterized form XObjects, so that a form drawn on many pages (a
+// letterhead, a grid) is only interpreted once per CTM.  Like
+// CoreImageCache, the cache holds forms of a single document.
+class CoreFormCache {
+public:
+
+  CoreFormCache();
+  ~CoreFormCache();
+
+  // Return the raster for <key>, or NULL if it isn't in the cache.
+  SplashBitmap *lookup(CoreFormKey *key);
+
+  // Add a raster to the cache, which takes ownership of it.
+  void add(CoreFormKey *key, SplashBitmap *bitmap);
+
+  // Discard all cached forms.
+  void clear();
+
+private:
+
+  GooList *entries;		// cached forms [CoreFormCacheEntry],
+				//   most recently used first
+  size_t size;			// total size of cached rasters, in bytes
+};
+
 //------------------------------------------------------------------------
 // CoreOutputDev
 //------------------------------------------------------------------------
@@ -30,9 +129,11 @@ typedef void (*CoreOutRedrawCbk)(void *data, int x0, int y0, int x1, int y1,
 class CoreOutputDev: public SplashOutputDev {
 public:
 
+  // If <redrawCbkA> is NULL, the device doesn't update the display;
+  // it is only used to rasterize into its bitmap.
   CoreOutputDev(SplashColorMode colorModeA, int bitmapRowPadA,
 		bool reverseVideoA, SplashColorPtr paperColorA,
-		bool incrementalUpdateA,
+		bool allowAntialiasA, bool incrementalUpdateA,
 		CoreOutRedrawCbk redrawCbkA,
 		void *redrawCbkDataA);
 
@@ -40,20 +141,161 @@ public:
 
   //----- initialization and control
 
+  // Start a document.  This replaces SplashOutputDev::startDoc, as
+  // form XObjects are drawn with a nested Gfx, which needs the
+  // PDFDoc.
+  void startDoc(PDFDoc *docA);
+
+  // Start a page.
+  virtual void startPage(int pageNum, GfxState *state);
+
   // End a page.
   virtual void endPage();
 
   // Dump page contents to display.
   virtual void dump();
 
+  //----- save/restore graphics state
+
+  virtual void saveState(GfxState *state);
+  virtual void restoreState(GfxState *state);
+
+  //----- update graphics state
+
+  // Gfx calls saveState before it makes the new state, so the state
+  // that drawForm uses is picked up here: Gfx passes the live state
+  // to these every time it changes something.
+  virtual void updateAll(GfxState *state)
+    { curState = state; SplashOutputDev::updateAll(state); }
+  virtual void updateCTM(GfxState *state, double m11, double m12,
+			 double m21, double m22, double m31, double m32)
+    { curState = state;
+      SplashOutputDev::updateCTM(state, m11, m12, m21, m22, m31, m32); }
+  virtual void updateLineDash(GfxState *state)
+    { curState = state; SplashOutputDev::updateLineDash(state); }
+  virtual void updateFlatness(GfxState *state)
+    { curState = state; SplashOutputDev::updateFlatness(state); }
+  virtual void updateLineJoin(GfxState *state)
+    { curState = state; SplashOutputDev::updateLineJoin(state); }
+  virtual void updateLineCap(GfxState *state)
+    { curState = state; SplashOutputDev::updateLineCap(state); }
+  virtual void updateMiterLimit(GfxState *state)
+    { curState = state; SplashOutputDev::updateMiterLimit(state); }
+  virtual void updateLineWidth(GfxState *state)
+    { curState = state; SplashOutputDev::updateLineWidth(state); }
+  virtual void updateStrokeAdjust(GfxState *state)
+    { curState = state; SplashOutputDev::updateStrokeAdjust(state); }
+  virtual void updateFillColorSpace(GfxState *state)
+    { curState = state; SplashOutputDev::updateFillColorSpace(state); }
+  virtual void updateStrokeColorSpace(GfxState *state)
+    { curState = state; SplashOutputDev::updateStrokeColorSpace(state); }
+  virtual void updateFillColor(GfxState *state)
+    { curState = state; SplashOutputDev::updateFillColor(state); }
+  virtual void updateStrokeColor(GfxState *state)
+    { curState = state; SplashOutputDev::updateStrokeColor(state); }
+  virtual void updateBlendMode(GfxState *state)
+    { curState = state; SplashOutputDev::updateBlendMode(state); }
+  virtual void updateFillOpacity(GfxState *state)
+    { curState = state; SplashOutputDev::updateFillOpacity(state); }
+  virtual void updateStrokeOpacity(GfxState *state)
+    { curState = state; SplashOutputDev::updateStrokeOpacity(state); }
+  virtual void updateFillOverprint(GfxState *state)
+    { curState = state; SplashOutputDev::updateFillOverprint(state); }
+  virtual void updateStrokeOverprint(GfxState *state)
+    { curState = state; SplashOutputDev::updateStrokeOverprint(state); }
+  virtual void updateOverprintMode(GfxState *state)
+    { curState = state; SplashOutputDev::updateOverprintMode(state); }
+  virtual void updateTransfer(GfxState *state)
+    { curState = state; SplashOutputDev::updateTransfer(state); }
+  virtual void updateFont(GfxState *state)
+    { curState = state; SplashOutputDev::updateFont(state); }
+  virtual void updateTextMat(GfxState *state)
+    { curState = state; SplashOutputDev::updateTextMat(state); }
+  virtual void updateCharSpace(GfxState *state)
+    { curState = state; SplashOutputDev::updateCharSpace(state); }
+  virtual void updateRender(GfxState *state)
+    { curState = state; SplashOutputDev::updateRender(state); }
+  virtual void updateRise(GfxState *state)
+    { curState = state; SplashOutputDev::updateRise(state); }
+  virtual void updateWordSpace(GfxState *state)
+    { curState = state; SplashOutputDev::updateWordSpace(state); }
+  virtual void updateHorizScaling(GfxState *state)
+    { curState = state; SplashOutputDev::updateHorizScaling(state); }
+  virtual void updateTextPos(GfxState *state)
+    { curState = state; SplashOutputDev::updateTextPos(state); }
+
+  //----- image drawing
+
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool interpolate, GBool inlineImg);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 GBool interpolate, int *maskColors, GBool inlineImg);
+
+  //----- form XObjects
+
+  virtual GBool useDrawForm();
+  virtual void drawForm(Ref id);
+
   //----- special access
 
   // Clear out the document (used when displaying an empty window).
   void clear();
 
+  // Turn incremental display updates on or off.  With incremental
+  // updates off, the redraw callback is called once, at the end of
+  // the page.
+  void setIncrementalUpdate(bool incrementalUpdateA)
+    { incrementalUpdate = incrementalUpdateA; }
+  bool getIncrementalUpdate() { return incrementalUpdate; }
+
+  // Set the cache used for decoded images (NULL to disable caching).
+  // The cache is not owned by the device.
+  void setImageCache(CoreImageCache *imageCacheA)
+    { imageCache = imageCacheA; }
+
+  // Set the cache used for rasterized forms (NULL to disable
+  // caching).  The cache is not owned by the device.
+  void setFormCache(CoreFormCache *formCacheA)
+    { formCache = formCacheA; }
+
+  void setReverseVideo(bool reverseVideoA);
+  bool getReverseVideo() { return reverseVideo; }
+
 private:
 
+  bool canCacheForm();
+  Gfx *makeFormGfx(OutputDev *dev, int tx, int ty, int w, int h);
+  bool drawCachedForm(Ref id, Object *str, Dict *resDict,
+		      double *m, double *bbox);
+  void drawFormDirect(Object *str, Dict *resDict, double *m, double *bbox,
+		      Object *groupObj);
+
+  SplashColorMode colorMode;
+  bool reverseVideo;
+  SplashColor paperColor;
+  bool allowAntialias;
   bool incrementalUpdate;      // incrementally update the display?
+  CoreImageCache *imageCache;
+  CoreFormCache *formCache;
+  PDFDoc *doc;
+  int pageNum;			// current page
+  GfxState *curState;		// current state, as last seen by the
+				//   device
+  SplashBitmap *pageBitmap;	// page bitmap (as opposed to a
+				//   transparency group or pattern)
+  SplashColor paperPixel;	// a blank pixel of <pageBitmap>
+  Guchar paperAlpha;
+  int formDepth;		// nesting level of drawForm calls
+  int saveLevel;		// number of saveState calls not yet
+				//   restored
+  int nativeFormLevel;		// <saveLevel> inside the outermost form
+				//   that Gfx is interpreting itself, or
+				//   -1 if there isn't one
+  bool pendingNativeForm;	// set when useDrawForm has turned down a
+				//   form, which Gfx starts with a
+				//   saveState
   CoreOutRedrawCbk redrawCbk;
   void *redrawCbkData;
 };
@@ -0,0 +1,432 @@
+//========================================================================
+//
+// Decompressor.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LIBBZ2
+#include <bzlib.h>
+#endif
+#ifdef HAVE_LIBLZMA
+#include <lzma.h>
+#endif
+#include "poppler/goo/gmem.h"
+#include "poppler/goo/GooString.h"
+#include "poppler/Error.h"
+#include "poppler/Object.h"
+#include "poppler/Stream.h"
+#include "Decompressor.h"
+
+//------------------------------------------------------------------------
+
+// Size of the compressed data chunks read from the file.
+#define decompressorInBufSize 65536
+
+// The decompressed data must fit in a MemStream.
+#define decompressorMaxSize ((size_t)INT_MAX)
+
+//------------------------------------------------------------------------
+// DecompressedStream
+//------------------------------------------------------------------------
+
+// A MemStream that frees its buffer, and reports the compressed file's
+// name (which PDFDoc copies for its getFileName()).  As with
+// MappedFileStream, substreams and copies point into the buffer, so
+// they must not outlive this stream.
+class DecompressedStream: public MemStream {
+public:
+
+  DecompressedStream(char *bufA, Guint lengthA, GooString *fileNameA,
+		     Object *dictA):
+    MemStream(bufA, 0, lengthA, dictA)
+    { needFree = gTrue; fileName = fileNameA; }
+  virtual ~DecompressedStream() { delete fileName; }
+  virtual GooString *getFileName() { return fileName; }
+
+private:
+
+  GooString *fileName;
+};
+
+//------------------------------------------------------------------------
+// Decompressor
+//------------------------------------------------------------------------
+
+Decompressor *Decompressor::open(GooString *fileNameA) {
+  DecompressorMethod methodA;
+  unsigned char magic[6];
+  struct stat st;
+  FILE *fA;
+
+  if (!(fA = fopen(fileNameA->getCString(), "rb"))) {
+    return NULL;
+  }
+  if (fstat(fileno(fA), &st) != 0 || !S_ISREG(st.st_mode) ||
+      fread(magic, 1, 6, fA) != 6) {
+    fclose(fA);
+    return NULL;
+  }
+  if (magic[0] == 0x1f && magic[1] == 0x8b) {
+    methodA = decompressorGzip;
+  } else if (magic[0] == 'B' && magic[1] == 'Z' && magic[2] == 'h') {
+    methodA = decompressorBzip2;
+  } else if (!memcmp(magic, "\xfd" "7zXZ\0", 6)) {
+    methodA = decompressorXz;
+  } else {
+    fclose(fA);
+    return NULL;
+  }
+
+  // only methods whose library was found at build time are handled
+  switch (methodA) {
+#ifdef HAVE_LIBZ
+  case decompressorGzip:
+#endif
+#ifdef HAVE_LIBBZ2
+  case decompressorBzip2:
+#endif
+#ifdef HAVE_LIBLZMA
+  case decompressorXz:
+#endif
+    break;
+  default:
+    error(errIO, -1, "No support for decompressing '%s'",
+	  fileNameA->getCString());
+    fclose(fA);
+    return NULL;
+  }
+
+  rewind(fA);
+  return new Decompressor(fileNameA, fA, methodA, (long)st.st_size);
+}
+
+Decompressor::Decompressor(GooString *fileNameA, FILE *fA,
+			   DecompressorMethod methodA, long sizeA) {
+  fileName = fileNameA->copy();
+  f = fA;
+  method = methodA;
+  size = sizeA;
+  inPos = 0;
+  aborted = false;
+}
+
+Decompressor::~Decompressor() {
+  if (f) {
+    fclose(f);
+  }
+  delete fileName;
+}
+
+BaseStream *Decompressor::decompress() {
+  char *outBuf;
+  size_t outSize, outLen;
+  Object obj;
+  bool ok;
+
+  outSize = getSizeHint();
+  outBuf = (char *)gmalloc(outSize);
+  outLen = 0;
+  ok = false;
+  switch (method) {
+  case decompressorGzip:
+    ok = inflateGzip(&outBuf, &outSize, &outLen);
+    break;
+  case decompressorBzip2:
+    ok = inflateBzip2(&outBuf, &outSize, &outLen);
+    break;
+  case decompressorXz:
+    ok = inflateXz(&outBuf, &outSize, &outLen);
+    break;
+  }
+  fclose(f);
+  f = NULL;
+  if (!ok || outLen == 0) {
+    if (!isAborted()) {
+      error(errIO, -1, "Couldn't decompress '%s'", fileName->getCString());
+    }
+    gfree(outBuf);
+    return NULL;
+  }
+  if (outLen < outSize) {
+    outBuf = (char *)grealloc(outBuf, outLen);
+  }
+  obj.initNull();
+  return new DecompressedStream(outBuf, (Guint)outLen, fileName->copy(),
+				&obj);
+}
+
+double Decompressor::getProgress() {
+  if (size <= 0) {
+    return -1;
+  }
+  return (double)__atomic_load_n(&inPos, __ATOMIC_RELAXED) / (double)size;
+}
+
+// Read the next chunk of compressed data.  Returns the number of bytes
+// read (0 at EOF), or -1 on error, or if decompress() was aborted.
+int Decompressor::readInput(char *inBuf, int inBufSize) {
+  size_t n;
+
+  if (isAborted()) {
+    return -1;
+  }
+  n = fread(inBuf, 1, inBufSize, f);
+  if (n == 0 && ferror(f)) {
+    return -1;
+  }
+  __atomic_store_n(&inPos, inPos + (long)n, __ATOMIC_RELAXED);
+  return (int)n;
+}
+
+// Double the size of the output buffer.  Returns false if it's already
+// at the size limit.
+bool Decompressor::growOutput(char **outBuf, size_t *outSize) {
+  size_t newSize;
+
+  if (*outSize >= decompressorMaxSize) {
+    return false;
+  }
+  newSize = *outSize > decompressorMaxSize / 2 ? decompressorMaxSize
+                                               : 2 * *outSize;
+  *outBuf = (char *)grealloc(*outBuf, newSize);
+  *outSize = newSize;
+  return true;
+}
+
+// Guess the decompressed size, for the initial output buffer.  A
+// single-member gzip file ends with the decompressed size (mod 2^32);
+// otherwise, assume 4:1 compression.
+size_t Decompressor::getSizeHint() {
+  unsigned char buf[4];
+  size_t hint;
+
+  hint = 0;
+  if (method == decompressorGzip && size > 4 &&
+      fseek(f, -4, SEEK_END) == 0 && fread(buf, 1, 4, f) == 4) {
+    hint = (size_t)buf[0] | ((size_t)buf[1] << 8) |
+           ((size_t)buf[2] << 16) | ((size_t)buf[3] << 24);
+    if (hint < (size_t)size) {
+      hint = 0;
+    }
+  }
+  rewind(f);
+  if (hint == 0) {
+    hint = 4 * (size_t)size;
+  }
+  if (hint < decompressorInBufSize) {
+    hint = decompressorInBufSize;
+  } else if (hint > decompressorMaxSize) {
+    hint = decompressorMaxSize;
+  }
+  return hint;
+}
+
+#ifdef HAVE_LIBZ
+
+bool Decompressor::inflateGzip(char **outBuf, size_t *outSize,
+			       size_t *outLen) {
+  char inBuf[decompressorInBufSize];
+  z_stream z;
+  bool eof, ok;
+  int n, ret;
+
+  memset(&z, 0, sizeof(z));
+  // 15 + 32: max window size, with automatic gzip/zlib header detection
+  if (inflateInit2(&z, 15 + 32) != Z_OK) {
+    return false;
+  }
+  eof = false;
+  ok = false;
+  while (1) {
+    if (z.avail_in == 0 && !eof) {
+      if ((n = readInput(inBuf, decompressorInBufSize)) < 0) {
+	break;
+      }
+      eof = n == 0;
+      z.next_in = (Bytef *)inBuf;
+      z.avail_in = n;
+    }
+    if (*outLen == *outSize && !growOutput(outBuf, outSize)) {
+      break;
+    }
+    z.next_out = (Bytef *)*outBuf + *outLen;
+    z.avail_out = (uInt)(*outSize - *outLen);
+    ret = inflate(&z, Z_NO_FLUSH);
+    *outLen = (char *)z.next_out - *outBuf;
+    if (ret == Z_STREAM_END) {
+      // gzip files can have several members, but ignore any other
+      // trailing junk
+      if (z.avail_in == 0 && !eof) {
+	if ((n = readInput(inBuf, decompressorInBufSize)) < 0) {
+	  break;
+	}
+	eof = n == 0;
+	z.next_in = (Bytef *)inBuf;
+	z.avail_in = n;
+      }
+      if (z.avail_in == 0 || z.next_in[0] != 0x1f) {
+	ok = true;
+	break;
+      }
+      inflateReset(&z);
+    } else if (ret == Z_BUF_ERROR) {
+      // truncated file
+      if (eof && z.avail_in == 0) {
+	break;
+      }
+    } else if (ret != Z_OK) {
+      break;
+    }
+  }
+  inflateEnd(&z);
+  return ok;
+}
+
+#else
+
+bool Decompressor::inflateGzip(char **outBuf, size_t *outSize,
+			       size_t *outLen) {
+  return false;
+}
+
+#endif
+
+#ifdef HAVE_LIBBZ2
+
+bool Decompressor::inflateBzip2(char **outBuf, size_t *outSize,
+				size_t *outLen) {
+  char inBuf[decompressorInBufSize];
+  bz_stream bz;
+  bool eof, ok;
+  int n, ret;
+
+  memset(&bz, 0, sizeof(bz));
+  if (BZ2_bzDecompressInit(&bz, 0, 0) != BZ_OK) {
+    return false;
+  }
+  eof = false;
+  ok = false;
+  while (1) {
+    if (bz.avail_in == 0 && !eof) {
+      if ((n = readInput(inBuf, decompressorInBufSize)) < 0) {
+	break;
+      }
+      eof = n == 0;
+      bz.next_in = inBuf;
+      bz.avail_in = n;
+    }
+    if (*outLen == *outSize && !growOutput(outBuf, outSize)) {
+      break;
+    }
+    bz.next_out = *outBuf + *outLen;
+    bz.avail_out = (unsigned int)(*outSize - *outLen);
+    ret = BZ2_bzDecompress(&bz);
+    *outLen = bz.next_out - *outBuf;
+    if (ret == BZ_STREAM_END) {
+      // bzip2 files can have several streams (e.g., from pbzip2)
+      if (bz.avail_in == 0 && !eof) {
+	if ((n = readInput(inBuf, decompressorInBufSize)) < 0) {
+	  break;
+	}
+	eof = n == 0;
+	bz.next_in = inBuf;
+	bz.avail_in = n;
+      }
+      if (bz.avail_in == 0 || bz.next_in[0] != 'B') {
+	ok = true;
+	break;
+      }
+      BZ2_bzDecompressEnd(&bz);
+      n = bz.avail_in;
+      memmove(inBuf, bz.next_in, n);
+      memset(&bz, 0, sizeof(bz));
+      if (BZ2_bzDecompressInit(&bz, 0, 0) != BZ_OK) {
+	return false;
+      }
+      bz.next_in = inBuf;
+      bz.avail_in = n;
+    } else if (ret != BZ_OK) {
+      break;
+    } else if (eof && bz.avail_in == 0 && bz.avail_out > 0) {
+      // truncated file
+      break;
+    }
+  }
+  BZ2_bzDecompressEnd(&bz);
+  return ok;
+}
+
+#else
+
+bool Decompressor::inflateBzip2(char **outBuf, size_t *outSize,
+				size_t *outLen) {
+  return false;
+}
+
+#endif
+
+#ifdef HAVE_LIBLZMA
+
+bool Decompressor::inflateXz(char **outBuf, size_t *outSize,
+			     size_t *outLen) {
+  char inBuf[decompressorInBufSize];
+  lzma_stream xz = LZMA_STREAM_INIT;
+  lzma_ret ret;
+  bool eof, ok;
+  int n;
+
+  // LZMA_CONCATENATED: handle multi-stream files, like xz does
+  if (lzma_stream_decoder(&xz, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+    return false;
+  }
+  eof = false;
+  ok = false;
+  while (1) {
+    if (xz.avail_in == 0 && !eof) {
+      if ((n = readInput(inBuf, decompressorInBufSize)) < 0) {
+	break;
+      }
+      eof = n == 0;
+      xz.next_in = (uint8_t *)inBuf;
+      xz.avail_in = n;
+    }
+    if (*outLen == *outSize && !growOutput(outBuf, outSize)) {
+      break;
+    }
+    xz.next_out = (uint8_t *)*outBuf + *outLen;
+    xz.avail_out = *outSize - *outLen;
+    ret = lzma_code(&xz, eof ? LZMA_FINISH : LZMA_RUN);
+    *outLen = (char *)xz.next_out - *outBuf;
+    if (ret == LZMA_STREAM_END) {
+      ok = true;
+      break;
+    } else if (ret != LZMA_OK) {
+      break;
+    }
+  }
+  lzma_end(&xz);
+  return ok;
+}
+
+#else
+
+bool Decompressor::inflateXz(char **outBuf, size_t *outSize,
+			     size_t *outLen) {
+  return false;
+}
+
+#endif
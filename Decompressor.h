@@ -0,0 +1,80 @@
+//========================================================================
+//
+// Decompressor.h
+//
+//========================================================================
+
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stdio.h>
+
+class GooString;
+class BaseStream;
+
+//------------------------------------------------------------------------
+
+enum DecompressorMethod {
+  decompressorGzip,
+  decompressorBzip2,
+  decompressorXz
+};
+
+//------------------------------------------------------------------------
+// Decompressor
+//------------------------------------------------------------------------
+
+// Reads a gzip, bzip2, or xz compressed PDF file, decompressing it
+// into memory, and returns the result as a base stream.  The method
+// is recognized by the file's magic number, not its name.  Support for
+// each method depends on the libraries found at build time.
+class Decompressor {
+public:
+
+  // If <fileNameA> is compressed with a supported method, return a new
+  // Decompressor for it.  Otherwise, return NULL, and the file should
+  // be opened normally.
+  static Decompressor *open(GooString *fileNameA);
+
+  ~Decompressor();
+
+  // Decompress the file, and return a stream for the data (which owns
+  // the buffer, and reports the file's name).  Returns NULL if the
+  // data is corrupt, or too large, or if abort() was called.
+  BaseStream *decompress();
+
+  // Make decompress() give up.  This can be called from another
+  // thread.
+  void abort() { __atomic_store_n(&aborted, true, __ATOMIC_RELAXED); }
+
+  // Amount of the compressed data read so far, as a fraction of the
+  // file size.  This can be called from another thread.
+  double getProgress();
+
+private:
+
+  Decompressor(GooString *fileNameA, FILE *fA, DecompressorMethod methodA,
+	       long sizeA);
+  bool isAborted() { return __atomic_load_n(&aborted, __ATOMIC_RELAXED); }
+  int readInput(char *inBuf, int inBufSize);
+  bool growOutput(char **outBuf, size_t *outSize);
+  size_t getSizeHint();
+  bool inflateGzip(char **outBuf, size_t *outSize, size_t *outLen);
+  bool inflateBzip2(char **outBuf, size_t *outSize, size_t *outLen);
+  bool inflateXz(char **outBuf, size_t *outSize, size_t *outLen);
+
+  GooString *fileName;
+  FILE *f;
+  DecompressorMethod method;
+  long size;			// size of the compressed file
+  long inPos;			// number of compressed bytes read so far
+  bool aborted;
+};
+
+#endif
@@ -0,0 +1,741 @@
+//========================================================================
+//
+// DisplayListOutputDev.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "poppler/goo/gmem.h"
+#include "poppler/goo/GooList.h"
+#include "poppler/GfxState.h"
+#include "poppler/GfxFont.h"
+#include "poppler/Page.h"
+#include "DisplayListOutputDev.h"
+
+//------------------------------------------------------------------------
+
+// Number of replayed operations between calls to OutputDev::dump()
+// (matches Gfx's update interval).
+#define displayListUpdateInterval 20000
+
+enum DisplayListOpKind {
+  dlSaveState,
+  dlRestoreState,
+  dlUpdateAll,
+  dlUpdateCTM,
+  dlUpdateLineDash,
+  dlUpdateFlatness,
+  dlUpdateLineJoin,
+  dlUpdateLineCap,
+  dlUpdateMiterLimit,
+  dlUpdateLineWidth,
+  dlUpdateStrokeAdjust,
+  dlUpdateFillColorSpace,
+  dlUpdateStrokeColorSpace,
+  dlUpdateFillColor,
+  dlUpdateStrokeColor,
+  dlUpdateBlendMode,
+  dlUpdateFillOpacity,
+  dlUpdateStrokeOpacity,
+  dlUpdateFillOverprint,
+  dlUpdateStrokeOverprint,
+  dlUpdateOverprintMode,
+  dlUpdateTransfer,
+  dlUpdateFont,
+  dlUpdateTextMat,
+  dlUpdateCharSpace,
+  dlUpdateRender,
+  dlUpdateRise,
+  dlUpdateWordSpace,
+  dlUpdateHorizScaling,
+  dlUpdateTextPos,
+  dlUpdateTextShift,
+  dlStroke,
+  dlFill,
+  dlEoFill,
+  dlClip,
+  dlEoClip,
+  dlClipToStrokePath,
+  dlBeginTextObject,
+  dlEndTextObject,
+  dlDrawChar
+};
+
+struct DisplayListOp {
+  int kind;			// DisplayListOpKind
+  int state;			// index into the state list
+  double args[6];		// updateCTM: m11, m12, m21, m22, m31, m32;
+				//   updateTextShift: shift;
+				//   drawChar: x, y, dx, dy, originX, originY
+  CharCode code;		// drawChar only
+  int nBytes;
+  Unicode *u;
+  int uLen;
+};
+
+struct DisplayListState {
+  GfxState *state;
+  double ctm[6];		// CTM at recording time (state->ctm is
+				//   overwritten during replay)
+};
+
+// <r> = <a> * <b>
+static void concatMatrix(double *a, double *b, double *r) {
+  r[0] = a[0] * b[0] + a[1] * b[2];
+  r[1] = a[0] * b[1] + a[1] * b[3];
+  r[2] = a[2] * b[0] + a[3] * b[2];
+  r[3] = a[2] * b[1] + a[3] * b[3];
+  r[4] = a[4] * b[0] + a[5] * b[2] + b[4];
+  r[5] = a[4] * b[1] + a[5] * b[3] + b[5];
+}
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+DisplayList::DisplayList(int pageA) {
+  page = pageA;
+  ok = true;
+  size = sizeof(DisplayList);
+  ops = NULL;
+  nOps = opsSize = 0;
+  states = new GooList();
+}
+
+DisplayList::~DisplayList() {
+  DisplayListState *st;
+  int i;
+
+  for (i = 0; i < nOps; ++i) {
+    gfree(ops[i].u);
+  }
+  gfree(ops);
+  for (i = 0; i < states->getLength(); ++i) {
+    st = (DisplayListState *)states->get(i);
+    delete st->state;
+    delete st;
+  }
+  delete states;
+}
+
+void DisplayList::displaySlice(OutputDev *out, Page *pageA, double dpi,
+			       int rotate, int sliceX, int sliceY,
+			       int sliceW, int sliceH) {
+  PDFRectangle box;
+  GfxState *state;
+  GBool crop;
+
+  // this mirrors what Page::displaySlice and the Gfx constructor do;
+  // the crop box clip is part of the recorded list
+  rotate += pageA->getRotate();
+  if (rotate >= 360) {
+    rotate -= 360;
+  } else if (rotate < 0) {
+    rotate += 360;
+  }
+  pageA->makeBox(dpi, dpi, rotate, gFalse, out->upsideDown(),
+		 sliceX, sliceY, sliceW, sliceH, &box, &crop);
+  state = new GfxState(dpi, dpi, &box, rotate, out->upsideDown());
+  out->startPage(page, state);
+  out->setDefaultCTM(state->getCTM());
+  replay(out, state->getCTM());
+  out->endPage();
+  delete state;
+}
+
+void DisplayList::replay(OutputDev *out, double *baseCTM) {
+  DisplayListOp *op;
+  DisplayListState *st;
+  GfxState *state;
+  double inv[6], mat[6], ctm[6], det;
+  int curState, i;
+
+  // mat maps the recording device space to the new device space
+  det = 1 / (recCTM[0] * recCTM[3] - recCTM[1] * recCTM[2]);
+  inv[0] = recCTM[3] * det;
+  inv[1] = -recCTM[1] * det;
+  inv[2] = -recCTM[2] * det;
+  inv[3] = recCTM[0] * det;
+  inv[4] = (recCTM[2] * recCTM[5] - recCTM[3] * recCTM[4]) * det;
+  inv[5] = (recCTM[1] * recCTM[4] - recCTM[0] * recCTM[5]) * det;
+  concatMatrix(inv, baseCTM, mat);
+
+  state = NULL;
+  curState = -1;
+  for (i = 0; i < nOps; ++i) {
+    op = &ops[i];
+
+    // state indexes only increase, so each state copy is transformed
+    // once per replay
+    if (op->state != curState) {
+      curState = op->state;
+      st = (DisplayListState *)states->get(curState);
+      state = st->state;
+      concatMatrix(st->ctm, mat, ctm);
+      state->setCTM(ctm[0], ctm[1], ctm[2], ctm[3], ctm[4], ctm[5]);
+    }
+
+    switch (op->kind) {
+    case dlSaveState:
+      out->saveState(state);
+      break;
+    case dlRestoreState:
+      out->restoreState(state);
+      break;
+    case dlUpdateAll:
+      out->updateAll(state);
+      break;
+    case dlUpdateCTM:
+      out->updateCTM(state, op->args[0], op->args[1], op->args[2],
+		     op->args[3], op->args[4], op->args[5]);
+      break;
+    case dlUpdateLineDash:
+      out->updateLineDash(state);
+      break;
+    case dlUpdateFlatness:
+      out->updateFlatness(state);
+      break;
+    case dlUpdateLineJoin:
+      out->updateLineJoin(state);
+      break;
+    case dlUpdateLineCap:
+      out->updateLineCap(state);
+      break;
+    case dlUpdateMiterLimit:
+      out->updateMiterLimit(state);
+      break;
+    case dlUpdateLineWidth:
+      out->updateLineWidth(state);
+      break;
+    case dlUpdateStrokeAdjust:
+      out->updateStrokeAdjust(state);
+      break;
+    case dlUpdateFillColorSpace:
+      out->updateFillColorSpace(state);
+      break;
+    case dlUpdateStrokeColorSpace:
+      out->updateStrokeColorSpace(state);
+      break;
+    case dlUpdateFillColor:
+      out->updateFillColor(state);
+      break;
+    case dlUpdateStrokeColor:
+      out->updateStrokeColor(state);
+      break;
+    case dlUpdateBlendMode:
+      out->updateBlendMode(state);
+      break;
+    case dlUpdateFillOpacity:
+      out->updateFillOpacity(state);
+      break;
+    case dlUpdateStrokeOpacity:
+      out->updateStrokeOpacity(state);
+      break;
+    case dlUpdateFillOverprint:
+      out->updateFillOverprint(state);
+      break;
+    case dlUpdateStrokeOverprint:
+      out->updateStrokeOverprint(state);
+      break;
+    case dlUpdateOverprintMode:
+      out->updateOverprintMode(state);
+      break;
+    case dlUpdateTransfer:
+      out->updateTransfer(state);
+      break;
+    case dlUpdateFont:
+      out->updateFont(state);
+      break;
+    case dlUpdateTextMat:
+      out->updateTextMat(state);
+      break;
+    case dlUpdateCharSpace:
+      out->updateCharSpace(state);
+      break;
+    case dlUpdateRender:
+      out->updateRender(state);
+      break;
+    case dlUpdateRise:
+      out->updateRise(state);
+      break;
+    case dlUpdateWordSpace:
+      out->updateWordSpace(state);
+      break;
+    case dlUpdateHorizScaling:
+      out->updateHorizScaling(state);
+      break;
+    case dlUpdateTextPos:
+      out->updateTextPos(state);
+      break;
+    case dlUpdateTextShift:
+      out->updateTextShift(state, op->args[0]);
+      break;
+    case dlStroke:
+      out->stroke(state);
+      break;
+    case dlFill:
+      out->fill(state);
+      break;
+    case dlEoFill:
+      out->eoFill(state);
+      break;
+    case dlClip:
+      out->clip(state);
+      break;
+    case dlEoClip:
+      out->eoClip(state);
+      break;
+    case dlClipToStrokePath:
+      out->clipToStrokePath(state);
+      break;
+    case dlBeginTextObject:
+      out->beginTextObject(state);
+      break;
+    case dlEndTextObject:
+      out->endTextObject(state);
+      break;
+    case dlDrawChar:
+      out->drawChar(state, op->args[0], op->args[1], op->args[2],
+		    op->args[3], op->args[4], op->args[5],
+		    op->code, op->nBytes, op->u, op->uLen);
+      break;
+    }
+
+    if ((i + 1) % displayListUpdateInterval == 0) {
+      out->dump();
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//------------------------------------------------------------------------
+
+DisplayListOutputDev::DisplayListOutputDev(int pageA, size_t maxSizeA) {
+  list = new DisplayList(pageA);
+  maxSize = maxSizeA;
+  stateChanged = true;
+  firstPendingOp = -1;
+}
+
+DisplayListOutputDev::~DisplayListOutputDev() {
+  delete list;
+}
+
+DisplayList *DisplayListOutputDev::takeDisplayList() {
+  DisplayList *ret;
+
+  ret = list;
+  list = new DisplayList(ret->page);
+  return ret;
+}
+
+GBool DisplayListOutputDev::abortCheckCbk(void *data) {
+  DisplayListOutputDev *out = (DisplayListOutputDev *)data;
+
+  return !out->list->ok;
+}
+
+void DisplayListOutputDev::startPage(int pageNum, GfxState *state) {
+  memcpy(list->recCTM, state->getCTM(), 6 * sizeof(double));
+}
+
+void DisplayListOutputDev::endPage() {
+  // state changes at the end of the page don't affect anything -- drop
+  // them (all ops from firstPendingOp on are update ops)
+  if (firstPendingOp >= 0) {
+    list->nOps = firstPendingOp;
+    firstPendingOp = -1;
+  }
+}
+
+void DisplayListOutputDev::saveState(GfxState *state) {
+  addOp(dlSaveState, state);
+}
+
+void DisplayListOutputDev::restoreState(GfxState *state) {
+  // the restored state goes with the following ops
+  addUpdateOp(dlRestoreState, state);
+}
+
+void DisplayListOutputDev::updateAll(GfxState *state) {
+  addUpdateOp(dlUpdateAll, state);
+}
+
+void DisplayListOutputDev::updateCTM(GfxState *state, double m11, double m12,
+				     double m21, double m22,
+				     double m31, double m32) {
+  DisplayListOp *op;
+
+  addUpdateOp(dlUpdateCTM, state);
+  if (list->ok) {
+    op = &list->ops[list->nOps - 1];
+    op->args[0] = m11;
+    op->args[1] = m12;
+    op->args[2] = m21;
+    op->args[3] = m22;
+    op->args[4] = m31;
+    op->args[5] = m32;
+  }
+}
+
+void DisplayListOutputDev::updateLineDash(GfxState *state) {
+  addUpdateOp(dlUpdateLineDash, state);
+}
+
+void DisplayListOutputDev::updateFlatness(GfxState *state) {
+  addUpdateOp(dlUpdateFlatness, state);
+}
+
+void DisplayListOutputDev::updateLineJoin(GfxState *state) {
+  addUpdateOp(dlUpdateLineJoin, state);
+}
+
+void DisplayListOutputDev::updateLineCap(GfxState *state) {
+  addUpdateOp(dlUpdateLineCap, state);
+}
+
+void DisplayListOutputDev::updateMiterLimit(GfxState *state) {
+  addUpdateOp(dlUpdateMiterLimit, state);
+}
+
+void DisplayListOutputDev::updateLineWidth(GfxState *state) {
+  addUpdateOp(dlUpdateLineWidth, state);
+}
+
+void DisplayListOutputDev::updateStrokeAdjust(GfxState *state) {
+  addUpdateOp(dlUpdateStrokeAdjust, state);
+}
+
+void DisplayListOutputDev::updateFillColorSpace(GfxState *state) {
+  addUpdateOp(dlUpdateFillColorSpace, state);
+}
+
+void DisplayListOutputDev::updateStrokeColorSpace(GfxState *state) {
+  addUpdateOp(dlUpdateStrokeColorSpace, state);
+}
+
+void DisplayListOutputDev::updateFillColor(GfxState *state) {
+  addUpdateOp(dlUpdateFillColor, state);
+}
+
+void DisplayListOutputDev::updateStrokeColor(GfxState *state) {
+  addUpdateOp(dlUpdateStrokeColor, state);
+}
+
+void DisplayListOutputDev::updateBlendMode(GfxState *state) {
+  addUpdateOp(dlUpdateBlendMode, state);
+}
+
+void DisplayListOutputDev::updateFillOpacity(GfxState *state) {
+  addUpdateOp(dlUpdateFillOpacity, state);
+}
+
+void DisplayListOutputDev::updateStrokeOpacity(GfxState *state) {
+  addUpdateOp(dlUpdateStrokeOpacity, state);
+}
+
+void DisplayListOutputDev::updateFillOverprint(GfxState *state) {
+  addUpdateOp(dlUpdateFillOverprint, state);
+}
+
+void DisplayListOutputDev::updateStrokeOverprint(GfxState *state) {
+  addUpdateOp(dlUpdateStrokeOverprint, state);
+}
+
+void DisplayListOutputDev::updateOverprintMode(GfxState *state) {
+  addUpdateOp(dlUpdateOverprintMode, state);
+}
+
+void DisplayListOutputDev::updateTransfer(GfxState *state) {
+  addUpdateOp(dlUpdateTransfer, state);
+}
+
+void DisplayListOutputDev::updateFont(GfxState *state) {
+  addUpdateOp(dlUpdateFont, state);
+}
+
+void DisplayListOutputDev::updateTextMat(GfxState *state) {
+  addUpdateOp(dlUpdateTextMat, state);
+}
+
+void DisplayListOutputDev::updateCharSpace(GfxState *state) {
+  addUpdateOp(dlUpdateCharSpace, state);
+}
+
+void DisplayListOutputDev::updateRender(GfxState *state) {
+  addUpdateOp(dlUpdateRender, state);
+}
+
+void DisplayListOutputDev::updateRise(GfxState *state) {
+  addUpdateOp(dlUpdateRise, state);
+}
+
+void DisplayListOutputDev::updateWordSpace(GfxState *state) {
+  addUpdateOp(dlUpdateWordSpace, state);
+}
+
+void DisplayListOutputDev::updateHorizScaling(GfxState *state) {
+  addUpdateOp(dlUpdateHorizScaling, state);
+}
+
+void DisplayListOutputDev::updateTextPos(GfxState *state) {
+  addUpdateOp(dlUpdateTextPos, state);
+}
+
+void DisplayListOutputDev::updateTextShift(GfxState *state, double shift) {
+  addUpdateOp(dlUpdateTextShift, state);
+  if (list->ok) {
+    list->ops[list->nOps - 1].args[0] = shift;
+  }
+}
+
+void DisplayListOutputDev::stroke(GfxState *state) {
+  addPathOp(dlStroke, state);
+}
+
+void DisplayListOutputDev::fill(GfxState *state) {
+  addPathOp(dlFill, state);
+}
+
+void DisplayListOutputDev::eoFill(GfxState *state) {
+  addPathOp(dlEoFill, state);
+}
+
+GBool DisplayListOutputDev::useShadedFills(int type) {
+  // shadings are rasterized by the real output device
+  fail();
+  return gFalse;
+}
+
+void DisplayListOutputDev::clip(GfxState *state) {
+  addPathOp(dlClip, state);
+}
+
+void DisplayListOutputDev::eoClip(GfxState *state) {
+  addPathOp(dlEoClip, state);
+}
+
+void DisplayListOutputDev::clipToStrokePath(GfxState *state) {
+  addPathOp(dlClipToStrokePath, state);
+}
+
+void DisplayListOutputDev::beginTextObject(GfxState *state) {
+  addOp(dlBeginTextObject, state);
+}
+
+void DisplayListOutputDev::endTextObject(GfxState *state) {
+  addOp(dlEndTextObject, state);
+}
+
+void DisplayListOutputDev::drawChar(GfxState *state, double x, double y,
+				    double dx, double dy,
+				    double originX, double originY,
+				    CharCode code, int nBytes,
+				    Unicode *u, int uLen) {
+  DisplayListOp *op;
+
+  if (state->getFont() && state->getFont()->getType() == fontType3) {
+    fail();
+    return;
+  }
+  addOp(dlDrawChar, state);
+  if (!list->ok) {
+    return;
+  }
+  op = &list->ops[list->nOps - 1];
+  op->args[0] = x;
+  op->args[1] = y;
+  op->args[2] = dx;
+  op->args[3] = dy;
+  op->args[4] = originX;
+  op->args[5] = originY;
+  op->code = code;
+  op->nBytes = nBytes;
+  if (u && uLen > 0) {
+    op->u = (Unicode *)gmallocn(uLen, sizeof(Unicode));
+    memcpy(op->u, u, uLen * sizeof(Unicode));
+    op->uLen = uLen;
+    list->size += uLen * sizeof(Unicode);
+  }
+}
+
+GBool DisplayListOutputDev::beginType3Char(GfxState *state,
+					   double x, double y,
+					   double dx, double dy,
+					   CharCode code,
+					   Unicode *u, int uLen) {
+  fail();
+  return gTrue;
+}
+
+// The image functions fail the recording, then let the base class
+// skip over the image data (which is needed for inline images).
+
+void DisplayListOutputDev::drawImageMask(GfxState *state, Object *ref,
+					 Stream *str,
+					 int width, int height, GBool invert,
+					 GBool interpolate, GBool inlineImg) {
+  fail();
+  OutputDev::drawImageMask(state, ref, str, width, height, invert,
+			   interpolate, inlineImg);
+}
+
+void DisplayListOutputDev::drawImage(GfxState *state, Object *ref,
+				     Stream *str,
+				     int width, int height,
+				     GfxImageColorMap *colorMap,
+				     GBool interpolate, int *maskColors,
+				     GBool inlineImg) {
+  fail();
+  OutputDev::drawImage(state, ref, str, width, height, colorMap,
+		       interpolate, maskColors, inlineImg);
+}
+
+void DisplayListOutputDev::drawMaskedImage(GfxState *state, Object *ref,
+					   Stream *str,
+					   int width, int height,
+					   GfxImageColorMap *colorMap,
+					   GBool interpolate,
+					   Stream *maskStr,
+					   int maskWidth, int maskHeight,
+					   GBool maskInvert,
+					   GBool maskInterpolate) {
+  fail();
+  OutputDev::drawMaskedImage(state, ref, str, width, height, colorMap,
+			     interpolate, maskStr, maskWidth, maskHeight,
+			     maskInvert, maskInterpolate);
+}
+
+void DisplayListOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
+					       Stream *str,
+					       int width, int height,
+					       GfxImageColorMap *colorMap,
+					       GBool interpolate,
+					       Stream *maskStr,
+					       int maskWidth, int maskHeight,
+					       GfxImageColorMap *maskColorMap,
+					       GBool maskInterpolate) {
+  fail();
+  OutputDev::drawSoftMaskedImage(state, ref, str, width, height, colorMap,
+				 interpolate, maskStr, maskWidth, maskHeight,
+				 maskColorMap, maskInterpolate);
+}
+
+void DisplayListOutputDev::beginTransparencyGroup(
+				      GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask) {
+  fail();
+}
+
+void DisplayListOutputDev::setSoftMask(GfxState *state, double *bbox,
+				       GBool alpha, Function *transferFunc,
+				       GfxColor *backdropColor) {
+  fail();
+}
+
+// Add an op that uses the current state.
+void DisplayListOutputDev::addOp(int kind, GfxState *state) {
+  DisplayListOp *op;
+
+  if (!list->ok) {
+    return;
+  }
+  if (stateChanged) {
+    flushState(state, false);
+  }
+  if (list->nOps == list->opsSize) {
+    list->opsSize = list->opsSize ? 2 * list->opsSize : 256;
+    list->ops = (DisplayListOp *)greallocn(list->ops, list->opsSize,
+					   sizeof(DisplayListOp));
+  }
+  op = &list->ops[list->nOps++];
+  memset(op, 0, sizeof(DisplayListOp));
+  op->kind = kind;
+  op->state = list->states->getLength() - 1;
+  list->size += sizeof(DisplayListOp);
+  if (list->size > maxSize) {
+    fail();
+  }
+}
+
+// Add an op that needs the current path.
+void DisplayListOutputDev::addPathOp(int kind, GfxState *state) {
+  if (!list->ok) {
+    return;
+  }
+  flushState(state, true);
+  addOp(kind, state);
+}
+
+// Add an op that changes the state.  Consecutive state changes share
+// one copy of the state, which is made when the next drawing op (or
+// saveState) comes along -- so an update op is replayed with the final
+// state of its group, which is equivalent.
+void DisplayListOutputDev::addUpdateOp(int kind, GfxState *state) {
+  if (!list->ok) {
+    return;
+  }
+  stateChanged = false;
+  addOp(kind, state);
+  if (!list->ok) {
+    return;
+  }
+  if (firstPendingOp < 0) {
+    firstPendingOp = list->nOps - 1;
+  }
+  list->ops[list->nOps - 1].state = -1;
+  stateChanged = true;
+}
+
+// Make a copy of <state>, and assign it to the pending update ops.
+void DisplayListOutputDev::flushState(GfxState *state, bool copyPath) {
+  DisplayListState *st;
+  GfxPath *path;
+  int i;
+
+  st = new DisplayListState;
+  st->state = state->copy(copyPath);
+  memcpy(st->ctm, state->getCTM(), 6 * sizeof(double));
+  list->states->append(st);
+  list->size += sizeof(DisplayListState) + sizeof(GfxState);
+  if (copyPath) {
+    path = state->getPath();
+    for (i = 0; i < path->getNumSubpaths(); ++i) {
+      list->size += sizeof(GfxSubpath) +
+	            path->getSubpath(i)->getNumPoints() *
+	              (2 * sizeof(double) + sizeof(GBool));
+    }
+  }
+  if (firstPendingOp >= 0) {
+    for (i = firstPendingOp; i < list->nOps; ++i) {
+      if (list->ops[i].state < 0) {
+	list->ops[i].state = list->states->getLength() - 1;
+      }
+    }
+    firstPendingOp = -1;
+  }
+  stateChanged = false;
+}
+
+// Give up on recording this page, and free whatever was recorded.
+void DisplayListOutputDev::fail() {
+  int page;
+
+  if (!list->ok) {
+    return;
+  }
+  page = list->page;
+  delete list;
+  list = new DisplayList(page);
+  list->ok = false;
+  firstPendingOp = -1;
+}
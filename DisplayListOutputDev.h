@@ -0,0 +1,223 @@
+//========================================================================
+//
+// DisplayListOutputDev.h
+//
+//========================================================================
+
+#ifndef DISPLAYLISTOUTPUTDEV_H
+#define DISPLAYLISTOUTPUTDEV_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "poppler/OutputDev.h"
+
+class GooList;
+class Stream;
+class Function;
+class GfxState;
+class GfxColorSpace;
+class GfxImageColorMap;
+struct GfxColor;
+class Page;
+struct DisplayListOp;
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+// The drawing operations of one page, as recorded by a
+// DisplayListOutputDev.  Each operation keeps a copy of the graphics
+// state it was called with; consecutive operations that don't change
+// the state share the same copy.  The list is independent of the
+// resolution, rotation, and slice it was recorded at.
+class DisplayList {
+public:
+
+  DisplayList(int pageA);
+  ~DisplayList();
+
+  // Returns false if the page could not be recorded, i.e., it uses
+  // operations that can't be replayed, or the list got too large.
+  bool isOk() { return ok; }
+
+  int getPage() { return page; }
+
+  // Approximate memory used by the list, in bytes.
+  size_t getSize() { return size; }
+
+  // Rasterize a slice of the page into <out>, the same way
+  // PDFDoc::displayPageSlice would (with useMediaBox = false, crop =
+  // true).  <pageA> is the Page object for this list's page.
+  void displaySlice(OutputDev *out, Page *pageA, double dpi, int rotate,
+		    int sliceX, int sliceY, int sliceW, int sliceH);
+
+private:
+
+  void replay(OutputDev *out, double *baseCTM);
+
+  int page;
+  bool ok;
+  size_t size;
+  double recCTM[6];		// base CTM at recording time
+  DisplayListOp *ops;
+  int nOps;
+  int opsSize;
+  GooList *states;		// graphics state copies [DisplayListState]
+
+  friend class DisplayListOutputDev;
+};
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//------------------------------------------------------------------------
+
+// Records the drawing operations of a page into a DisplayList.  Only
+// paths, clipping, and non-Type 3 text are supported; images,
+// shadings, Type 3 glyphs, transparency groups, and soft masks cause
+// the recording to fail.
+class DisplayListOutputDev: public OutputDev {
+public:
+
+  // Record page <pageA>.  Recording fails once the list grows beyond
+  // <maxSizeA> bytes.
+  DisplayListOutputDev(int pageA, size_t maxSizeA);
+  virtual ~DisplayListOutputDev();
+
+  // Return the recorded list, which is then owned by the caller.  If
+  // recording failed, the list is empty and isOk() returns false.
+  DisplayList *takeDisplayList();
+
+  // Abort check callback for PDFDoc::displayPage: stops interpreting
+  // the page as soon as recording has failed.
+  static GBool abortCheckCbk(void *data);
+
+  //----- get info about output device
+
+  virtual GBool upsideDown() { return gTrue; }
+  virtual GBool useDrawChar() { return gTrue; }
+  virtual GBool interpretType3Chars() { return gTrue; }
+
+  //----- initialization and control
+
+  virtual void startPage(int pageNum, GfxState *state);
+  virtual void endPage();
+
+  //----- save/restore graphics state
+
+  virtual void saveState(GfxState *state);
+  virtual void restoreState(GfxState *state);
+
+  //----- update graphics state
+
+  virtual void updateAll(GfxState *state);
+  virtual void updateCTM(GfxState *state, double m11, double m12,
+			 double m21, double m22, double m31, double m32);
+  virtual void updateLineDash(GfxState *state);
+  virtual void updateFlatness(GfxState *state);
+  virtual void updateLineJoin(GfxState *state);
+  virtual void updateLineCap(GfxState *state);
+  virtual void updateMiterLimit(GfxState *state);
+  virtual void updateLineWidth(GfxState *state);
+  virtual void updateStrokeAdjust(GfxState *state);
+  virtual void updateFillColorSpace(GfxState *state);
+  virtual void updateStrokeColorSpace(GfxState *state);
+  virtual void updateFillColor(GfxState *state);
+  virtual void updateStrokeColor(GfxState *state);
+  virtual void updateBlendMode(GfxState *state);
+  virtual void updateFillOpacity(GfxState *state);
+  virtual void updateStrokeOpacity(GfxState *state);
+  virtual void updateFillOverprint(GfxState *state);
+  virtual void updateStrokeOverprint(GfxState *state);
+  virtual void updateOverprintMode(GfxState *state);
+  virtual void updateTransfer(GfxState *state);
+
+  //----- update text state
+
+  virtual void updateFont(GfxState *state);
+  virtual void updateTextMat(GfxState *state);
+  virtual void updateCharSpace(GfxState *state);
+  virtual void updateRender(GfxState *state);
+  virtual void updateRise(GfxState *state);
+  virtual void updateWordSpace(GfxState *state);
+  virtual void updateHorizScaling(GfxState *state);
+  virtual void updateTextPos(GfxState *state);
+  virtual void updateTextShift(GfxState *state, double shift);
+
+  //----- path painting
+
+  virtual void stroke(GfxState *state);
+  virtual void fill(GfxState *state);
+  virtual void eoFill(GfxState *state);
+  virtual GBool useShadedFills(int type);
+
+  //----- path clipping
+
+  virtual void clip(GfxState *state);
+  virtual void eoClip(GfxState *state);
+  virtual void clipToStrokePath(GfxState *state);
+
+  //----- text drawing
+
+  virtual void beginTextObject(GfxState *state);
+  virtual void endTextObject(GfxState *state);
+  virtual void drawChar(GfxState *state, double x, double y,
+			double dx, double dy,
+			double originX, double originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+  virtual GBool beginType3Char(GfxState *state, double x, double y,
+			       double dx, double dy,
+			       CharCode code, Unicode *u, int uLen);
+
+  //----- image drawing
+
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool interpolate, GBool inlineImg);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 GBool interpolate, int *maskColors, GBool inlineImg);
+  virtual void drawMaskedImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap, GBool interpolate,
+			       Stream *maskStr, int maskWidth, int maskHeight,
+			       GBool maskInvert, GBool maskInterpolate);
+  virtual void drawSoftMaskedImage(GfxState *state, Object *ref,
+				   Stream *str, int width, int height,
+				   GfxImageColorMap *colorMap,
+				   GBool interpolate,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GfxImageColorMap *maskColorMap,
+				   GBool maskInterpolate);
+
+  //----- transparency groups and soft masks
+
+  virtual void beginTransparencyGroup(GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask);
+  virtual void setSoftMask(GfxState *state, double *bbox, GBool alpha,
+			   Function *transferFunc, GfxColor *backdropColor);
+
+private:
+
+  void addOp(int kind, GfxState *state);
+  void addPathOp(int kind, GfxState *state);
+  void addUpdateOp(int kind, GfxState *state);
+  void flushState(GfxState *state, bool copyPath);
+  void fail();
+
+  DisplayList *list;
+  size_t maxSize;
+  bool stateChanged;		// set if the state has changed since the
+				//   last copy was made
+  int firstPendingOp;		// first op waiting for a state copy,
+				//   or -1
+};
+
+#endif
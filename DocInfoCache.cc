@@ -0,0 +1,135 @@
+//========================================================================
+//
+// DocInfoCache.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "poppler/goo/gmem.h"
+#include "poppler/goo/GooString.h"
+#include "PDFCore.h"
+#include "CacheDir.h"
+#include "DocInfoCache.h"
+
+//------------------------------------------------------------------------
+
+#define docInfoCacheMagic "xpdfDI01"
+#define docInfoCacheSuffix ".docinfo"
+
+// Max number of documents to keep.  When there are more, the least
+// recently used ones are removed.
+#define docInfoCacheMaxFiles 1000
+
+struct DocInfoCacheHeader {
+  char magic[8];		// docInfoCacheMagic
+  int keyLen;			// length of the key, which follows the
+				//   header
+  int nPages;			// number of DocInfoCachePage entries,
+				//   which follow the key
+};
+
+struct DocInfoCachePage {
+  double cropW, cropH;
+  int rotate;
+  int pad;
+};
+
+//------------------------------------------------------------------------
+// DocInfoCache
+//------------------------------------------------------------------------
+
+DocInfoCache::DocInfoCache(GooString *dirA) {
+  cacheDir = new CacheDir(dirA, docInfoCacheSuffix, 0, docInfoCacheMaxFiles);
+}
+
+DocInfoCache::~DocInfoCache() {
+  delete cacheDir;
+}
+
+bool DocInfoCache::loadPageGeom(GooString *path, GooString *key,
+				int nPages, PDFCorePageGeom *geom) {
+  DocInfoCacheHeader hdr;
+  DocInfoCachePage *entries;
+  GooString *cachePath;
+  char *keyBuf;
+  FILE *f;
+  bool ok;
+  int i;
+
+  cachePath = cacheDir->getPath(path);
+  if (!(f = fopen(cachePath->getCString(), "rb"))) {
+    delete cachePath;
+    return false;
+  }
+
+  // check that this is the current version of the document (and not
+  // an older one, or a hash collision)
+  ok = fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+       !memcmp(hdr.magic, docInfoCacheMagic, 8) &&
+       hdr.keyLen == key->getLength() &&
+       hdr.nPages == nPages;
+  if (ok) {
+    keyBuf = (char *)gmalloc(hdr.keyLen);
+    ok = fread(keyBuf, 1, hdr.keyLen, f) == (size_t)hdr.keyLen &&
+         !memcmp(keyBuf, key->getCString(), hdr.keyLen);
+    gfree(keyBuf);
+  }
+  if (ok) {
+    entries = (DocInfoCachePage *)gmallocn(nPages, sizeof(DocInfoCachePage));
+    ok = fread(entries, sizeof(DocInfoCachePage), nPages, f) ==
+           (size_t)nPages;
+    if (ok) {
+      for (i = 0; i < nPages; ++i) {
+	geom[i].cropW = entries[i].cropW;
+	geom[i].cropH = entries[i].cropH;
+	geom[i].rotate = entries[i].rotate;
+	geom[i].placeholder = false;
+      }
+    }
+    gfree(entries);
+  }
+  fclose(f);
+
+  // mark the file as recently used
+  if (ok) {
+    cacheDir->touch(path);
+  }
+  delete cachePath;
+  return ok;
+}
+
+void DocInfoCache::storePageGeom(GooString *path, GooString *key,
+				 int nPages, PDFCorePageGeom *geom) {
+  DocInfoCacheHeader hdr;
+  DocInfoCachePage *entries;
+  const void *bufs[3];
+  size_t lens[3];
+  int i;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, docInfoCacheMagic, 8);
+  hdr.keyLen = key->getLength();
+  hdr.nPages = nPages;
+  entries = (DocInfoCachePage *)gmallocn(nPages, sizeof(DocInfoCachePage));
+  memset(entries, 0, nPages * sizeof(DocInfoCachePage));
+  for (i = 0; i < nPages; ++i) {
+    entries[i].cropW = geom[i].cropW;
+    entries[i].cropH = geom[i].cropH;
+    entries[i].rotate = geom[i].rotate;
+  }
+  bufs[0] = &hdr;
+  lens[0] = sizeof(hdr);
+  bufs[1] = key->getCString();
+  lens[1] = hdr.keyLen;
+  bufs[2] = entries;
+  lens[2] = nPages * sizeof(DocInfoCachePage);
+  cacheDir->write(path, bufs, lens, 3);
+  gfree(entries);
+}
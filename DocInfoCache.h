@@ -0,0 +1,54 @@
+//========================================================================
+//
+// DocInfoCache.h
+//
+//========================================================================
+
+#ifndef DOCINFOCACHE_H
+#define DOCINFOCACHE_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+class GooString;
+class CacheDir;
+struct PDFCorePageGeom;
+
+//------------------------------------------------------------------------
+// DocInfoCache
+//------------------------------------------------------------------------
+
+// A directory of per-document information that is expensive to
+// collect when a large document is opened -- currently, the page
+// geometry table, which otherwise requires loading every Page object.
+// Each document has one file, named after a hash of its path; the key
+// stored in the file (which includes the file's size, modification
+// time, and PDF ID) must match for the contents to be used.  Only the
+// most recently used documents are kept.
+class DocInfoCache {
+public:
+
+  // Use directory <dirA> (which is created if needed).  Takes
+  // ownership of <dirA>.
+  DocInfoCache(GooString *dirA);
+  ~DocInfoCache();
+
+  // Look for the page geometry of the document with <key> and
+  // <path>.  If found, and it has <nPages> pages, fill in <geom> and
+  // return true.
+  bool loadPageGeom(GooString *path, GooString *key,
+		    int nPages, PDFCorePageGeom *geom);
+
+  // Store the page geometry of the document with <key> and <path>.
+  void storePageGeom(GooString *path, GooString *key,
+		     int nPages, PDFCorePageGeom *geom);
+
+private:
+
+  CacheDir *cacheDir;
+};
+
+#endif
@@ -0,0 +1,270 @@
+//========================================================================
+//
+// DocLoader.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "poppler/goo/GooString.h"
+#include "poppler/ErrorCodes.h"
+#include "poppler/PDFDoc.h"
+#include "MappedFileStream.h"
+#include "Decompressor.h"
+#include "ProgressiveFile.h"
+#include "DocLoader.h"
+
+//------------------------------------------------------------------------
+// DocLoaderJob
+//------------------------------------------------------------------------
+
+// State shared by a DocLoader and its thread.  Whichever of them is
+// done with it last deletes it.
+struct DocLoaderJob {
+  pthread_mutex_t mutex;
+  int refCnt;
+  GooString *fileName;
+  GooString *ownerPassword;
+  GooString *userPassword;
+  void *guiData;
+  MappedFileStream *str;	// set while a memory-mapped file is being
+				//   opened
+  ProgressiveFile *prog;	// set while a file that is still arriving
+				//   is being opened
+  Decompressor *dec;		// set while a compressed file is being
+				//   decompressed
+  PDFDoc *doc;			// the result
+  ProgressiveFile *progFile;
+  int err;			// error code, if <doc> is NULL
+  int doneFD[2];		// pipe written to when the thread is done
+				//   (-1 if none)
+  bool done;
+  bool cancelled;
+};
+
+//------------------------------------------------------------------------
+// DocLoader
+//------------------------------------------------------------------------
+
+DocLoader::DocLoader(GooString *fileNameA, GooString *ownerPassword,
+		     GooString *userPassword, void *guiDataA) {
+  fileName = fileNameA->copy();
+  job = new DocLoaderJob;
+  pthread_mutex_init(&job->mutex, NULL);
+  job->refCnt = 2;
+  job->fileName = fileNameA->copy();
+  job->ownerPassword = ownerPassword ? ownerPassword->copy() : NULL;
+  job->userPassword = userPassword ? userPassword->copy() : NULL;
+  job->guiData = guiDataA;
+  job->str = NULL;
+  job->prog = NULL;
+  job->dec = NULL;
+  job->doc = NULL;
+  job->progFile = NULL;
+  job->err = errNone;
+  if (pipe(job->doneFD) == 0) {
+    fcntl(job->doneFD[0], F_SETFD, FD_CLOEXEC);
+    fcntl(job->doneFD[1], F_SETFD, FD_CLOEXEC);
+  } else {
+    job->doneFD[0] = job->doneFD[1] = -1;
+  }
+  job->done = false;
+  job->cancelled = false;
+  if (pthread_create(&thread, NULL, &threadMain, job) == 0) {
+    running = true;
+  } else {
+    // no thread -- just open the file here
+    running = false;
+    threadMain(job);
+  }
+}
+
+DocLoader::~DocLoader() {
+  if (running) {
+    if (isDone()) {
+      pthread_join(thread, NULL);
+    } else {
+      cancel();
+      pthread_detach(thread);
+    }
+  }
+  releaseJob(job);
+  delete fileName;
+}
+
+bool DocLoader::isDone() {
+  bool done;
+
+  pthread_mutex_lock(&job->mutex);
+  done = job->done;
+  pthread_mutex_unlock(&job->mutex);
+  return done;
+}
+
+void DocLoader::wait() {
+  if (running) {
+    pthread_join(thread, NULL);
+    running = false;
+  }
+}
+
+int DocLoader::getDoneFD() {
+  return job->doneFD[0];
+}
+
+double DocLoader::getProgress() {
+  double progress;
+
+  pthread_mutex_lock(&job->mutex);
+  if (job->dec) {
+    progress = job->dec->getProgress();
+  } else if (job->str) {
+    progress = job->str->getProgress();
+  } else {
+    progress = -1;
+  }
+  pthread_mutex_unlock(&job->mutex);
+  return progress;
+}
+
+void DocLoader::cancel() {
+  pthread_mutex_lock(&job->mutex);
+  job->cancelled = true;
+  if (job->dec) {
+    job->dec->abort();
+  }
+  if (job->str) {
+    job->str->abort();
+  }
+  if (job->prog) {
+    job->prog->abort();
+  }
+  pthread_mutex_unlock(&job->mutex);
+}
+
+PDFDoc *DocLoader::takeDoc(ProgressiveFile **progFileA, int *err) {
+  PDFDoc *doc;
+
+  pthread_mutex_lock(&job->mutex);
+  doc = job->doc;
+  *progFileA = job->progFile;
+  *err = job->err;
+  job->doc = NULL;
+  job->progFile = NULL;
+  pthread_mutex_unlock(&job->mutex);
+  return doc;
+}
+
+void *DocLoader::threadMain(void *arg) {
+  DocLoaderJob *job = (DocLoaderJob *)arg;
+  ProgressiveFile *prog;
+  Decompressor *dec;
+  BaseStream *decStr;
+  MappedFileStream *str;
+  PDFDoc *doc;
+  int err;
+
+  doc = NULL;
+  err = errNone;
+
+  // a file that is still arriving is opened as soon as its first page
+  // is there -- the rest is read by PDFCore::updateProgressiveLoad()
+  if ((prog = ProgressiveFile::open(job->fileName))) {
+    pthread_mutex_lock(&job->mutex);
+    job->prog = prog;
+    if (job->cancelled) {
+      prog->abort();
+    }
+    pthread_mutex_unlock(&job->mutex);
+    if (prog->waitForFirstPage()) {
+      doc = new PDFDoc(prog->makeStream(), job->ownerPassword,
+		       job->userPassword, job->guiData);
+    } else {
+      pthread_mutex_lock(&job->mutex);
+      job->prog = NULL;
+      pthread_mutex_unlock(&job->mutex);
+      delete prog;
+      prog = NULL;
+      err = errOpenFile;
+    }
+
+  // a compressed file is decompressed into memory
+  } else if ((dec = Decompressor::open(job->fileName))) {
+    pthread_mutex_lock(&job->mutex);
+    job->dec = dec;
+    if (job->cancelled) {
+      dec->abort();
+    }
+    pthread_mutex_unlock(&job->mutex);
+    decStr = dec->decompress();
+    pthread_mutex_lock(&job->mutex);
+    job->dec = NULL;
+    pthread_mutex_unlock(&job->mutex);
+    delete dec;
+    if (decStr) {
+      doc = new PDFDoc(decStr, job->ownerPassword, job->userPassword,
+		       job->guiData);
+    } else {
+      err = errOpenFile;
+    }
+
+  } else if ((str = MappedFileStream::open(job->fileName))) {
+    pthread_mutex_lock(&job->mutex);
+    job->str = str;
+    if (job->cancelled) {
+      str->abort();
+    }
+    pthread_mutex_unlock(&job->mutex);
+    doc = new PDFDoc(str, job->ownerPassword, job->userPassword,
+		     job->guiData);
+
+  } else {
+    doc = new PDFDoc(job->fileName->copy(), job->ownerPassword,
+		     job->userPassword, job->guiData);
+  }
+
+  pthread_mutex_lock(&job->mutex);
+  job->str = NULL;
+  job->prog = NULL;
+  job->doc = doc;
+  job->progFile = prog;
+  job->err = err;
+  job->done = true;
+  pthread_mutex_unlock(&job->mutex);
+  if (job->doneFD[1] >= 0) {
+    // a one-byte write to an empty pipe doesn't block
+    while (write(job->doneFD[1], "", 1) < 0 && errno == EINTR) {
+    }
+  }
+  releaseJob(job);
+  return NULL;
+}
+
+void DocLoader::releaseJob(DocLoaderJob *job) {
+  int refCnt;
+
+  pthread_mutex_lock(&job->mutex);
+  refCnt = --job->refCnt;
+  pthread_mutex_unlock(&job->mutex);
+  if (refCnt > 0) {
+    return;
+  }
+  // the ProgressiveFile, if any, is owned by the document's stream
+  delete job->doc;
+  delete job->fileName;
+  delete job->ownerPassword;
+  delete job->userPassword;
+  if (job->doneFD[0] >= 0) {
+    close(job->doneFD[0]);
+    close(job->doneFD[1]);
+  }
+  pthread_mutex_destroy(&job->mutex);
+  delete job;
+}
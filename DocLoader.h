@@ -0,0 +1,87 @@
+//========================================================================
+//
+// DocLoader.h
+//
+//========================================================================
+
+#ifndef DOCLOADER_H
+#define DOCLOADER_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <pthread.h>
+
+class GooString;
+class PDFDoc;
+class ProgressiveFile;
+struct DocLoaderJob;
+
+//------------------------------------------------------------------------
+// DocLoader
+//------------------------------------------------------------------------
+
+// Opens a PDF file on a separate thread, so that a slow open (e.g., a
+// large damaged file, whose xref table has to be reconstructed) doesn't
+// hold up the GUI.  The file is opened progressively if it's still
+// arriving, decompressed into memory if it's compressed, through a
+// memory mapping if possible, or else through a FileStream.  The
+// thread writes a byte to a pipe when it finishes (see getDoneFD), so a
+// GUI can wait for it in its event loop.
+class DocLoader {
+public:
+
+  // Start opening <fileNameA>.  <guiDataA> is passed to the PDFDoc.
+  DocLoader(GooString *fileNameA, GooString *ownerPassword,
+	    GooString *userPassword, void *guiDataA);
+
+  // If the thread is still running, cancel() it and let it clean up
+  // after itself.
+  ~DocLoader();
+
+  GooString *getFileName() { return fileName; }
+
+  // Returns true once the thread has finished.
+  bool isDone();
+
+  // Wait for the thread to finish.
+  void wait();
+
+  // Returns a file descriptor that becomes readable once the thread
+  // has finished, or -1 if the pipe couldn't be created (in which case
+  // isDone has to be polled).  The descriptor is closed when the
+  // DocLoader is deleted.
+  int getDoneFD();
+
+  // Returns the progress of the open, as a fraction, or -1 if it
+  // isn't known.
+  double getProgress();
+
+  // Ask the thread to give up.  Decompression stops, waits for a file
+  // that is still arriving end, and reads from a memory-mapped file
+  // start failing, so xref reconstruction ends quickly; otherwise the
+  // thread runs to completion, and its result is thrown away.
+  void cancel();
+
+  // Return the new document, or NULL if the file couldn't be opened
+  // at all (with the error code in *<err>).  The document may not be
+  // ok -- check PDFDoc::isOk.  For a file that is still arriving, the
+  // ProgressiveFile is returned in *<progFileA> (otherwise NULL).
+  // Must only be called once the thread is done.
+  PDFDoc *takeDoc(ProgressiveFile **progFileA, int *err);
+
+private:
+
+  static void *threadMain(void *arg);
+  static void releaseJob(DocLoaderJob *job);
+
+  GooString *fileName;
+  DocLoaderJob *job;		// shared with the thread
+  pthread_t thread;
+  bool running;			// set if <thread> hasn't been joined
+};
+
+#endif
@@ -151,6 +151,22 @@ GlobalParamsGUI::GlobalParamsGUI(char *cfgFileName) {
   GooString *fileName;
   FILE *f;
 
+  lowResFirstPaint = true;
+  interactiveDraft = true;
+  interactiveDraftLowRes = false;
+  interactiveIdleTime = 300;
+  enableDisplayLists = false;
+  displayListCacheSize = 32;
+  imageCacheSize = 64;
+  imagePageCacheSize = 64;
+  formCacheSize = 16;
+  tileCacheSize = 32;
+  mallocMmapThreshold = 0;
+  tileCacheDir = NULL;
+  tileCacheDiskSize = 256;
+  docInfoCacheDir = NULL;
+  orderedDither = false;
+
   // look for a user config file, then a system-wide config file
   f = NULL;
   fileName = NULL;
@@ -461,6 +477,50 @@ void GlobalParamsGUI::parseLine(char *buf, GooString *fileName, int line) {
 		 tokens, fileName, line);
     } else if (!cmd->cmp("strokeAdjust")) {
       parseYesNo("strokeAdjust", &strokeAdjust, tokens, fileName, line);
+    } else if (!cmd->cmp("lowResFirstPaint")) {
+      parseYesNo("lowResFirstPaint", &lowResFirstPaint,
+		 tokens, fileName, line);
+    } else if (!cmd->cmp("interactiveDraft")) {
+      parseYesNo("interactiveDraft", &interactiveDraft,
+		 tokens, fileName, line);
+    } else if (!cmd->cmp("interactiveDraftLowRes")) {
+      parseYesNo("interactiveDraftLowRes", &interactiveDraftLowRes,
+		 tokens, fileName, line);
+    } else if (!cmd->cmp("interactiveIdleTime")) {
+      parseInteger("interactiveIdleTime", &interactiveIdleTime,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("enableDisplayLists")) {
+      parseYesNo("enableDisplayLists", &enableDisplayLists,
+		 tokens, fileName, line);
+    } else if (!cmd->cmp("displayListCacheSize")) {
+      parseInteger("displayListCacheSize", &displayListCacheSize,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("imageCacheSize")) {
+      parseInteger("imageCacheSize", &imageCacheSize,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("imagePageCacheSize")) {
+      parseInteger("imagePageCacheSize", &imagePageCacheSize,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("formCacheSize")) {
+      parseInteger("formCacheSize", &formCacheSize,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("tileCacheSize")) {
+      parseInteger("tileCacheSize", &tileCacheSize,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("mallocMmapThreshold")) {
+      parseInteger("mallocMmapThreshold", &mallocMmapThreshold,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("tileCacheDir")) {
+      parseCommand("tileCacheDir", &tileCacheDir, tokens, fileName, line);
+    } else if (!cmd->cmp("tileCacheDiskSize")) {
+      parseInteger("tileCacheDiskSize", &tileCacheDiskSize,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("docInfoCacheDir")) {
+      parseCommand("docInfoCacheDir", &docInfoCacheDir,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("orderedDither")) {
+      parseYesNo("orderedDither", &orderedDither,
+		 tokens, fileName, line);
     } else if (!cmd->cmp("screenType")) {
       parseScreenType(tokens, fileName, line);
     } else if (!cmd->cmp("screenSize")) {
@@ -1260,6 +1320,141 @@ bool GlobalParamsGUI::getStrokeAdjust() {
   return f;
 }
 
+bool GlobalParamsGUI::getLowResFirstPaint() {
+  bool f;
+
+  lockGlobalParamsGUI;
+  f = lowResFirstPaint;
+  unlockGlobalParamsGUI;
+  return f;
+}
+
+bool GlobalParamsGUI::getInteractiveDraft() {
+  bool f;
+
+  lockGlobalParamsGUI;
+  f = interactiveDraft;
+  unlockGlobalParamsGUI;
+  return f;
+}
+
+bool GlobalParamsGUI::getInteractiveDraftLowRes() {
+  bool f;
+
+  lockGlobalParamsGUI;
+  f = interactiveDraftLowRes;
+  unlockGlobalParamsGUI;
+  return f;
+}
+
+int GlobalParamsGUI::getInteractiveIdleTime() {
+  int t;
+
+  lockGlobalParamsGUI;
+  t = interactiveIdleTime;
+  unlockGlobalParamsGUI;
+  return t;
+}
+
+bool GlobalParamsGUI::getEnableDisplayLists() {
+  bool f;
+
+  lockGlobalParamsGUI;
+  f = enableDisplayLists;
+  unlockGlobalParamsGUI;
+  return f;
+}
+
+int GlobalParamsGUI::getDisplayListCacheSize() {
+  int size;
+
+  lockGlobalParamsGUI;
+  size = displayListCacheSize;
+  unlockGlobalParamsGUI;
+  return size;
+}
+
+int GlobalParamsGUI::getImageCacheSize() {
+  int size;
+
+  lockGlobalParamsGUI;
+  size = imageCacheSize;
+  unlockGlobalParamsGUI;
+  return size;
+}
+
+int GlobalParamsGUI::getImagePageCacheSize() {
+  int size;
+
+  lockGlobalParamsGUI;
+  size = imagePageCacheSize;
+  unlockGlobalParamsGUI;
+  return size;
+}
+
+int GlobalParamsGUI::getFormCacheSize() {
+  int size;
+
+  lockGlobalParamsGUI;
+  size = formCacheSize;
+  unlockGlobalParamsGUI;
+  return size;
+}
+
+int GlobalParamsGUI::getTileCacheSize() {
+  int size;
+
+  lockGlobalParamsGUI;
+  size = tileCacheSize;
+  unlockGlobalParamsGUI;
+  return size;
+}
+
+GooString *GlobalParamsGUI::getTileCacheDir() {
+  GooString *s;
+
+  lockGlobalParamsGUI;
+  s = tileCacheDir ? tileCacheDir->copy() : NULL;
+  unlockGlobalParamsGUI;
+  return s;
+}
+
+int GlobalParamsGUI::getMallocMmapThreshold() {
+  int threshold;
+
+  lockGlobalParamsGUI;
+  threshold = mallocMmapThreshold;
+  unlockGlobalParamsGUI;
+  return threshold;
+}
+
+int GlobalParamsGUI::getTileCacheDiskSize() {
+  int size;
+
+  lockGlobalParamsGUI;
+  size = tileCacheDiskSize;
+  unlockGlobalParamsGUI;
+  return size;
+}
+
+GooString *GlobalParamsGUI::getDocInfoCacheDir() {
+  GooString *s;
+
+  lockGlobalParamsGUI;
+  s = docInfoCacheDir ? docInfoCacheDir->copy() : NULL;
+  unlockGlobalParamsGUI;
+  return s;
+}
+
+bool GlobalParamsGUI::getOrderedDither() {
+  bool ordered;
+
+  lockGlobalParamsGUI;
+  ordered = orderedDither;
+  unlockGlobalParamsGUI;
+  return ordered;
+}
+
 ScreenType GlobalParamsGUI::getScreenType() {
   ScreenType t;
 
@@ -1698,6 +1893,102 @@ void GlobalParamsGUI::setStrokeAdjust(bool adjust)
   unlockGlobalParamsGUI;
 }
 
+void GlobalParamsGUI::setLowResFirstPaint(bool lowRes) {
+  lockGlobalParamsGUI;
+  lowResFirstPaint = lowRes;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setInteractiveDraft(bool draft) {
+  lockGlobalParamsGUI;
+  interactiveDraft = draft;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setInteractiveDraftLowRes(bool lowRes) {
+  lockGlobalParamsGUI;
+  interactiveDraftLowRes = lowRes;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setInteractiveIdleTime(int idleTime) {
+  lockGlobalParamsGUI;
+  interactiveIdleTime = idleTime;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setEnableDisplayLists(bool enable) {
+  lockGlobalParamsGUI;
+  enableDisplayLists = enable;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setDisplayListCacheSize(int size) {
+  lockGlobalParamsGUI;
+  displayListCacheSize = size;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setImageCacheSize(int size) {
+  lockGlobalParamsGUI;
+  imageCacheSize = size;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setImagePageCacheSize(int size) {
+  lockGlobalParamsGUI;
+  imagePageCacheSize = size;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setFormCacheSize(int size) {
+  lockGlobalParamsGUI;
+  formCacheSize = size;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setTileCacheSize(int size) {
+  lockGlobalParamsGUI;
+  tileCacheSize = size;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setTileCacheDir(char *dir) {
+  lockGlobalParamsGUI;
+  if (tileCacheDir) {
+    delete tileCacheDir;
+  }
+  tileCacheDir = new GooString(dir);
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setMallocMmapThreshold(int threshold) {
+  lockGlobalParamsGUI;
+  mallocMmapThreshold = threshold;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setTileCacheDiskSize(int size) {
+  lockGlobalParamsGUI;
+  tileCacheDiskSize = size;
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setDocInfoCacheDir(char *dir) {
+  lockGlobalParamsGUI;
+  if (docInfoCacheDir) {
+    delete docInfoCacheDir;
+  }
+  docInfoCacheDir = new GooString(dir);
+  unlockGlobalParamsGUI;
+}
+
+void GlobalParamsGUI::setOrderedDither(bool ordered) {
+  lockGlobalParamsGUI;
+  orderedDither = ordered;
+  unlockGlobalParamsGUI;
+}
+
 void GlobalParamsGUI::setScreenType(ScreenType st)
 {
   lockGlobalParamsGUI;
@@ -131,6 +131,21 @@ public:
   GBool getAntialias();
   GBool getVectorAntialias();
   GBool getStrokeAdjust();
+  GBool getLowResFirstPaint();
+  GBool getInteractiveDraft();
+  GBool getInteractiveDraftLowRes();
+  int getInteractiveIdleTime();
+  GBool getEnableDisplayLists();
+  int getDisplayListCacheSize();
+  int getImageCacheSize();
+  int getImagePageCacheSize();
+  int getFormCacheSize();
+  int getTileCacheSize();
+  GooString *getTileCacheDir();
+  int getTileCacheDiskSize();
+  int getMallocMmapThreshold();
+  GooString *getDocInfoCacheDir();
+  GBool getOrderedDither();
   ScreenType getScreenType();
   int getScreenSize();
   int getScreenDotRadius();
@@ -185,6 +200,21 @@ public:
   GBool setAntialias(char *s);
   GBool setVectorAntialias(char *s);
   void setStrokeAdjust(GBool strokeAdjust);
+  void setLowResFirstPaint(GBool lowRes);
+  void setInteractiveDraft(GBool draft);
+  void setInteractiveDraftLowRes(GBool lowRes);
+  void setInteractiveIdleTime(int idleTime);
+  void setEnableDisplayLists(GBool enable);
+  void setDisplayListCacheSize(int size);
+  void setImageCacheSize(int size);
+  void setImagePageCacheSize(int size);
+  void setFormCacheSize(int size);
+  void setTileCacheSize(int size);
+  void setTileCacheDir(char *dir);
+  void setTileCacheDiskSize(int size);
+  void setMallocMmapThreshold(int threshold);
+  void setDocInfoCacheDir(char *dir);
+  void setOrderedDither(GBool ordered);
   void setScreenType(ScreenType st);
   void setScreenSize(int size);
   void setScreenDotRadius(int radius);
@@ -312,6 +342,32 @@ private:
   GBool antialias;		// anti-aliasing enable flag
   GBool vectorAntialias;	// vector anti-aliasing enable flag
   GBool strokeAdjust;		// stroke adjustment enable flag
+  GBool lowResFirstPaint;	// put up a low-res draft before rendering
+				//   a newly displayed page?
+  GBool interactiveDraft;	// render in draft quality while scrolling
+				//   or zooming?
+  GBool interactiveDraftLowRes;	// render drafts at reduced resolution?
+  int interactiveIdleTime;	// idle time (ms) before drafts are
+				//   re-rendered at full quality
+  GBool enableDisplayLists;	// record pages into display lists?
+  int displayListCacheSize;	// max memory for display lists, in MB
+  int imageCacheSize;		// max memory for decoded images, in MB
+  int imagePageCacheSize;	// max memory for decoded single-image
+				//   pages, in MB
+  int formCacheSize;		// max memory for rasterized forms, in MB
+  int tileCacheSize;		// max memory for compressed tiles that
+				//   are no longer displayed, in MB
+  GooString *tileCacheDir;	// directory for the on-disk tile cache
+				//   (NULL to disable it)
+  int tileCacheDiskSize;	// max disk space for the on-disk tile
+				//   cache, in MB
+  int mallocMmapThreshold;	// fixed malloc mmap threshold, in KB (0
+				//   to keep the C library's default)
+  GooString *docInfoCacheDir;	// directory for the cached page geometry
+				//   of large documents (NULL to disable)
+  GBool orderedDither;		// use ordered (Bayer) dithering, instead
+				//   of Floyd-Steinberg, on color-mapped
+				//   displays?
   ScreenType screenType;	// halftone screen type
   int screenSize;		// screen matrix size
   int screenDotRadius;		// screen dot radius
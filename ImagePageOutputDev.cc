@@ -0,0 +1,690 @@
+//========================================================================
+//
+// ImagePageOutputDev.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <math.h>
+#include <string.h>
+#include "poppler/goo/gmem.h"
+#include "poppler/splash/SplashBitmap.h"
+#include "poppler/GfxState.h"
+#include "poppler/Stream.h"
+#include "poppler/Page.h"
+#include "poppler/SplashOutputDev.h"
+#include "CoreOutputDev.h"
+#include "ImagePageOutputDev.h"
+
+//------------------------------------------------------------------------
+
+// <r> = <a> * <b>
+static void concatMatrix(double *a, double *b, double *r) {
+  r[0] = a[0] * b[0] + a[1] * b[2];
+  r[1] = a[0] * b[1] + a[1] * b[3];
+  r[2] = a[2] * b[0] + a[3] * b[2];
+  r[3] = a[2] * b[1] + a[3] * b[3];
+  r[4] = a[4] * b[0] + a[5] * b[2] + b[4];
+  r[5] = a[4] * b[1] + a[5] * b[3] + b[5];
+}
+
+// Compute the range [<lo>, <hi>) of image pixels (out of <n>) whose
+// centers lie between image coordinates <s0> and <s1>, which are the
+// edges of one device pixel.  If the device pixel is smaller than an
+// image pixel, this is the single image pixel under its center.  Sets
+// <lo> = <hi> if the device pixel's center is outside the image.
+static void sampleRange(double s0, double s1, int n, int *lo, int *hi) {
+  double t, c;
+
+  if (s0 > s1) {
+    t = s0;  s0 = s1;  s1 = t;
+  }
+  c = 0.5 * (s0 + s1);
+  if (c < 0 || c >= n) {
+    *lo = *hi = 0;
+    return;
+  }
+  *lo = (int)ceil(s0 - 0.5);
+  *hi = (int)ceil(s1 - 0.5);
+  if (*lo < 0) {
+    *lo = 0;
+  }
+  if (*hi > n) {
+    *hi = n;
+  }
+  if (*hi <= *lo) {
+    *lo = (int)floor(c);
+    *hi = *lo + 1;
+  }
+}
+
+//------------------------------------------------------------------------
+// ImagePage
+//------------------------------------------------------------------------
+
+ImagePage::ImagePage(int pageA) {
+  page = pageA;
+  ok = true;
+  size = sizeof(ImagePage);
+  imgRef.num = imgRef.gen = -1;
+  data = NULL;
+  width = height = 0;
+  nComps = 1;
+  mask = false;
+  fill[0] = fill[1] = fill[2] = 0;
+  clipXMin = clipYMin = clipXMax = clipYMax = 0;
+}
+
+ImagePage::~ImagePage() {
+  gfree(data);
+}
+
+void ImagePage::displaySlice(SplashOutputDev *out, Page *pageA, double dpi,
+			     int rotate, int sliceX, int sliceY,
+			     int sliceW, int sliceH) {
+  PDFRectangle box;
+  GfxState *state;
+  GBool crop;
+
+  // this mirrors what Page::displaySlice and the Gfx constructor do;
+  // the crop box clip is part of the recorded clip rectangle
+  rotate += pageA->getRotate();
+  if (rotate >= 360) {
+    rotate -= 360;
+  } else if (rotate < 0) {
+    rotate += 360;
+  }
+  pageA->makeBox(dpi, dpi, rotate, gFalse, out->upsideDown(),
+		 sliceX, sliceY, sliceW, sliceH, &box, &crop);
+  state = new GfxState(dpi, dpi, &box, rotate, out->upsideDown());
+  out->startPage(page, state);
+  out->setDefaultCTM(state->getCTM());
+  draw(out->getBitmap(), state->getCTM());
+  out->endPage();
+  delete state;
+}
+
+void ImagePage::draw(SplashBitmap *bitmap, double *baseCTM) {
+  Guchar *p;
+  Guchar rgb[3];
+  double inv[6], mat[6], m[6], det;
+  double x0, y0, x1, y1, cx0, cy0, cx1, cy1, s0, s1;
+  int *xLo, *xHi, *yLo, *yHi;
+  int w, h, i0, i1, j0, j1, x, y, i, j;
+  unsigned long long n, sum0, sum1, sum2;
+  bool swap;
+
+  // mat maps the recording device space to the new device space
+  det = 1 / (recCTM[0] * recCTM[3] - recCTM[1] * recCTM[2]);
+  inv[0] = recCTM[3] * det;
+  inv[1] = -recCTM[1] * det;
+  inv[2] = -recCTM[2] * det;
+  inv[3] = recCTM[0] * det;
+  inv[4] = (recCTM[2] * recCTM[5] - recCTM[3] * recCTM[4]) * det;
+  inv[5] = (recCTM[1] * recCTM[4] - recCTM[0] * recCTM[5]) * det;
+  concatMatrix(inv, baseCTM, mat);
+
+  // m maps the image's unit square to the new device space
+  concatMatrix(imgMat, mat, m);
+
+  // the page is only rotated by multiples of 90 degrees, so the clip
+  // rectangle stays a rectangle
+  x0 = mat[0] * clipXMin + mat[2] * clipYMin + mat[4];
+  y0 = mat[1] * clipXMin + mat[3] * clipYMin + mat[5];
+  x1 = mat[0] * clipXMax + mat[2] * clipYMax + mat[4];
+  y1 = mat[1] * clipXMax + mat[3] * clipYMax + mat[5];
+  cx0 = x0 < x1 ? x0 : x1;
+  cx1 = x0 < x1 ? x1 : x0;
+  cy0 = y0 < y1 ? y0 : y1;
+  cy1 = y0 < y1 ? y1 : y0;
+
+  // the fast path handles images that are axis-aligned in device
+  // space (possibly flipped or rotated by 90 degrees); anything else
+  // is sampled pixel by pixel
+  if (fabs(m[1]) < 0.0001 && fabs(m[2]) < 0.0001) {
+    swap = false;
+  } else if (fabs(m[0]) < 0.0001 && fabs(m[3]) < 0.0001) {
+    swap = true;
+  } else {
+    drawNearest(bitmap, m, cx0, cy0, cx1, cy1);
+    return;
+  }
+
+  // for each device column, find the range of image pixels it covers
+  // (image columns -- or image rows, if the image is rotated by 90
+  // degrees); likewise for each device row
+  w = bitmap->getWidth();
+  h = bitmap->getHeight();
+  xLo = (int *)gmallocn(w, sizeof(int));
+  xHi = (int *)gmallocn(w, sizeof(int));
+  yLo = (int *)gmallocn(h, sizeof(int));
+  yHi = (int *)gmallocn(h, sizeof(int));
+  for (x = 0; x < w; ++x) {
+    if (x + 0.5 < cx0 || x + 0.5 >= cx1) {
+      xLo[x] = xHi[x] = 0;
+      continue;
+    }
+    if (swap) {
+      s0 = (1 - (x - m[4]) / m[2]) * height;
+      s1 = (1 - (x + 1 - m[4]) / m[2]) * height;
+      sampleRange(s0, s1, height, &xLo[x], &xHi[x]);
+    } else {
+      s0 = ((x - m[4]) / m[0]) * width;
+      s1 = ((x + 1 - m[4]) / m[0]) * width;
+      sampleRange(s0, s1, width, &xLo[x], &xHi[x]);
+    }
+  }
+  for (y = 0; y < h; ++y) {
+    if (y + 0.5 < cy0 || y + 0.5 >= cy1) {
+      yLo[y] = yHi[y] = 0;
+      continue;
+    }
+    if (swap) {
+      s0 = ((y - m[5]) / m[1]) * width;
+      s1 = ((y + 1 - m[5]) / m[1]) * width;
+      sampleRange(s0, s1, width, &yLo[y], &yHi[y]);
+    } else {
+      s0 = (1 - (y - m[5]) / m[3]) * height;
+      s1 = (1 - (y + 1 - m[5]) / m[3]) * height;
+      sampleRange(s0, s1, height, &yLo[y], &yHi[y]);
+    }
+  }
+
+  // box-filter the image pixels under each device pixel
+  for (y = 0; y < h; ++y) {
+    if (yLo[y] >= yHi[y]) {
+      continue;
+    }
+    for (x = 0; x < w; ++x) {
+      if (xLo[x] >= xHi[x]) {
+	continue;
+      }
+      if (swap) {
+	i0 = yLo[y];  i1 = yHi[y];
+	j0 = xLo[x];  j1 = xHi[x];
+      } else {
+	i0 = xLo[x];  i1 = xHi[x];
+	j0 = yLo[y];  j1 = yHi[y];
+      }
+      // a device pixel can cover millions of pixels of a high-res
+      // image, so the sums are 64-bit
+      n = (unsigned long long)(i1 - i0) * (j1 - j0);
+      sum0 = sum1 = sum2 = 0;
+      if (nComps == 1) {
+	for (j = j0; j < j1; ++j) {
+	  p = data + j * width + i0;
+	  for (i = i0; i < i1; ++i) {
+	    sum0 += *p++;
+	  }
+	}
+	sum1 = sum2 = sum0;
+      } else {
+	for (j = j0; j < j1; ++j) {
+	  p = data + (j * width + i0) * 3;
+	  for (i = i0; i < i1; ++i) {
+	    sum0 += *p++;
+	    sum1 += *p++;
+	    sum2 += *p++;
+	  }
+	}
+      }
+      if (mask) {
+	if (sum0 > 0) {
+	  putPixel(bitmap, x, y, fill, (Guchar)((sum0 + n / 2) / n));
+	}
+      } else {
+	rgb[0] = (Guchar)((sum0 + n / 2) / n);
+	rgb[1] = (Guchar)((sum1 + n / 2) / n);
+	rgb[2] = (Guchar)((sum2 + n / 2) / n);
+	putPixel(bitmap, x, y, rgb, 255);
+      }
+    }
+  }
+
+  gfree(xLo);
+  gfree(xHi);
+  gfree(yLo);
+  gfree(yHi);
+}
+
+// Point-sample an image that is skewed or rotated by an arbitrary
+// angle.
+void ImagePage::drawNearest(SplashBitmap *bitmap, double *m,
+			    double cx0, double cy0, double cx1, double cy1) {
+  Guchar *p;
+  Guchar rgb[3];
+  double inv[6], det, xx, yy, u, v;
+  int w, h, x, y, i, j;
+
+  det = m[0] * m[3] - m[1] * m[2];
+  if (fabs(det) < 1e-9) {
+    return;
+  }
+  det = 1 / det;
+  inv[0] = m[3] * det;
+  inv[1] = -m[1] * det;
+  inv[2] = -m[2] * det;
+  inv[3] = m[0] * det;
+  inv[4] = (m[2] * m[5] - m[3] * m[4]) * det;
+  inv[5] = (m[1] * m[4] - m[0] * m[5]) * det;
+
+  w = bitmap->getWidth();
+  h = bitmap->getHeight();
+  for (y = 0; y < h; ++y) {
+    yy = y + 0.5;
+    if (yy < cy0 || yy >= cy1) {
+      continue;
+    }
+    for (x = 0; x < w; ++x) {
+      xx = x + 0.5;
+      if (xx < cx0 || xx >= cx1) {
+	continue;
+      }
+      u = inv[0] * xx + inv[2] * yy + inv[4];
+      v = inv[1] * xx + inv[3] * yy + inv[5];
+      if (u < 0 || u >= 1 || v <= 0 || v > 1) {
+	continue;
+      }
+      i = (int)(u * width);
+      j = (int)((1 - v) * height);
+      if (i >= width || j >= height) {
+	continue;
+      }
+      if (nComps == 1) {
+	p = data + j * width + i;
+	if (mask) {
+	  if (*p) {
+	    putPixel(bitmap, x, y, fill, *p);
+	  }
+	  continue;
+	}
+	rgb[0] = rgb[1] = rgb[2] = *p;
+      } else {
+	p = data + (j * width + i) * 3;
+	rgb[0] = p[0];
+	rgb[1] = p[1];
+	rgb[2] = p[2];
+      }
+      putPixel(bitmap, x, y, rgb, 255);
+    }
+  }
+}
+
+// Composite color <rgb> with coverage <a> over pixel (<x>, <y>).
+void ImagePage::putPixel(SplashBitmap *bitmap, int x, int y,
+			 Guchar *rgb, int a) {
+  SplashColorPtr p;
+  Guchar *q;
+  int gray;
+
+  p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+  switch (bitmap->getMode()) {
+  case splashModeMono8:
+    p += x;
+    gray = (rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29 + 128) >> 8;
+    p[0] = (Guchar)((p[0] * (255 - a) + gray * a + 127) / 255);
+    break;
+  case splashModeRGB8:
+    p += 3 * x;
+    p[0] = (Guchar)((p[0] * (255 - a) + rgb[0] * a + 127) / 255);
+    p[1] = (Guchar)((p[1] * (255 - a) + rgb[1] * a + 127) / 255);
+    p[2] = (Guchar)((p[2] * (255 - a) + rgb[2] * a + 127) / 255);
+    break;
+  case splashModeBGR8:
+    p += 3 * x;
+    p[0] = (Guchar)((p[0] * (255 - a) + rgb[2] * a + 127) / 255);
+    p[1] = (Guchar)((p[1] * (255 - a) + rgb[1] * a + 127) / 255);
+    p[2] = (Guchar)((p[2] * (255 - a) + rgb[0] * a + 127) / 255);
+    break;
+  case splashModeXBGR8:
+    p += 4 * x;
+    p[0] = (Guchar)((p[0] * (255 - a) + rgb[2] * a + 127) / 255);
+    p[1] = (Guchar)((p[1] * (255 - a) + rgb[1] * a + 127) / 255);
+    p[2] = (Guchar)((p[2] * (255 - a) + rgb[0] * a + 127) / 255);
+    p[3] = 255;
+    break;
+  default:
+    return;
+  }
+  if ((q = bitmap->getAlphaPtr())) {
+    q += y * bitmap->getWidth() + x;
+    *q = (Guchar)(*q + a - (*q * a + 127) / 255);
+  }
+}
+
+//------------------------------------------------------------------------
+// ImagePageOutputDev
+//------------------------------------------------------------------------
+
+// Returns true if the current path is an axis-aligned rectangle in
+// device space.
+static bool isRectPath(GfxState *state) {
+  GfxPath *path;
+  GfxSubpath *subpath;
+  double x[5], y[5];
+  int n, i, j;
+
+  path = state->getPath();
+  if (path->getNumSubpaths() != 1) {
+    return false;
+  }
+  subpath = path->getSubpath(0);
+  n = subpath->getNumPoints();
+  if (n != 4 && n != 5) {
+    return false;
+  }
+  for (i = 0; i < n; ++i) {
+    if (subpath->getCurve(i)) {
+      return false;
+    }
+    state->transform(subpath->getX(i), subpath->getY(i), &x[i], &y[i]);
+  }
+  if (n == 5) {
+    if (fabs(x[4] - x[0]) > 0.01 || fabs(y[4] - y[0]) > 0.01) {
+      return false;
+    }
+    n = 4;
+  }
+  for (i = 0; i < n; ++i) {
+    j = (i + 1) % n;
+    if (fabs(x[i] - x[j]) > 0.01 && fabs(y[i] - y[j]) > 0.01) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ImagePageOutputDev::ImagePageOutputDev(int pageA, size_t maxSizeA,
+				       CoreImageCache *imageCacheA) {
+  imgPage = new ImagePage(pageA);
+  maxSize = maxSizeA;
+  imageCache = imageCacheA;
+}
+
+ImagePageOutputDev::~ImagePageOutputDev() {
+  delete imgPage;
+}
+
+ImagePage *ImagePageOutputDev::takeImagePage() {
+  ImagePage *ret;
+
+  ret = imgPage;
+  imgPage = new ImagePage(ret->page);
+  return ret;
+}
+
+GBool ImagePageOutputDev::abortCheckCbk(void *data) {
+  ImagePageOutputDev *out = (ImagePageOutputDev *)data;
+
+  return !out->imgPage->ok;
+}
+
+void ImagePageOutputDev::startPage(int pageNum, GfxState *state) {
+  memcpy(imgPage->recCTM, state->getCTM(), 6 * sizeof(double));
+}
+
+void ImagePageOutputDev::endPage() {
+  // a blank page is rasterized quickly enough anyway
+  if (!imgPage->data) {
+    fail();
+  }
+}
+
+void ImagePageOutputDev::stroke(GfxState *state) {
+  fail();
+}
+
+void ImagePageOutputDev::fill(GfxState *state) {
+  fail();
+}
+
+void ImagePageOutputDev::eoFill(GfxState *state) {
+  fail();
+}
+
+GBool ImagePageOutputDev::useShadedFills(int type) {
+  fail();
+  return gFalse;
+}
+
+void ImagePageOutputDev::clip(GfxState *state) {
+  // GfxState has already intersected its clip bbox with the path,
+  // which is exact for rectangles
+  if (!isRectPath(state)) {
+    fail();
+  }
+}
+
+void ImagePageOutputDev::eoClip(GfxState *state) {
+  if (!isRectPath(state)) {
+    fail();
+  }
+}
+
+void ImagePageOutputDev::clipToStrokePath(GfxState *state) {
+  fail();
+}
+
+void ImagePageOutputDev::drawChar(GfxState *state, double x, double y,
+				  double dx, double dy,
+				  double originX, double originY,
+				  CharCode code, int nBytes,
+				  Unicode *u, int uLen) {
+  // invisible text (e.g., the OCR layer of a scanned page) doesn't
+  // draw anything
+  if (state->getRender() != 3) {
+    fail();
+  }
+}
+
+void ImagePageOutputDev::drawImageMask(GfxState *state, Object *ref,
+				       Stream *str,
+				       int width, int height, GBool invert,
+				       GBool interpolate, GBool inlineImg) {
+  ImageStream *imgStr;
+  Stream *cached;
+  GfxRGB rgb;
+  Guchar *p, *line;
+  int invertBit, x, y;
+
+  if (state->getFillColorSpace()->getMode() == csPattern ||
+      !startImage(state, width, height, 1)) {
+    fail();
+    OutputDev::drawImageMask(state, ref, str, width, height, invert,
+			     interpolate, inlineImg);
+    return;
+  }
+  if (ref && ref->isRef()) {
+    imgPage->imgRef = ref->getRef();
+  }
+  imgPage->mask = true;
+  state->getFillRGB(&rgb);
+  imgPage->fill[0] = colToByte(rgb.r);
+  imgPage->fill[1] = colToByte(rgb.g);
+  imgPage->fill[2] = colToByte(rgb.b);
+
+  // store the coverage: 255 where the mask is painted, 0 elsewhere
+  cached = (imageCache && !inlineImg) ?
+             imageCache->getImage(ref, str, width, height, 1, 1) :
+             (Stream *)NULL;
+  imgStr = new ImageStream(cached ? cached : str, width, 1, 1);
+  imgStr->reset();
+  invertBit = invert ? 1 : 0;
+  p = imgPage->data;
+  for (y = 0; y < height; ++y) {
+    if (!(line = imgStr->getLine())) {
+      memset(p, 0, (height - y) * width);
+      break;
+    }
+    for (x = 0; x < width; ++x) {
+      *p++ = (line[x] ^ invertBit) ? 0 : 255;
+    }
+  }
+  imgStr->close();
+  delete imgStr;
+  delete cached;
+}
+
+void ImagePageOutputDev::drawImage(GfxState *state, Object *ref,
+				   Stream *str,
+				   int width, int height,
+				   GfxImageColorMap *colorMap,
+				   GBool interpolate, int *maskColors,
+				   GBool inlineImg) {
+  ImageStream *imgStr;
+  Stream *cached;
+  GfxRGB rgb;
+  Guchar *lut, *p, *line;
+  Guchar pix;
+  bool gray;
+  int nCompsIn, nBits, n, i, x, y;
+
+  nCompsIn = colorMap->getNumPixelComps();
+  nBits = colorMap->getBits();
+
+  // one-component images (gray or indexed) are converted through a
+  // lookup table; those that only use gray levels are stored as gray
+  lut = NULL;
+  gray = false;
+  if (nCompsIn == 1 && nBits <= 8) {
+    n = 1 << nBits;
+    lut = (Guchar *)gmallocn(n, 3);
+    gray = true;
+    for (i = 0; i < n; ++i) {
+      pix = (Guchar)i;
+      colorMap->getRGB(&pix, &rgb);
+      lut[3*i] = colToByte(rgb.r);
+      lut[3*i+1] = colToByte(rgb.g);
+      lut[3*i+2] = colToByte(rgb.b);
+      if (lut[3*i] != lut[3*i+1] || lut[3*i] != lut[3*i+2]) {
+	gray = false;
+      }
+    }
+  }
+
+  if (maskColors || nBits > 8 ||
+      !startImage(state, width, height, gray ? 1 : 3)) {
+    gfree(lut);
+    fail();
+    OutputDev::drawImage(state, ref, str, width, height, colorMap,
+			 interpolate, maskColors, inlineImg);
+    return;
+  }
+  if (ref && ref->isRef()) {
+    imgPage->imgRef = ref->getRef();
+  }
+
+  cached = (imageCache && !inlineImg) ?
+             imageCache->getImage(ref, str, width, height,
+				  nCompsIn, nBits) :
+             (Stream *)NULL;
+  imgStr = new ImageStream(cached ? cached : str, width, nCompsIn, nBits);
+  imgStr->reset();
+  p = imgPage->data;
+  for (y = 0; y < height; ++y) {
+    if (!(line = imgStr->getLine())) {
+      memset(p, 0, (size_t)(height - y) * width * imgPage->nComps);
+      break;
+    }
+    if (gray) {
+      for (x = 0; x < width; ++x) {
+	*p++ = lut[3 * line[x]];
+      }
+    } else if (lut) {
+      for (x = 0; x < width; ++x) {
+	memcpy(p, lut + 3 * line[x], 3);
+	p += 3;
+      }
+    } else {
+      colorMap->getRGBLine(line, p, width);
+      p += 3 * width;
+    }
+  }
+  imgStr->close();
+  delete imgStr;
+  delete cached;
+  gfree(lut);
+}
+
+void ImagePageOutputDev::drawMaskedImage(GfxState *state, Object *ref,
+					 Stream *str,
+					 int width, int height,
+					 GfxImageColorMap *colorMap,
+					 GBool interpolate,
+					 Stream *maskStr,
+					 int maskWidth, int maskHeight,
+					 GBool maskInvert,
+					 GBool maskInterpolate) {
+  fail();
+  OutputDev::drawMaskedImage(state, ref, str, width, height, colorMap,
+			     interpolate, maskStr, maskWidth, maskHeight,
+			     maskInvert, maskInterpolate);
+}
+
+void ImagePageOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
+					     Stream *str,
+					     int width, int height,
+					     GfxImageColorMap *colorMap,
+					     GBool interpolate,
+					     Stream *maskStr,
+					     int maskWidth, int maskHeight,
+					     GfxImageColorMap *maskColorMap,
+					     GBool maskInterpolate) {
+  fail();
+  OutputDev::drawSoftMaskedImage(state, ref, str, width, height, colorMap,
+				 interpolate, maskStr, maskWidth, maskHeight,
+				 maskColorMap, maskInterpolate);
+}
+
+void ImagePageOutputDev::beginTransparencyGroup(
+				      GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask) {
+  fail();
+}
+
+void ImagePageOutputDev::setSoftMask(GfxState *state, double *bbox,
+				     GBool alpha, Function *transferFunc,
+				     GfxColor *backdropColor) {
+  fail();
+}
+
+// Check that the page can still be a single-image page, and allocate
+// the decoded image.
+bool ImagePageOutputDev::startImage(GfxState *state, int width, int height,
+				    int nCompsA) {
+  if (!imgPage->ok || imgPage->data || width <= 0 || height <= 0 ||
+      state->getBlendMode() != gfxBlendNormal ||
+      state->getFillOpacity() != 1 ||
+      (size_t)height > maxSize / ((size_t)width * nCompsA)) {
+    return false;
+  }
+  imgPage->data = (Guchar *)gmallocn(height, width * nCompsA);
+  imgPage->width = width;
+  imgPage->height = height;
+  imgPage->nComps = nCompsA;
+  imgPage->size += (size_t)width * height * nCompsA;
+  memcpy(imgPage->imgMat, state->getCTM(), 6 * sizeof(double));
+  state->getClipBBox(&imgPage->clipXMin, &imgPage->clipYMin,
+		     &imgPage->clipXMax, &imgPage->clipYMax);
+  return true;
+}
+
+// Give up: the page isn't a single-image page.
+void ImagePageOutputDev::fail() {
+  int page;
+
+  if (!imgPage->ok) {
+    return;
+  }
+  page = imgPage->page;
+  delete imgPage;
+  imgPage = new ImagePage(page);
+  imgPage->ok = false;
+}
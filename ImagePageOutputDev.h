@@ -0,0 +1,192 @@
+//========================================================================
+//
+// ImagePageOutputDev.h
+//
+//========================================================================
+
+#ifndef IMAGEPAGEOUTPUTDEV_H
+#define IMAGEPAGEOUTPUTDEV_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "poppler/OutputDev.h"
+
+class Stream;
+class Function;
+class GfxState;
+class GfxColorSpace;
+class GfxImageColorMap;
+struct GfxColor;
+class Page;
+class SplashBitmap;
+class SplashOutputDev;
+class CoreImageCache;
+
+//------------------------------------------------------------------------
+// ImagePage
+//------------------------------------------------------------------------
+
+// A page whose only content is a single image (a typical scanned
+// page), as found by an ImagePageOutputDev.  The image is kept
+// decoded, so slices of the page can be produced by scaling it
+// directly, without running Gfx and Splash.
+class ImagePage {
+public:
+
+  ImagePage(int pageA);
+  ~ImagePage();
+
+  // Returns false if the page isn't a single-image page (or if the
+  // image is too large to keep).
+  bool isOk() { return ok; }
+
+  int getPage() { return page; }
+
+  // The image XObject (<num> is -1 for an inline image).
+  Ref getImageRef() { return imgRef; }
+
+  // Renumber the page (after the document has been reloaded, and the
+  // page has moved).
+  void setPage(int pageA) { page = pageA; }
+
+  // Approximate memory used by the decoded image, in bytes.
+  size_t getSize() { return size; }
+
+  // Rasterize a slice of the page into <out>, the same way
+  // PDFDoc::displayPageSlice would (with useMediaBox = false, crop =
+  // true).  <pageA> is the Page object for this page.  The device's
+  // color mode must not be splashModeMono1.
+  void displaySlice(SplashOutputDev *out, Page *pageA, double dpi,
+		    int rotate, int sliceX, int sliceY,
+		    int sliceW, int sliceH);
+
+private:
+
+  void draw(SplashBitmap *bitmap, double *baseCTM);
+  void drawNearest(SplashBitmap *bitmap, double *m,
+		   double cx0, double cy0, double cx1, double cy1);
+  void putPixel(SplashBitmap *bitmap, int x, int y, Guchar *rgb, int a);
+
+  int page;
+  bool ok;
+  size_t size;
+  double recCTM[6];		// base CTM at recording time
+  double imgMat[6];		// image CTM at recording time
+  double clipXMin, clipYMin,	// clip rectangle at recording time
+         clipXMax, clipYMax;
+  Ref imgRef;			// the image XObject
+  Guchar *data;			// decoded image, top row first
+  int width, height;		// image size, in pixels
+  int nComps;			// 1 (gray, or coverage for an image
+				//   mask) or 3 (RGB)
+  bool mask;			// set for an image mask
+  Guchar fill[3];		// image mask fill color (RGB)
+
+  friend class ImagePageOutputDev;
+};
+
+//------------------------------------------------------------------------
+// ImagePageOutputDev
+//------------------------------------------------------------------------
+
+// Checks whether a page consists of a single image (plus, at most,
+// rectangular clips and invisible text, e.g., an OCR layer), and if
+// so, decodes the image into an ImagePage.  Any other drawing
+// operation causes the check to fail.
+class ImagePageOutputDev: public OutputDev {
+public:
+
+  // Check page <pageA>.  Images larger than <maxSizeA> bytes (once
+  // decoded) are not kept.  If <imageCacheA> is non-NULL, the image
+  // data is read through it, so it won't need to be decoded again if
+  // the page turns out not to qualify.
+  ImagePageOutputDev(int pageA, size_t maxSizeA,
+		     CoreImageCache *imageCacheA);
+  virtual ~ImagePageOutputDev();
+
+  // Return the result, which is then owned by the caller.  If the
+  // page didn't qualify, isOk() returns false.
+  ImagePage *takeImagePage();
+
+  // Abort check callback for PDFDoc::displayPage: stops interpreting
+  // the page as soon as the check has failed.
+  static GBool abortCheckCbk(void *data);
+
+  //----- get info about output device
+
+  virtual GBool upsideDown() { return gTrue; }
+  virtual GBool useDrawChar() { return gTrue; }
+  virtual GBool interpretType3Chars() { return gFalse; }
+
+  //----- initialization and control
+
+  virtual void startPage(int pageNum, GfxState *state);
+  virtual void endPage();
+
+  //----- path painting
+
+  virtual void stroke(GfxState *state);
+  virtual void fill(GfxState *state);
+  virtual void eoFill(GfxState *state);
+  virtual GBool useShadedFills(int type);
+
+  //----- path clipping
+
+  virtual void clip(GfxState *state);
+  virtual void eoClip(GfxState *state);
+  virtual void clipToStrokePath(GfxState *state);
+
+  //----- text drawing
+
+  virtual void drawChar(GfxState *state, double x, double y,
+			double dx, double dy,
+			double originX, double originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+
+  //----- image drawing
+
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool interpolate, GBool inlineImg);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 GBool interpolate, int *maskColors, GBool inlineImg);
+  virtual void drawMaskedImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap, GBool interpolate,
+			       Stream *maskStr, int maskWidth, int maskHeight,
+			       GBool maskInvert, GBool maskInterpolate);
+  virtual void drawSoftMaskedImage(GfxState *state, Object *ref,
+				   Stream *str, int width, int height,
+				   GfxImageColorMap *colorMap,
+				   GBool interpolate,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GfxImageColorMap *maskColorMap,
+				   GBool maskInterpolate);
+
+  //----- transparency groups and soft masks
+
+  virtual void beginTransparencyGroup(GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask);
+  virtual void setSoftMask(GfxState *state, double *bbox, GBool alpha,
+			   Function *transferFunc, GfxColor *backdropColor);
+
+private:
+
+  bool startImage(GfxState *state, int width, int height, int nCompsA);
+  void fail();
+
+  ImagePage *imgPage;
+  size_t maxSize;
+  CoreImageCache *imageCache;
+};
+
+#endif
@@ -0,0 +1,182 @@
+//========================================================================
+//
+// MappedFileStream.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "poppler/goo/GooString.h"
+#include "poppler/Object.h"
+#include "MappedFileStream.h"
+
+//------------------------------------------------------------------------
+
+// Max number of files mapped at once; beyond this, files are read
+// with a FileStream.
+#define maxMappedFiles 256
+
+struct MappedRegion {
+  char *start;			// NULL for an unused slot
+  size_t len;
+};
+
+static MappedRegion mappedRegions[maxMappedFiles];
+static long mappedPageSize;
+static struct sigaction oldSigbusAction;
+static pthread_once_t sigbusHandlerOnce = PTHREAD_ONCE_INIT;
+
+// Handle a SIGBUS caused by reading a mapped file past its end (i.e.,
+// the file was truncated after it was mapped): replace the rest of the
+// mapping with zero-filled pages, and let the read continue.  Any
+// other SIGBUS goes to the previous handler.
+static void sigbusHandler(int sig, siginfo_t *info, void *ctx) {
+  char *addr, *start, *page;
+  size_t len;
+  int i;
+
+  addr = (char *)info->si_addr;
+  for (i = 0; i < maxMappedFiles; ++i) {
+    start = __atomic_load_n(&mappedRegions[i].start, __ATOMIC_ACQUIRE);
+    len = __atomic_load_n(&mappedRegions[i].len, __ATOMIC_ACQUIRE);
+    if (start && addr >= start && addr < start + len) {
+      page = start + ((addr - start) / mappedPageSize) * mappedPageSize;
+      if (mmap(page, start + len - page, PROT_READ,
+	       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0)
+	  != MAP_FAILED) {
+	return;
+      }
+      break;
+    }
+  }
+
+  // not ours -- restore the previous handler, which gets called when
+  // the faulting instruction is retried
+  sigaction(SIGBUS, &oldSigbusAction, NULL);
+}
+
+static void installSigbusHandler() {
+  struct sigaction act;
+
+  mappedPageSize = sysconf(_SC_PAGESIZE);
+  memset(&act, 0, sizeof(act));
+  act.sa_sigaction = &sigbusHandler;
+  sigemptyset(&act.sa_mask);
+  act.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigaction(SIGBUS, &act, &oldSigbusAction);
+}
+
+//------------------------------------------------------------------------
+// MappedFileStream
+//------------------------------------------------------------------------
+
+MappedFileStream *MappedFileStream::open(GooString *fileNameA) {
+  MappedFileStream *str;
+  struct stat st;
+  char *mapA;
+  Object obj;
+  int fd, i;
+
+  if ((fd = ::open(fileNameA->getCString(), O_RDONLY)) < 0) {
+    return NULL;
+  }
+
+  // stream positions are ints, so larger files can't be mapped as a
+  // whole -- these (and pipes, devices, etc.) go through a FileStream
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      st.st_size == 0 || st.st_size > INT_MAX) {
+    ::close(fd);
+    return NULL;
+  }
+  mapA = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapA == (char *)MAP_FAILED) {
+    return NULL;
+  }
+
+  // register the mapping with the SIGBUS handler
+  pthread_once(&sigbusHandlerOnce, &installSigbusHandler);
+  for (i = 0; i < maxMappedFiles; ++i) {
+    if (__sync_bool_compare_and_swap(&mappedRegions[i].start,
+				     (char *)NULL, mapA)) {
+      __atomic_store_n(&mappedRegions[i].len, (size_t)st.st_size,
+		       __ATOMIC_RELEASE);
+      break;
+    }
+  }
+  if (i == maxMappedFiles) {
+    munmap(mapA, st.st_size);
+    return NULL;
+  }
+
+  obj.initNull();
+  str = new MappedFileStream(mapA, st.st_size, fileNameA->copy(), &obj);
+  return str;
+}
+
+MappedFileStream::MappedFileStream(char *mapA, size_t mapLenA,
+				   GooString *fileNameA, Object *dictA):
+  MemStream(mapA, 0, (Guint)mapLenA, dictA)
+{
+  map = mapA;
+  mapLen = mapLenA;
+  fileName = fileNameA;
+  aborted = false;
+}
+
+MappedFileStream::~MappedFileStream() {
+  int i;
+
+  for (i = 0; i < maxMappedFiles; ++i) {
+    if (__atomic_load_n(&mappedRegions[i].start, __ATOMIC_ACQUIRE) == map) {
+      __atomic_store_n(&mappedRegions[i].len, (size_t)0, __ATOMIC_RELEASE);
+      __atomic_store_n(&mappedRegions[i].start, (char *)NULL,
+		       __ATOMIC_RELEASE);
+      break;
+    }
+  }
+  munmap(map, mapLen);
+  delete fileName;
+}
+
+double MappedFileStream::getProgress() {
+  char *p;
+
+  p = __atomic_load_n(&bufPtr, __ATOMIC_RELAXED);
+  return (double)(p - map) / (double)mapLen;
+}
+
+int MappedFileStream::getChar() {
+  if (__atomic_load_n(&aborted, __ATOMIC_RELAXED)) {
+    return EOF;
+  }
+  return MemStream::getChar();
+}
+
+int MappedFileStream::lookChar() {
+  if (__atomic_load_n(&aborted, __ATOMIC_RELAXED)) {
+    return EOF;
+  }
+  return MemStream::lookChar();
+}
+
+int MappedFileStream::getChars(int nChars, Guchar *buffer) {
+  if (__atomic_load_n(&aborted, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  return MemStream::getChars(nChars, buffer);
+}
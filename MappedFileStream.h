@@ -0,0 +1,71 @@
+//========================================================================
+//
+// MappedFileStream.h
+//
+//========================================================================
+
+#ifndef MAPPEDFILESTREAM_H
+#define MAPPEDFILESTREAM_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "poppler/Stream.h"
+
+class GooString;
+
+//------------------------------------------------------------------------
+// MappedFileStream
+//------------------------------------------------------------------------
+
+// A base stream that reads a PDF file through a read-only memory
+// mapping, so the parser works directly on the page cache, without
+// the seeks and buffer copies of a FileStream.  Substreams and copies
+// are ordinary MemStreams pointing into the mapping, so they must not
+// outlive this stream (which the PDFDoc owns, and deletes last).
+//
+// If the file is truncated while it's mapped (e.g., by a program that
+// rewrites it in place), reading past the new end would normally raise
+// SIGBUS.  Instead, the affected pages are replaced with zero-filled
+// memory: the parser sees garbage, and the file gets reloaded.
+class MappedFileStream: public MemStream {
+public:
+
+  // Map <fileNameA>.  Returns NULL if it isn't a regular file, or
+  // can't be mapped for any other reason; the caller should then fall
+  // back to a FileStream.
+  static MappedFileStream *open(GooString *fileNameA);
+
+  virtual ~MappedFileStream();
+
+  // PDFDoc takes the document's file name from here.
+  virtual GooString *getFileName() { return fileName; }
+
+  // Make all further reads (through this stream) hit EOF, so a PDFDoc
+  // that is being opened on another thread gives up quickly.
+  void abort() { __atomic_store_n(&aborted, true, __ATOMIC_RELAXED); }
+
+  // Current read position, as a fraction of the file size.  This can
+  // be called from another thread, as a rough progress indicator.
+  double getProgress();
+
+  virtual int getChar();
+  virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+
+private:
+
+  MappedFileStream(char *mapA, size_t mapLenA, GooString *fileNameA,
+		   Object *dictA);
+
+  char *map;
+  size_t mapLen;
+  GooString *fileName;
+  bool aborted;
+};
+
+#endif
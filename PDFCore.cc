@@ -15,8 +15,15 @@
 #endif
 
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "poppler/goo/GooString.h"
 #include "poppler/goo/GooList.h"
+#include "poppler/goo/gfile.h"
 #include "GlobalParamsGUI.h"
 #include "poppler/splash/Splash.h"
 #include "poppler/splash/SplashBitmap.h"
@@ -27,9 +34,267 @@
 #include "poppler/PDFDoc.h"
 #include "poppler/Link.h"
 #include "poppler/TextOutputDev.h"
+#include "poppler/SplashOutputDev.h"
 #include "CoreOutputDev.h"
+#include "DisplayListOutputDev.h"
+#include "ImagePageOutputDev.h"
+#include "TileDiskCache.h"
+#include "DocInfoCache.h"
+#include "PageFingerprints.h"
+#include "BufferPool.h"
+#include "WorkerPool.h"
+#include "ProgressiveFile.h"
+#include "DocLoader.h"
 #include "PDFCore.h"
 
+//------------------------------------------------------------------------
+
+// Return the current time, in milliseconds.
+static double getTimeMs() {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// Nearest-neighbor resample <src> into <dest>.  Both bitmaps are
+// pieces of the same page: <dest> has its upper-left corner at
+// (<destX>, <destY>) in its own device space, <src> has its upper-left
+// corner at (<srcX>, <srcY>) in a device space that is <scale> times
+// the resolution of the <dest> one.  Only the <dest> pixels covered by
+// <src> are touched.  <dest> must be splashModeRGB8; <src> can also
+// be a gray or monochrome tile bitmap.
+static void resampleBitmap(SplashBitmap *dest, int destX, int destY,
+			   SplashBitmap *src, int srcX, int srcY,
+			   double scale) {
+  SplashColorPtr p, q;
+  int *xMap;
+  int w, h, x0, x1, x, y, sx, sy, srcComps;
+
+  w = dest->getWidth();
+  h = dest->getHeight();
+  srcComps = src->getMode() == splashModeRGB8 ? 3 : 1;
+  xMap = (int *)gmallocn(w, sizeof(int));
+  x0 = w;
+  x1 = -1;
+  for (x = 0; x < w; ++x) {
+    sx = (int)((destX + x + 0.5) * scale) - srcX;
+    if (sx >= 0 && sx < src->getWidth()) {
+      xMap[x] = sx * srcComps;
+      if (x < x0) {
+	x0 = x;
+      }
+      x1 = x;
+    }
+  }
+  for (y = 0; y < h && x0 <= x1; ++y) {
+    sy = (int)((destY + y + 0.5) * scale) - srcY;
+    if (sy < 0 || sy >= src->getHeight()) {
+      continue;
+    }
+    p = src->getDataPtr() + sy * src->getRowSize();
+    q = dest->getDataPtr() + y * dest->getRowSize() + x0 * 3;
+    switch (src->getMode()) {
+    case splashModeMono1:
+      for (x = x0; x <= x1; ++x) {
+	q[0] = q[1] = q[2] = (p[xMap[x] >> 3] & (0x80 >> (xMap[x] & 7)))
+	                       ? 0xff : 0x00;
+	q += 3;
+      }
+      break;
+    case splashModeMono8:
+      for (x = x0; x <= x1; ++x) {
+	q[0] = q[1] = q[2] = p[xMap[x]];
+	q += 3;
+      }
+      break;
+    default:
+      for (x = x0; x <= x1; ++x) {
+	q[0] = p[xMap[x]];
+	q[1] = p[xMap[x] + 1];
+	q[2] = p[xMap[x] + 2];
+	q += 3;
+      }
+      break;
+    }
+  }
+  gfree(xMap);
+}
+
+// Get the number of pixels per row of a <width>-pixel-wide bitmap in
+// color mode <mode>, and the number of bytes per pixel, as seen by
+// packPixels/unpackPixels.  Monochrome rows are handled as bytes,
+// eight pixels at a time.
+static void getPackUnits(SplashColorMode mode, int width,
+			 int *w, int *nComps) {
+  if (mode == splashModeMono1) {
+    *w = (width + 7) >> 3;
+    *nComps = 1;
+  } else {
+    *w = width;
+    *nComps = splashColorModeNComps[mode];
+  }
+}
+
+// Maximum amount of unused memory kept in the buffer pool.
+#define bufferPoolMaxFree (32 * 1024 * 1024)
+
+// Maximum number of threads (including the main one) used to split up
+// per-tile work.
+#define maxWorkerThreads 8
+
+//------------------------------------------------------------------------
+
+// Compress the pixels of <bitmap>, row by row, with a PackBits-style
+// run-length code that works on whole pixels: a control byte c < 128
+// is followed by c+1 literal pixels, and a control byte c >= 128 is
+// followed by a single pixel, repeated c-126 times.  Returns the
+// compressed data, and sets *<len>.  The worst-case size scratch
+// buffer comes from <pool>, if it isn't NULL.
+static Guchar *packPixels(SplashBitmap *bitmap, BufferPool *pool, int *len) {
+  Guchar *buf, *q, *data;
+  SplashColorPtr p;
+  int w, h, nComps, x, y, n;
+
+  getPackUnits(bitmap->getMode(), bitmap->getWidth(), &w, &nComps);
+  h = bitmap->getHeight();
+  n = h * (w * nComps + (w + 127) / 128);
+  buf = (Guchar *)(pool ? pool->alloc(n) : gmalloc(n));
+  q = buf;
+  for (y = 0; y < h; ++y) {
+    p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    x = 0;
+    while (x < w) {
+      for (n = 1;
+	   n < 129 && x + n < w && !memcmp(p + n * nComps, p, nComps);
+	   ++n) ;
+      if (n >= 2) {
+	*q++ = (Guchar)(n + 126);
+	memcpy(q, p, nComps);
+	q += nComps;
+      } else {
+	// stop the literal run where a repeat starts
+	for (n = 1; n < 128 && x + n < w; ++n) {
+	  if (x + n + 1 < w &&
+	      !memcmp(p + n * nComps, p + (n + 1) * nComps, nComps)) {
+	    break;
+	  }
+	}
+	*q++ = (Guchar)(n - 1);
+	memcpy(q, p, n * nComps);
+	q += n * nComps;
+      }
+      p += n * nComps;
+      x += n;
+    }
+  }
+  *len = (int)(q - buf);
+  data = (Guchar *)gmalloc(*len);
+  memcpy(data, buf, *len);
+  if (pool) {
+    pool->release(buf);
+  } else {
+    gfree(buf);
+  }
+  return data;
+}
+
+// Pack a tile for the disk cache.  This runs on the disk cache's
+// writer thread, so it can't use the (unlocked) buffer pool.
+static Guchar *packDiskTile(SplashBitmap *bitmap, int *len) {
+  return packPixels(bitmap, NULL, len);
+}
+
+// Decompress the <len> bytes at <data> (from packPixels), which hold a
+// <width> x <height> bitmap in color mode <mode>, into <bitmap>, which
+// must be that size and mode.  If <bitmap> is NULL, the data is only
+// checked.  Returns false if the data is malformed, i.e., if a run
+// would overrun the input or a row, or if the input doesn't end
+// exactly at the end of the last row.
+static bool unpackPixels(Guchar *data, int len, SplashColorMode mode,
+			 int width, int height, SplashBitmap *bitmap) {
+  Guchar *p, *end;
+  SplashColorPtr q;
+  int w, nComps, x, y, n, i;
+
+  getPackUnits(mode, width, &w, &nComps);
+  p = data;
+  end = data + len;
+  q = NULL;
+  for (y = 0; y < height; ++y) {
+    if (bitmap) {
+      q = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    }
+    x = 0;
+    while (x < w) {
+      if (p >= end) {
+	return false;
+      }
+      if (*p < 128) {
+	n = *p++ + 1;
+	if (n > w - x || n * nComps > end - p) {
+	  return false;
+	}
+	if (q) {
+	  memcpy(q, p, n * nComps);
+	  q += n * nComps;
+	}
+	p += n * nComps;
+      } else {
+	n = *p++ - 126;
+	if (n > w - x || nComps > end - p) {
+	  return false;
+	}
+	if (q) {
+	  for (i = 0; i < n; ++i) {
+	    memcpy(q, p, nComps);
+	    q += nComps;
+	  }
+	}
+	p += nComps;
+      }
+      x += n;
+    }
+  }
+  return p == end;
+}
+
+// Like resampleBitmap, but the source is a <srcW> x <srcH> rectangle
+// of a single color.
+static void fillScaledRect(SplashBitmap *dest, int destX, int destY,
+			   SplashColorPtr color, int srcX, int srcY,
+			   int srcW, int srcH, double scale) {
+  SplashColorPtr q;
+  int w, h, x0, x1, x, y, sx, sy;
+
+  w = dest->getWidth();
+  h = dest->getHeight();
+  x0 = w;
+  x1 = -1;
+  for (x = 0; x < w; ++x) {
+    sx = (int)((destX + x + 0.5) * scale) - srcX;
+    if (sx >= 0 && sx < srcW) {
+      if (x < x0) {
+	x0 = x;
+      }
+      x1 = x;
+    }
+  }
+  for (y = 0; y < h && x0 <= x1; ++y) {
+    sy = (int)((destY + y + 0.5) * scale) - srcY;
+    if (sy < 0 || sy >= srcH) {
+      continue;
+    }
+    q = dest->getDataPtr() + y * dest->getRowSize() + x0 * 3;
+    for (x = x0; x <= x1; ++x) {
+      q[0] = color[0];
+      q[1] = color[1];
+      q[2] = color[2];
+      q += 3;
+    }
+  }
+}
+
 //------------------------------------------------------------------------
 // PDFCorePage
 //------------------------------------------------------------------------
@@ -55,11 +320,42 @@ PDFCorePage::~PDFCorePage()
 
 PDFCoreTile::PDFCoreTile(int xDestA, int yDestA):
 	xMin(0), yMin(0), xMax(0), yMax(0), xDest(xDestA), yDest(yDestA),
-        bitmap(NULL)
+        bitmap(NULL), preview(false), draft(false), solid(false),
+	packedData(NULL), packedLen(0), packedMode(splashModeRGB8)
 {}
 
 PDFCoreTile::~PDFCoreTile() {
   delete bitmap;
+  gfree(packedData);
+}
+
+//------------------------------------------------------------------------
+// PDFCorePreview
+//------------------------------------------------------------------------
+
+PDFCorePreview::PDFCorePreview(int pageA, int rotateA, double dpiA,
+			       int xMinA, int yMinA, SplashBitmap *bitmapA):
+	page(pageA), rotate(rotateA), dpi(dpiA), xMin(xMinA), yMin(yMinA),
+	bitmap(bitmapA)
+{}
+
+PDFCorePreview::~PDFCorePreview() {
+  delete bitmap;
+}
+
+//------------------------------------------------------------------------
+// PDFCoreCachedTile
+//------------------------------------------------------------------------
+
+PDFCoreCachedTile::PDFCoreCachedTile(int pageA, double dpiA, int rotateA,
+				     PDFCoreTile *tileA):
+	page(pageA), dpi(dpiA), rotate(rotateA), tile(tileA)
+{
+  size = sizeof(PDFCoreCachedTile) + sizeof(PDFCoreTile) + tile->packedLen;
+}
+
+PDFCoreCachedTile::~PDFCoreCachedTile() {
+  delete tile;
 }
 
 
@@ -70,9 +366,17 @@ PDFCoreTile::~PDFCoreTile() {
 PDFCore::PDFCore(SplashColorMode colorModeA, int bitmapRowPadA,
 		 bool reverseVideoA, SplashColorPtr paperColorA,
 		 bool incrementalUpdate) {
-  int i;
+  GooString *dir;
+  int nThreads, i;
 
   doc = NULL;
+  pageGeom = NULL;
+  progFile = NULL;
+  docLoader = NULL;
+  loadPage = 0;
+  loadDest = NULL;
+  loadDestName = NULL;
+  loadAddToHist = false;
   continuousMode = globalParamsGUI->getContinuousView();
   drawAreaWidth = drawAreaHeight = 0;
   maxPageW = totalDocH = 0;
@@ -82,6 +386,7 @@ PDFCore::PDFCore(SplashColorMode colorModeA, int bitmapRowPadA,
   zoom = defZoom;
   dpi = 0;
   rotate = 0;
+  interactive = false;
 
   selectPage = 0;
   selectULX = selectLRX = 0;
@@ -97,34 +402,132 @@ PDFCore::PDFCore(SplashColorMode colorModeA, int bitmapRowPadA,
 
   pages = new GooList();
   curTile = NULL;
+  previews = new GooList();
+  displayLists = new GooList();
+  imagePages = new GooList();
+  tileCache = new GooList();
+  tileCacheBytes = 0;
+  if ((dir = globalParamsGUI->getTileCacheDir())) {
+    diskCache = new TileDiskCache(dir, globalParamsGUI->getTileCacheDiskSize()
+				         * 1024.0 * 1024.0,
+				  &packDiskTile);
+  } else {
+    diskCache = NULL;
+  }
+  if ((dir = globalParamsGUI->getDocInfoCacheDir())) {
+    docInfoCache = new DocInfoCache(dir);
+  } else {
+    docInfoCache = NULL;
+  }
+  docKey = NULL;
+  fingerprints = NULL;
+  bufPool = new BufferPool(bufferPoolMaxFree);
+  nThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (nThreads > maxWorkerThreads) {
+    nThreads = maxWorkerThreads;
+  } else if (nThreads < 1) {
+    nThreads = 1;
+  }
+  workers = new WorkerPool(nThreads - 1);
 
+  colorMode = colorModeA;
+  reverseVideo = reverseVideoA;
   splashColorCopy(paperColor, paperColorA);
-  out = new CoreOutputDev(colorModeA, bitmapRowPadA,
-			  reverseVideoA, paperColorA, incrementalUpdate,
-			  &redrawCbk, this);
-  out->startDoc(NULL);
+  updateDisplayLUT();
+
+  bitmapRowPad = bitmapRowPadA;
+  imageCache = new CoreImageCache();
+  formCache = new CoreFormCache();
+  out = NULL;
+  draftOut = NULL;
+  makeOutputDevs(incrementalUpdate);
+
+  memset(&stats, 0, sizeof(stats));
 }
 
 
 PDFCore::~PDFCore() {
   int i;
 
+  // a loader thread that is still running finishes (and cleans up) on
+  // its own
+  delete docLoader;
+  clearLoadTarget();
   delete doc;
+  gfree(pageGeom);
   for (i = 0; i < pdfHistorySize; ++i) {
     delete history[i].fileName;
   }
   gfree(pageY);
   deleteGooList(pages, PDFCorePage);
+  deleteGooList(previews, PDFCorePreview);
+  deleteGooList(displayLists, DisplayList);
+  deleteGooList(imagePages, ImagePage);
+  deleteGooList(tileCache, PDFCoreCachedTile);
+  delete diskCache;
+  delete docInfoCache;
+  delete docKey;
+  delete fingerprints;
+  delete out;
+  delete draftOut;
+  delete imageCache;
+  delete formCache;
+  delete bufPool;
+  delete workers;
+}
+
+// Change the color mode used for rasterization.  This is meant for a
+// subclass's constructor, once it knows what the display can show --
+// nothing may have been rasterized yet.
+void PDFCore::setColorMode(SplashColorMode colorModeA) {
+  if (colorModeA == colorMode) {
+    return;
+  }
+  colorMode = colorModeA;
+  updateDisplayLUT();
+  makeOutputDevs(out->getIncrementalUpdate());
+}
+
+// (Re)create the output devices for the current color mode.
+void PDFCore::makeOutputDevs(bool incrementalUpdate) {
+  SplashColor white;
+
   delete out;
+  delete draftOut;
+
+  // reverse video and the paper color are applied by displayLUT, so
+  // they don't affect the rasterized tiles
+  white[0] = white[1] = white[2] = 0xff;
+  out = new CoreOutputDev(colorMode, bitmapRowPad,
+			  false, white, true, incrementalUpdate,
+			  &redrawCbk, this);
+  out->setImageCache(imageCache);
+  out->setFormCache(formCache);
+  out->startDoc(doc);
+  draftOut = new CoreOutputDev(colorMode, bitmapRowPad,
+			       false, white, false, false,
+			       NULL, NULL);
+  draftOut->setImageCache(imageCache);
+  draftOut->setFormCache(formCache);
+  draftOut->startDoc(doc);
 }
 
 int PDFCore::loadFile(GooString *fileName, GooString *ownerPassword,
 		      GooString *userPassword) {
+  DocLoader *loader;
+  ProgressiveFile *prog;
+  PDFDoc *newDoc;
   int err;
 
+  cancelLoadFile();
   setBusyCursor(true);
-  err = loadFile2(new PDFDoc(fileName->copy(), ownerPassword, userPassword,
-			     this));
+  loader = new DocLoader(fileName, ownerPassword, userPassword, this);
+  loader->wait();
+  newDoc = loader->takeDoc(&prog, &err);
+  delete loader;
+  if (newDoc) {
+    err = loadFile2(newDoc, prog);
+  }
   setBusyCursor(false);
   return err;
 }
@@ -133,6 +536,7 @@ int PDFCore::loadFile(BaseStream *stream, GooString *ownerPassword,
 		      GooString *userPassword) {
   int err;
 
+  cancelLoadFile();
   setBusyCursor(true);
   err = loadFile2(new PDFDoc(stream, ownerPassword, userPassword, this));
   setBusyCursor(false);
@@ -140,15 +544,104 @@ int PDFCore::loadFile(BaseStream *stream, GooString *ownerPassword,
 }
 
 void PDFCore::loadDoc(PDFDoc *docA) {
+  cancelLoadFile();
   setBusyCursor(true);
   loadFile2(docA);
   setBusyCursor(false);
 }
 
-int PDFCore::loadFile2(PDFDoc *newDoc) {
+void PDFCore::loadFileAsync(GooString *fileName, int pg, LinkDest *dest,
+			    GooString *destName, bool addToHist) {
+  cancelLoadFile();
+  loadPage = pg;
+  loadDest = dest;
+  loadDestName = destName;
+  loadAddToHist = addToHist;
+  setBusyCursor(true);
+  docLoader = new DocLoader(fileName, NULL, NULL, this);
+  docLoaderStarted();
+}
+
+void PDFCore::cancelLoadFile() {
+  if (!docLoader) {
+    return;
+  }
+  // the loader thread finishes (and cleans up) on its own
+  delete docLoader;
+  docLoader = NULL;
+  clearLoadTarget();
+  setBusyCursor(false);
+  loadFileDone(pdfCoreErrCancelled);
+}
+
+// Called once loadFileAsync has started the loader thread.  The GUI
+// subclass returns to its event loop, and calls finishLoadFile when
+// the thread is done; this version just waits for it.
+void PDFCore::docLoaderStarted() {
+  docLoader->wait();
+  finishLoadFile();
+}
+
+// Take the new document from the (finished) loader thread, and display
+// it at the position passed to loadFileAsync.
+void PDFCore::finishLoadFile() {
+  ProgressiveFile *prog;
+  PDFDoc *newDoc;
+  LinkDest *dest;
+  GooString *destName;
+  bool addToHist;
+  int pg, err;
+
+  newDoc = docLoader->takeDoc(&prog, &err);
+  delete docLoader;
+  docLoader = NULL;
+  pg = loadPage;
+  dest = loadDest;
+  destName = loadDestName;
+  addToHist = loadAddToHist;
+  loadDest = NULL;
+  loadDestName = NULL;
+  if (newDoc) {
+    err = loadFile2(newDoc, prog);
+  }
+  setBusyCursor(false);
+  loadFileDone(err);
+  if (err == errNone) {
+    if (!dest && destName) {
+      dest = doc->findDest(destName);
+    }
+    if (dest) {
+      displayDest(dest, zoom, rotate, addToHist);
+    } else {
+      if (pg > doc->getNumPages()) {
+	pg = doc->getNumPages();
+      }
+      if (pg < 1) {
+	pg = 1;
+      }
+      displayPage(pg, zoom, rotate, addToHist, addToHist);
+    }
+  }
+  delete dest;
+  delete destName;
+}
+
+void PDFCore::clearLoadTarget() {
+  delete loadDest;
+  loadDest = NULL;
+  delete loadDestName;
+  loadDestName = NULL;
+}
+
+int PDFCore::loadFile2(PDFDoc *newDoc, ProgressiveFile *progFileA) {
+  PageFingerprints *oldFingerprints;
+  GooString *path;
+  struct stat st;
+  char buf[64];
+  bool reload;
+  int oldNPages;
   int err;
-  double w, h, t;
-  int i;
+  int first, i;
 
   // open the PDF file
   if (!newDoc->isOk()) {
@@ -157,25 +650,267 @@ int PDFCore::loadFile2(PDFDoc *newDoc) {
     return err;
   }
 
+  // when a file is reloaded, the old pages' tiles, previews, and
+  // single-image pages are kept until they can be matched up with the
+  // new pages
+  reload = doc && fingerprints && !progFileA &&
+           newDoc->getFileName() &&
+           !newDoc->getFileName()->cmp(doc->getFileName());
+  oldFingerprints = fingerprints;
+  fingerprints = NULL;
+  oldNPages = doc ? doc->getNumPages() : 0;
+
   // replace old document
   delete doc;
   doc = newDoc;
+  // (a truncated file is kept, so updateProgressiveLoad reopens it)
+  progFile = NULL;
+  if (progFileA && (!progFileA->isDone() || progFileA->isTruncated())) {
+    progFile = progFileA;
+  }
   if (out) {
-    out->startDoc(doc->getXRef());
+    out->startDoc(doc);
   }
+  draftOut->startDoc(doc);
 
   // nothing displayed yet
   topPage = -99;
   while (pages->getLength() > 0) {
-    delete (PDFCorePage *)pages->del(0);
+    if (reload) {
+      discardPage((PDFCorePage *)pages->del(0), dpi, rotate);
+    } else {
+      delete (PDFCorePage *)pages->del(0);
+    }
+  }
+  if (!reload) {
+    clearPreviews();
+    clearImagePages();
+    clearTileCache();
+  }
+  clearDisplayLists();
+  imageCache->clear();
+  formCache->clear();
+
+  // identify the file, for the on-disk tile cache
+  delete docKey;
+  docKey = NULL;
+  path = NULL;
+  if (doc->getFileName() && !progFile &&
+      stat(doc->getFileName()->getCString(), &st) == 0) {
+    path = makePathAbsolute(doc->getFileName()->copy());
+    docKey = path->copy();
+    sprintf(buf, ":%ld:%ld", (long)st.st_size, (long)st.st_mtime);
+    docKey->append(buf);
+  }
+
+  // read the page geometry -- pages that haven't arrived yet get the
+  // first page's geometry
+  gfree(pageGeom);
+  pageGeom = (PDFCorePageGeom *)gmallocn(doc->getNumPages(),
+					 sizeof(PDFCorePageGeom));
+  if (!progFile) {
+    readAllPageGeom(path);
+  } else {
+    for (i = 1; i <= doc->getNumPages(); ++i) {
+      if (progFile->isPageAvailable(i)) {
+	readPageGeom(i);
+      } else {
+	pageGeom[i-1].placeholder = true;
+      }
+    }
+    first = progFile->getFirstPage();
+    if (first < 1 || first > doc->getNumPages() ||
+	pageGeom[first-1].placeholder) {
+      first = 1;
+      readPageGeom(first);
+    }
+    for (i = 1; i <= doc->getNumPages(); ++i) {
+      if (pageGeom[i-1].placeholder) {
+	pageGeom[i-1] = pageGeom[first-1];
+	pageGeom[i-1].placeholder = true;
+      }
+    }
+  }
+  setMaxPageSize();
+  delete path;
+
+  if (doc->getFileName() && !progFile && wantPageFingerprints()) {
+    fingerprints = new PageFingerprints(doc);
+  }
+  if (reload) {
+    remapReloadedPages(oldFingerprints, oldNPages);
+  }
+  delete oldFingerprints;
+
+  return errNone;
+}
+
+// After a reload, move the cached tiles, previews, and single-image
+// pages of the old version of the document to the matching pages of
+// the new version, and drop the ones of pages that have changed.
+void PDFCore::remapReloadedPages(PageFingerprints *oldFingerprints,
+				 int oldNPages) {
+  PDFCoreCachedTile *entry;
+  PDFCorePreview *preview;
+  ImagePage *imgPage;
+  int *pageMap;
+  char *taken;
+  int pg, i;
+
+  if (fingerprints) {
+    fingerprints->inheritFrom(oldFingerprints);
+  }
+  pageMap = (int *)gmallocn(oldNPages, sizeof(int));
+  for (i = 0; i < oldNPages; ++i) {
+    pageMap[i] = -1;
+  }
+  taken = (char *)gmalloc(doc->getNumPages());
+  memset(taken, 0, doc->getNumPages());
+
+  for (i = 0; i < tileCache->getLength(); ++i) {
+    entry = (PDFCoreCachedTile *)tileCache->get(i);
+    if ((pg = findReloadedPage(entry->page, oldFingerprints, oldNPages,
+			       pageMap, taken))) {
+      entry->page = pg;
+    } else {
+      tileCache->del(i--);
+      tileCacheBytes -= entry->size;
+      delete entry;
+    }
+  }
+  for (i = 0; i < previews->getLength(); ++i) {
+    preview = (PDFCorePreview *)previews->get(i);
+    if ((pg = findReloadedPage(preview->page, oldFingerprints, oldNPages,
+			       pageMap, taken))) {
+      preview->page = pg;
+    } else {
+      delete (PDFCorePreview *)previews->del(i--);
+    }
+  }
+  for (i = 0; i < imagePages->getLength(); ++i) {
+    imgPage = (ImagePage *)imagePages->get(i);
+    if ((pg = findReloadedPage(imgPage->getPage(), oldFingerprints,
+			       oldNPages, pageMap, taken))) {
+      imgPage->setPage(pg);
+    } else {
+      delete (ImagePage *)imagePages->del(i--);
+    }
+  }
+
+  gfree(pageMap);
+  gfree(taken);
+}
+
+// Return the page of the new version of the document that is the same
+// as page <oldPg> of the old version, or 0 if there isn't one.  Pages
+// usually stay put, or move by a few places when pages are inserted or
+// deleted before them, so only nearby pages are compared.  <pageMap>
+// remembers the results, and <taken> marks the new pages that have
+// already been matched up.
+int PDFCore::findReloadedPage(int oldPg, PageFingerprints *oldFingerprints,
+			      int oldNPages, int *pageMap, char *taken) {
+  unsigned long long oldFP, fp;
+  int pg, d;
+
+  if (oldPg < 1 || oldPg > oldNPages) {
+    return 0;
+  }
+  if (pageMap[oldPg-1] >= 0) {
+    return pageMap[oldPg-1];
+  }
+  pageMap[oldPg-1] = 0;
+  // only the pages that were displayed (and fingerprinted before the
+  // file changed) have fingerprints -- the others can't be matched up
+  if (!fingerprints || !oldFingerprints->isComputed(oldPg) ||
+      !oldFingerprints->getFingerprint(oldPg, &oldFP)) {
+    return 0;
+  }
+  for (d = 0; d <= pdfCoreReloadSearchPages; ++d) {
+    pg = oldPg + d;
+    if (pg <= doc->getNumPages() && !taken[pg-1] &&
+	fingerprints->getFingerprint(pg, &fp) && fp == oldFP) {
+      break;
+    }
+    pg = oldPg - d;
+    if (d > 0 && pg >= 1 && pg <= doc->getNumPages() && !taken[pg-1] &&
+	fingerprints->getFingerprint(pg, &fp) && fp == oldFP) {
+      break;
+    }
+  }
+  if (d > pdfCoreReloadSearchPages) {
+    return 0;
+  }
+  taken[pg-1] = 1;
+  pageMap[oldPg-1] = pg;
+  return pg;
+}
+
+bool PDFCore::fingerprintNextPage() {
+  return fingerprints && fingerprints->computeNext();
+}
+
+bool PDFCore::hasPendingFingerprints() {
+  return fingerprints && fingerprints->hasRequests();
+}
+
+void PDFCore::dropPendingFingerprints() {
+  if (fingerprints) {
+    fingerprints->dropRequests();
+  }
+}
+
+void PDFCore::readPageGeom(int pg) {
+  PDFCorePageGeom *geom;
+
+  geom = &pageGeom[pg-1];
+  geom->cropW = doc->getPageCropWidth(pg);
+  geom->cropH = doc->getPageCropHeight(pg);
+  geom->rotate = doc->getPageRotate(pg);
+  geom->placeholder = false;
+}
+
+// Read the geometry of all of the pages.  For a large document, this
+// means loading every Page object, so the result is kept in the
+// on-disk cache, keyed by the file's <path>, size, modification time,
+// and ID.
+void PDFCore::readAllPageGeom(GooString *path) {
+  GooString *key, *permanentID, *updateID;
+  int pg;
+
+  key = NULL;
+  if (docInfoCache && path && doc->getNumPages() >= pdfCoreDocInfoMinPages) {
+    key = docKey->copy();
+    permanentID = new GooString();
+    updateID = new GooString();
+    if (doc->getID(permanentID, updateID)) {
+      key->append(':')->append(permanentID)->append(':')->append(updateID);
+    }
+    delete permanentID;
+    delete updateID;
+    if (docInfoCache->loadPageGeom(path, key, doc->getNumPages(), pageGeom)) {
+      delete key;
+      return;
+    }
+  }
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    readPageGeom(pg);
   }
+  if (key) {
+    docInfoCache->storePageGeom(path, key, doc->getNumPages(), pageGeom);
+    delete key;
+  }
+}
+
+// Compute the max unscaled page size.
+void PDFCore::setMaxPageSize() {
+  double w, h, t;
+  int i;
 
-  // compute the max unscaled page size
   maxUnscaledPageW = maxUnscaledPageH = 0;
   for (i = 1; i <= doc->getNumPages(); ++i) {
-    w = doc->getPageCropWidth(i);
-    h = doc->getPageCropHeight(i);
-    if (doc->getPageRotate(i) == 90 || doc->getPageRotate(i) == 270) {
+    w = getPageCropWidth(i);
+    h = getPageCropHeight(i);
+    if (getPageRotate(i) == 90 || getPageRotate(i) == 270) {
       t = w; w = h; h = t;
     }
     if (w > maxUnscaledPageW) {
@@ -185,8 +920,65 @@ int PDFCore::loadFile2(PDFDoc *newDoc) {
       maxUnscaledPageH = h;
     }
   }
+}
 
-  return errNone;
+// Read the geometry of any placeholder pages that have arrived.
+// Returns true if there were any; sets <relayout> if their geometry
+// differs from the placeholder geometry.
+bool PDFCore::updatePageGeom(bool *relayout) {
+  PDFCorePageGeom old;
+  bool changed;
+  int pg;
+
+  changed = *relayout = false;
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    if (!pageGeom[pg-1].placeholder) {
+      continue;
+    }
+    // all of the other pages become available together, so stop at
+    // the first one that isn't there yet
+    if (!progFile->isPageAvailable(pg)) {
+      break;
+    }
+    old = pageGeom[pg-1];
+    readPageGeom(pg);
+    if (pageGeom[pg-1].cropW != old.cropW ||
+	pageGeom[pg-1].cropH != old.cropH ||
+	pageGeom[pg-1].rotate != old.rotate) {
+      *relayout = true;
+    }
+    changed = true;
+  }
+  if (*relayout) {
+    setMaxPageSize();
+  }
+  return changed;
+}
+
+bool PDFCore::updateProgressiveLoad() {
+  bool relayout, truncated;
+
+  if (!progFile) {
+    return false;
+  }
+  if (progFile->poll() || progFile->isDone()) {
+    if (updatePageGeom(&relayout)) {
+      update(topPage, scrollX,
+	     (relayout && continuousMode) ? -1 : scrollY, zoom, rotate,
+	     relayout, false);
+    }
+  }
+  if (progFile->isDone()) {
+    // a file whose data stopped short is reopened normally, which
+    // reconstructs its xref table, so the remaining pages can be found
+    truncated = progFile->isTruncated();
+    progFile = NULL;
+    if (truncated) {
+      loadFileAsync(doc->getFileName(), topPage, NULL, NULL, false);
+    }
+    return false;
+  }
+  return true;
 }
 
 void PDFCore::clear() {
@@ -197,13 +989,27 @@ void PDFCore::clear() {
   // no document
   delete doc;
   doc = NULL;
+  gfree(pageGeom);
+  pageGeom = NULL;
+  progFile = NULL;
+  delete docKey;
+  docKey = NULL;
+  delete fingerprints;
+  fingerprints = NULL;
   out->clear();
+  draftOut->startDoc(NULL);
 
   // no page displayed
   topPage = -99;
   while (pages->getLength() > 0) {
     delete (PDFCorePage *)pages->del(0);
   }
+  clearPreviews();
+  clearDisplayLists();
+  clearImagePages();
+  clearTileCache();
+  imageCache->clear();
+  formCache->clear();
 
   // redraw
   scrollX = scrollY = 0;
@@ -221,13 +1027,27 @@ PDFDoc *PDFCore::takeDoc(bool redraw) {
   // no document
   docA = doc;
   doc = NULL;
+  gfree(pageGeom);
+  pageGeom = NULL;
+  progFile = NULL;
+  delete docKey;
+  docKey = NULL;
+  delete fingerprints;
+  fingerprints = NULL;
   out->clear();
+  draftOut->startDoc(NULL);
 
   // no page displayed
   topPage = -99;
   while (pages->getLength() > 0) {
     delete (PDFCorePage *)pages->del(0);
   }
+  clearPreviews();
+  clearDisplayLists();
+  clearImagePages();
+  clearTileCache();
+  imageCache->clear();
+  formCache->clear();
 
   // redraw
   scrollX = scrollY = 0;
@@ -346,8 +1166,11 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
   PDFCorePage *page;
   PDFHistory *hist;
   SplashColor xorColor;
-  bool needUpdate;
-  int i, j;
+  GooList *oldPages, *rotPages;
+  double oldDPI, t0;
+  int oldRotate;
+  bool needUpdate, havePreview, needPaint, painted, visible, empty;
+  int pass, i, j;
 
   // check for document and valid page number
   if (!doc) {
@@ -360,12 +1183,18 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     return;
   }
 
+  t0 = getTimeMs();
   needUpdate = false;
+  oldPages = rotPages = NULL;
+  oldDPI = 0;
+  oldRotate = 0;
 
-  // check for changes to the PDF file
+  // check for changes to the PDF file (unless it's still arriving)
   if ((force || (!continuousMode && topPage != topPageA)) &&
-      checkForNewFile()) {
-    if (loadFile(doc->getFileName()) == errNone) {
+      !progFile && !docLoader && checkForNewFile()) {
+    // the old version stays up until the new one has been opened
+    loadFileAsync(doc->getFileName(), topPageA, NULL, NULL, false);
+    if (!docLoader) {
       if (topPageA > doc->getNumPages()) {
 	topPageA = doc->getNumPages();
       }
@@ -379,9 +1208,9 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     uh = maxUnscaledPageH;
     rot = rotateA;
   } else {
-    uw = doc->getPageCropWidth(topPageA);
-    uh = doc->getPageCropHeight(topPageA);
-    rot = rotateA + doc->getPageRotate(topPageA);
+    uw = getPageCropWidth(topPageA);
+    uh = getPageCropHeight(topPageA);
+    rot = rotateA + getPageRotate(topPageA);
     if (rot >= 360) {
       rot -= 360;
     } else if (rot < 0) {
@@ -416,8 +1245,25 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
       zoomA != zoom || fabs( dpiA - dpi ) > EPSILON || rotateA != rotate) {
     needUpdate = true;
     setSelection(0, 0, 0, 0, 0);
-    while (pages->getLength() > 0) {
-      delete (PDFCorePage *)pages->del(0);
+    // if only the resolution is changing, hang on to the old pages --
+    // their tiles are scaled up/down and displayed while the new
+    // tiles are being rasterized
+    if (pages->getLength() > 0 && rotateA == rotate &&
+	fabs(dpiA - dpi) > EPSILON && colorMode == splashModeRGB8) {
+      oldPages = pages;
+      oldDPI = dpi;
+      pages = new GooList();
+    // if only the rotation is changing, hang on to the old pages --
+    // their tiles are rotated to make the new tiles
+    } else if (pages->getLength() > 0 && rotateA != rotate &&
+	       fabs(dpiA - dpi) <= EPSILON && colorMode == splashModeRGB8) {
+      rotPages = pages;
+      oldRotate = rotate;
+      pages = new GooList();
+    } else {
+      while (pages->getLength() > 0) {
+	discardPage((PDFCorePage *)pages->del(0), dpi, rotate);
+      }
     }
     zoom = zoomA;
     rotate = rotateA;
@@ -427,9 +1273,9 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
       pageY = (int *)greallocn(pageY, doc->getNumPages(), sizeof(int));
       for (i = 1; i <= doc->getNumPages(); ++i) {
 	pageY[i-1] = totalDocH;
-	w = (int)((doc->getPageCropWidth(i) * dpi) / 72 + 0.5);
-	h = (int)((doc->getPageCropHeight(i) * dpi) / 72 + 0.5);
-	rot = rotate + doc->getPageRotate(i);
+	w = (int)((getPageCropWidth(i) * dpi) / 72 + 0.5);
+	h = (int)((getPageCropHeight(i) * dpi) / 72 + 0.5);
+	rot = rotate + getPageRotate(i);
 	if (rot >= 360) {
 	  rot -= 360;
 	} else if (rot < 0) {
@@ -447,7 +1293,7 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
 	}
       }
     } else {
-      rot = rotate + doc->getPageRotate(topPageA);
+      rot = rotate + getPageRotate(topPageA);
       if (rot >= 360) {
 	rot -= 360;
       } else if (rot < 0) {
@@ -518,16 +1364,16 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     // objects that are needed
     while (pages->getLength() > 0 &&
 	   ((PDFCorePage *)pages->get(0))->page < pg0) {
-      delete (PDFCorePage *)pages->del(0);
+      discardPage((PDFCorePage *)pages->del(0), dpi, rotate);
     }
     i = pages->getLength() - 1;
     while (i > 0 && ((PDFCorePage *)pages->get(i))->page > pg1) {
-      delete (PDFCorePage *)pages->del(i--);
+      discardPage((PDFCorePage *)pages->del(i--), dpi, rotate);
     }
     j = pages->getLength() > 0 ? ((PDFCorePage *)pages->get(0))->page - 1
                                : pg1;
     for (i = pg0; i <= j; ++i) {
-      rot = rotate + doc->getPageRotate(i);
+      rot = rotate + getPageRotate(i);
       if (rot >= 360) {
 	rot -= 360;
       } else if (rot < 0) {
@@ -537,7 +1383,7 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     }
     j = ((PDFCorePage *)pages->get(pages->getLength() - 1))->page;
     for (i = j + 1; i <= pg1; ++i) {
-      rot = rotate + doc->getPageRotate(i);
+      rot = rotate + getPageRotate(i);
       if (rot >= 360) {
 	rot -= 360;
       } else if (rot < 0) {
@@ -567,7 +1413,8 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
 	  tile->xMin > scrollX + drawAreaWidth + drawAreaWidth / 2 ||
 	  y1 < scrollY - drawAreaHeight / 2 ||
 	  y0 > scrollY + drawAreaHeight + drawAreaHeight / 2) {
-	delete (PDFCoreTile *)page->tiles->del(j);
+	discardTile(page->page, dpi, rotate,
+		    (PDFCoreTile *)page->tiles->del(j));
       } else {
 	++j;
       }
@@ -600,36 +1447,6 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     }
   }
 
-  // rasterize any new tiles
-  for (i = 0; i < pages->getLength(); ++i) {
-    page = (PDFCorePage *)pages->get(i);
-    x0 = page->xDest;
-    x1 = x0 + page->w - 1;
-    if (x0 < -drawAreaWidth / 2) {
-      x0 = -drawAreaWidth / 2;
-    }
-    if (x1 > drawAreaWidth + drawAreaWidth / 2) {
-      x1 = drawAreaWidth + drawAreaWidth / 2;
-    }
-    x0 = ((x0 - page->xDest) / page->tileW) * page->tileW;
-    x1 = ((x1 - page->xDest) / page->tileW) * page->tileW;
-    y0 = page->yDest;
-    y1 = y0 + page->h - 1;
-    if (y0 < -drawAreaHeight / 2) {
-      y0 = -drawAreaHeight / 2;
-    }
-    if (y1 > drawAreaHeight + drawAreaHeight / 2) {
-      y1 = drawAreaHeight + drawAreaHeight / 2;
-    }
-    y0 = ((y0 - page->yDest) / page->tileH) * page->tileH;
-    y1 = ((y1 - page->yDest) / page->tileH) * page->tileH;
-    for (y = y0; y <= y1; y += page->tileH) {
-      for (x = x0; x <= x1; x += page->tileW) {
-	needTile(page, x, y);
-      }
-    }
-  }
-
   // update tile positions
   for (i = 0; i < pages->getLength(); ++i) {
     page = (PDFCorePage *)pages->get(i);
@@ -659,167 +1476,1402 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     }
   }
 
-  // redraw the selection
-  if (selectULX != selectLRX && selectULY != selectLRY) {
-    xorColor[0] = xorColor[1] = xorColor[2] = 0xff;
-    xorRectangle(selectPage, selectULX, selectULY, selectLRX, selectLRY,
-		 new SplashSolidColor(xorColor));
+  packHiddenTiles();
+
+  // rasterize any new tiles -- the first pass puts up scaled
+  // previews (from the old pages, the page previews, or a quick
+  // draft) for the visible tiles, the second pass does the real
+  // rasterization
+  havePreview = needPaint = painted = false;
+  for (pass = 0; pass < 2; ++pass) {
+    for (i = 0; i < pages->getLength(); ++i) {
+      page = (PDFCorePage *)pages->get(i);
+      x0 = page->xDest;
+      x1 = x0 + page->w - 1;
+      if (x0 < -drawAreaWidth / 2) {
+	x0 = -drawAreaWidth / 2;
+      }
+      if (x1 > drawAreaWidth + drawAreaWidth / 2) {
+	x1 = drawAreaWidth + drawAreaWidth / 2;
+      }
+      x0 = ((x0 - page->xDest) / page->tileW) * page->tileW;
+      x1 = ((x1 - page->xDest) / page->tileW) * page->tileW;
+      y0 = page->yDest;
+      y1 = y0 + page->h - 1;
+      if (y0 < -drawAreaHeight / 2) {
+	y0 = -drawAreaHeight / 2;
+      }
+      if (y1 > drawAreaHeight + drawAreaHeight / 2) {
+	y1 = drawAreaHeight + drawAreaHeight / 2;
+      }
+      y0 = ((y0 - page->yDest) / page->tileH) * page->tileH;
+      y1 = ((y1 - page->yDest) / page->tileH) * page->tileH;
+      for (y = y0; y <= y1; y += page->tileH) {
+	for (x = x0; x <= x1; x += page->tileW) {
+	  visible = page->xDest + x < drawAreaWidth &&
+	            page->xDest + x + page->tileW > 0 &&
+	            page->yDest + y < drawAreaHeight &&
+	            page->yDest + y + page->tileH > 0;
+	  if (pass == 1) {
+	    empty = visible && !painted && !findTile(page, x, y);
+	    needTile(page, x, y);
+	    if (empty) {
+	      recordPaintTime(t0, true);
+	      painted = true;
+	    }
+	  } else if (pageGeom[page->page - 1].placeholder) {
+	    // placeholders are put up by needTile
+	  } else if (rotPages && !findTile(page, x, y) &&
+		     makeRotatedTile(page, x, y, rotPages, oldRotate)) {
+	    havePreview = havePreview || visible;
+	  } else if (visible && !findTile(page, x, y)) {
+	    needPaint = true;
+	    if (makePreviewTile(page, x, y, oldPages, oldDPI)) {
+	      havePreview = true;
+	    }
+	  }
+	}
+      }
+    }
+    if (pass == 0 && havePreview) {
+      redrawWindow(0, 0, drawAreaWidth, drawAreaHeight, false);
+      recordPaintTime(t0, true);
+      painted = true;
+    }
+  }
+  if (needPaint) {
+    recordPaintTime(t0, false);
+  }
+  if (oldPages) {
+    while (oldPages->getLength() > 0) {
+      discardPage((PDFCorePage *)oldPages->del(0), oldDPI, rotate);
+    }
+    delete oldPages;
+  }
+  if (rotPages) {
+    while (rotPages->getLength() > 0) {
+      discardPage((PDFCorePage *)rotPages->del(0), dpi, oldRotate);
+    }
+    delete rotPages;
+  }
+  packHiddenTiles();
+
+  // redraw the selection
+  if (selectULX != selectLRX && selectULY != selectLRY) {
+    xorColor[0] = xorColor[1] = xorColor[2] = 0xff;
+    xorRectangle(selectPage, selectULX, selectULY, selectLRX, selectLRY,
+		 new SplashSolidColor(xorColor));
+  }
+
+  // redraw the window
+  redrawWindow(0, 0, drawAreaWidth, drawAreaHeight, needUpdate);
+  updateScrollbars();
+
+  // add to history
+  if (addToHist) {
+    if (++historyCur == pdfHistorySize) {
+      historyCur = 0;
+    }
+    hist = &history[historyCur];
+    delete hist->fileName;
+    if (doc->getFileName()) {
+      hist->fileName = doc->getFileName()->copy();
+    } else {
+      hist->fileName = NULL;
+    }
+    hist->page = topPage;
+    if (historyBLen < pdfHistorySize) {
+      ++historyBLen;
+    }
+    historyFLen = 0;
+  }
+}
+
+void PDFCore::addPage(int pg, int rot) {
+  PDFCorePage *page;
+  int w, h, t, tileW, tileH, i;
+
+  w = (int)((getPageCropWidth(pg) * dpi) / 72 + 0.5);
+  h = (int)((getPageCropHeight(pg) * dpi) / 72 + 0.5);
+  if (rot == 90 || rot == 270) {
+    t = w; w = h; h = t;
+  }
+  tileW = 2 * drawAreaWidth;
+  if (tileW < 1500) {
+    tileW = 1500;
+  }
+  if (tileW > w) {
+    tileW = w;
+  }
+  tileH = 2 * drawAreaHeight;
+  if (tileH < 1500) {
+    tileH = 1500;
+  }
+  if (tileH > h) {
+    tileH = h;
+  }
+  page = new PDFCorePage(pg, w, h, tileW, tileH);
+  // fingerprint the page (at idle time, while the file is still
+  // intact), in case it is reloaded later
+  if (fingerprints) {
+    fingerprints->request(pg);
+  }
+  for (i = 0;
+       i < pages->getLength() && pg > ((PDFCorePage *)pages->get(i))->page;
+       ++i) ;
+  pages->insert(i, page);
+}
+
+// Create a new tile for the (<x>,<y>) slot on <page>.  The tile's
+// position and edge flags are set up, but it has no bitmap.
+PDFCoreTile *PDFCore::makeTile(PDFCorePage *page, int x, int y) {
+  PDFCoreTile *tile;
+  int xDest, yDest, sliceW, sliceH;
+
+  sliceW = page->tileW;
+  if (x + sliceW > page->w) {
+    sliceW = page->w - x;
+  }
+  sliceH = page->tileH;
+  if (y + sliceH > page->h) {
+    sliceH = page->h - y;
+  }
+
+  xDest = x - scrollX;
+  if (continuousMode) {
+    yDest = y + pageY[page->page - 1] - scrollY;
+  } else {
+    yDest = y - scrollY;
+  }
+  if (continuousMode) {
+    if (page->w < maxPageW) {
+      xDest += (maxPageW - page->w) / 2;
+    }
+    if (maxPageW < drawAreaWidth) {
+      xDest += (drawAreaWidth - maxPageW) / 2;
+    }
+  } else if (page->w < drawAreaWidth) {
+    xDest += (drawAreaWidth - page->w) / 2;
+  }
+  if (continuousMode && totalDocH < drawAreaHeight) {
+    yDest += (drawAreaHeight - totalDocH) / 2;
+  } else if (!continuousMode && page->h < drawAreaHeight) {
+    yDest += (drawAreaHeight - page->h) / 2;
+  }
+  tile = newTile(xDest, yDest);
+  tile->xMin = x;
+  tile->yMin = y;
+  tile->xMax = x + sliceW;
+  tile->yMax = y + sliceH;
+  tile->edges = 0;
+  if (tile->xMin == 0) {
+    tile->edges |= pdfCoreTileLeftEdge;
+  }
+  if (tile->xMax == page->w) {
+    tile->edges |= pdfCoreTileRightEdge;
+  }
+  if (continuousMode) {
+    if (tile->yMin == 0) {
+      tile->edges |= pdfCoreTileTopSpace;
+      if (page->page == 1) {
+	tile->edges |= pdfCoreTileTopEdge;
+      }
+    }
+    if (tile->yMax == page->h) {
+      tile->edges |= pdfCoreTileBottomSpace;
+      if (page->page == doc->getNumPages()) {
+	tile->edges |= pdfCoreTileBottomEdge;
+      }
+    }
+  } else {
+    if (tile->yMin == 0) {
+      tile->edges |= pdfCoreTileTopEdge;
+    }
+    if (tile->yMax == page->h) {
+      tile->edges |= pdfCoreTileBottomEdge;
+    }
+  }
+  return tile;
+}
+
+// Return the tile (real or preview) in the (<x>,<y>) slot on <page>,
+// or NULL if the slot is empty.
+PDFCoreTile *PDFCore::findTile(PDFCorePage *page, int x, int y) {
+  PDFCoreTile *tile;
+  int i;
+
+  for (i = 0; i < page->tiles->getLength(); ++i) {
+    tile = (PDFCoreTile *)page->tiles->get(i);
+    if (x == tile->xMin && y == tile->yMin) {
+      return tile;
+    }
+  }
+  return NULL;
+}
+
+void PDFCore::needTile(PDFCorePage *page, int x, int y) {
+  PDFCoreTile *tile;
+  bool incrementalUpdate, isNew, cached;
+
+  tile = findTile(page, x, y);
+  if (pageGeom[page->page - 1].placeholder) {
+    if (!tile) {
+      makePlaceholderTile(page, x, y);
+    }
+    return;
+  }
+  if (tile && !tile->preview && (!tile->draft || interactive)) {
+    return;
+  }
+
+  setBusyCursor(true);
+
+  // if there's a preview or a draft in this slot, rasterize into it --
+  // the old bitmap stays on screen until the new one is complete
+  cached = false;
+  if ((isNew = !tile)) {
+    if ((tile = takeCachedTile(page, x, y))) {
+      cached = true;
+    } else {
+      tile = makeTile(page, x, y);
+      cached = loadDiskTile(page, tile);
+    }
+  }
+  if (cached) {
+    // nothing to rasterize -- a packed tile is decompressed by update()
+    // once it is visible
+  } else if (interactive) {
+    drawDraftTile(page, tile);
+  } else {
+    incrementalUpdate = out->getIncrementalUpdate();
+    if (!isNew) {
+      delete tile->bitmap;
+      tile->bitmap = NULL;
+      tile->solid = false;
+      out->setIncrementalUpdate(false);
+    }
+    curTile = tile;
+    curPage = page;
+    rasterizeSlice(out, page, dpi, tile->xMin, tile->yMin,
+		   tile->xMax - tile->xMin, tile->yMax - tile->yMin);
+    out->setIncrementalUpdate(incrementalUpdate);
+    tile->bitmap = out->takeBitmap();
+    memcpy(tile->ctm, out->getDefCTM(), 6 * sizeof(double));
+    memcpy(tile->ictm, out->getDefICTM(), 6 * sizeof(double));
+    curTile = NULL;
+    curPage = NULL;
+    tile->draft = false;
+  }
+  needLinksAndText(page);
+  tile->preview = false;
+  if (isNew) {
+    page->tiles->append(tile);
+  }
+  if (!cached) {
+    ++stats.nTiles;
+    updatePreview(page, tile);
+    compactTile(tile);
+    if (!tile->draft) {
+      storeDiskTile(page, tile);
+    }
+  }
+
+  setBusyCursor(false);
+}
+
+// Put up a placeholder in the (<x>,<y>) slot on <page>, whose data
+// hasn't arrived yet.  The placeholder is marked as a draft, so it is
+// replaced once the page is available.
+void PDFCore::makePlaceholderTile(PDFCorePage *page, int x, int y) {
+  PDFCoreTile *tile;
+  Splash *splash;
+  SplashColor gray;
+  double det;
+
+  tile = makeTile(page, x, y);
+  gray[0] = gray[1] = gray[2] = pdfCorePlaceholderGray;
+  if (canFillTile(gray)) {
+    tile->solid = true;
+    splashColorCopy(tile->solidColor, gray);
+  } else {
+    tile->bitmap = new SplashBitmap(tile->xMax - tile->xMin,
+				    tile->yMax - tile->yMin,
+				    1, colorMode, false);
+    splash = new Splash(tile->bitmap, false);
+    splash->clear(gray, 0);
+    delete splash;
+  }
+
+  // the Page object isn't available, so the CTM is just a scale (it's
+  // only used for links and text, which the placeholder doesn't have)
+  tile->ctm[0] = dpi / 72;
+  tile->ctm[1] = tile->ctm[2] = 0;
+  tile->ctm[3] = -dpi / 72;
+  tile->ctm[4] = -tile->xMin;
+  tile->ctm[5] = page->h - tile->yMin;
+  det = 1 / (tile->ctm[0] * tile->ctm[3]);
+  tile->ictm[0] = tile->ctm[3] * det;
+  tile->ictm[1] = tile->ictm[2] = 0;
+  tile->ictm[3] = tile->ctm[0] * det;
+  tile->ictm[4] = -tile->ctm[3] * tile->ctm[4] * det;
+  tile->ictm[5] = -tile->ctm[0] * tile->ctm[5] * det;
+
+  tile->draft = true;
+  page->tiles->append(tile);
+  updateTileData(tile, 0, 0, tile->xMax - tile->xMin,
+		 tile->yMax - tile->yMin, true);
+}
+
+// Get the links and the text for <page>, if that hasn't been done yet.
+void PDFCore::needLinksAndText(PDFCorePage *page) {
+  TextOutputDev *textOut;
+
+  if (!page->links) {
+    page->links = doc->getLinks(page->page);
+  }
+  if (!page->text) {
+    if ((textOut = new TextOutputDev(NULL, true, false, false))) {
+      doc->displayPage(textOut, page->page, dpi, dpi, rotate,
+		       false, true, false);
+      page->text = textOut->takeText();
+      delete textOut;
+    }
+  }
+}
+
+// Rasterize <tile> in draft quality -- without anti-aliasing and, if
+// enabled, at reduced resolution -- and put it on the screen.
+void PDFCore::drawDraftTile(PDFCorePage *page, PDFCoreTile *tile) {
+  SplashBitmap *bitmap;
+  double draftDPI;
+  int x0, y0, x1, y1;
+
+  delete tile->bitmap;
+  tile->solid = false;
+  if (globalParamsGUI->getInteractiveDraftLowRes() &&
+      colorMode == splashModeRGB8) {
+    draftDPI = dpi / pdfCoreDraftScale;
+    x0 = tile->xMin / pdfCoreDraftScale;
+    y0 = tile->yMin / pdfCoreDraftScale;
+    x1 = (tile->xMax + pdfCoreDraftScale - 1) / pdfCoreDraftScale;
+    y1 = (tile->yMax + pdfCoreDraftScale - 1) / pdfCoreDraftScale;
+    rasterizeSlice(draftOut, page, draftDPI, x0, y0, x1 - x0, y1 - y0);
+    bitmap = draftOut->takeBitmap();
+    tile->bitmap = makePaperBitmap(tile->xMax - tile->xMin,
+				   tile->yMax - tile->yMin);
+    resampleBitmap(tile->bitmap, tile->xMin, tile->yMin,
+		   bitmap, x0, y0, draftDPI / dpi);
+    delete bitmap;
+    setTileCTM(page, tile);
+  } else {
+    rasterizeSlice(draftOut, page, dpi, tile->xMin, tile->yMin,
+		   tile->xMax - tile->xMin, tile->yMax - tile->yMin);
+    tile->bitmap = draftOut->takeBitmap();
+    memcpy(tile->ctm, draftOut->getDefCTM(), 6 * sizeof(double));
+    memcpy(tile->ictm, draftOut->getDefICTM(), 6 * sizeof(double));
+  }
+  tile->draft = true;
+  clippedRedrawRect(tile, 0, 0, tile->xDest, tile->yDest,
+		    tile->bitmap->getWidth(), tile->bitmap->getHeight(),
+		    0, 0, drawAreaWidth, drawAreaHeight, true);
+  compactTile(tile);
+}
+
+// Create a bitmap of the given size, cleared to the (rasterization)
+// paper color.
+SplashBitmap *PDFCore::makePaperBitmap(int w, int h) {
+  SplashBitmap *bitmap;
+  Splash *splash;
+  SplashColor white;
+
+  bitmap = new SplashBitmap(w, h, 1, colorMode, false);
+  splash = new Splash(bitmap, false);
+  white[0] = white[1] = white[2] = 0xff;
+  splash->clear(white, 0);
+  delete splash;
+  return bitmap;
+}
+
+// Returns true if every pixel of <bitmap> (<nComps> bytes each) is the
+// same as the first one.
+static bool isUniformBitmap(SplashBitmap *bitmap, int nComps) {
+  SplashColorPtr row, p;
+  int rowBytes, x, y;
+
+  rowBytes = bitmap->getWidth() * nComps;
+  row = bitmap->getDataPtr();
+  for (x = nComps, p = row + nComps; x < rowBytes; x += nComps, p += nComps) {
+    if (memcmp(p, row, nComps)) {
+      return false;
+    }
+  }
+  for (y = 1; y < bitmap->getHeight(); ++y) {
+    if (memcmp(row + y * bitmap->getRowSize(), row, rowBytes)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// If the RGB8 <bitmap> has no chroma, return a copy of it in
+// splashModeMono8 -- or in splashModeMono1, if every pixel is black
+// or white.  Otherwise, return NULL.
+static SplashBitmap *makeGrayBitmap(SplashBitmap *bitmap) {
+  SplashBitmap *gray;
+  SplashColorPtr p, q;
+  bool mono;
+  int w, h, x, y;
+
+  w = bitmap->getWidth();
+  h = bitmap->getHeight();
+  mono = true;
+  for (y = 0; y < h; ++y) {
+    p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    for (x = 0; x < w; ++x, p += 3) {
+      if (p[1] != p[0] || p[2] != p[0]) {
+	return NULL;
+      }
+      if (p[0] != 0x00 && p[0] != 0xff) {
+	mono = false;
+      }
+    }
+  }
+  if (mono) {
+    gray = new SplashBitmap(w, h, 1, splashModeMono1, false);
+    for (y = 0; y < h; ++y) {
+      p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+      q = gray->getDataPtr() + y * gray->getRowSize();
+      memset(q, 0, gray->getRowSize());
+      for (x = 0; x < w; ++x, p += 3) {
+	if (p[0]) {
+	  q[x >> 3] |= 0x80 >> (x & 7);
+	}
+      }
+    }
+  } else {
+    gray = new SplashBitmap(w, h, 1, splashModeMono8, false);
+    for (y = 0; y < h; ++y) {
+      p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+      q = gray->getDataPtr() + y * gray->getRowSize();
+      for (x = 0; x < w; ++x, p += 3) {
+	*q++ = p[0];
+      }
+    }
+  }
+  return gray;
+}
+
+// Return an RGB8 copy of the gray or monochrome <bitmap>.
+static SplashBitmap *makeRGBBitmap(SplashBitmap *bitmap) {
+  SplashBitmap *rgb;
+  SplashColorPtr p, q;
+  Guchar c;
+  int w, h, x, y;
+
+  w = bitmap->getWidth();
+  h = bitmap->getHeight();
+  rgb = new SplashBitmap(w, h, 1, splashModeRGB8, false);
+  for (y = 0; y < h; ++y) {
+    p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    q = rgb->getDataPtr() + y * rgb->getRowSize();
+    for (x = 0; x < w; ++x) {
+      if (bitmap->getMode() == splashModeMono1) {
+	c = (p[x >> 3] & (0x80 >> (x & 7))) ? 0xff : 0x00;
+      } else {
+	c = p[x];
+      }
+      *q++ = c;
+      *q++ = c;
+      *q++ = c;
+    }
+  }
+  return rgb;
+}
+
+// Store the newly rasterized <tile> compactly, if possible.  If every
+// pixel has the same color -- typically, a blank piece of paper --
+// free its bitmap and keep only the color; such a tile is drawn with
+// a plain rectangle fill.  If the tile has no chroma (e.g., black
+// text on white paper), keep it as 8-bit gray, or as 1-bit when that
+// is exact; it is converted to the display format when it is drawn.
+void PDFCore::compactTile(PDFCoreTile *tile) {
+  SplashBitmap *bitmap, *gray;
+  int nComps;
+
+  bitmap = tile->bitmap;
+  if (!bitmap || colorMode == splashModeMono1 ||
+      bitmap->getMode() != colorMode) {
+    return;
+  }
+  nComps = splashColorModeNComps[colorMode];
+  if (isUniformBitmap(bitmap, nComps) && canFillTile(bitmap->getDataPtr())) {
+    memcpy(tile->solidColor, bitmap->getDataPtr(), nComps);
+    delete tile->bitmap;
+    tile->bitmap = NULL;
+    tile->solid = true;
+    ++stats.nSolidTiles;
+  } else if (colorMode == splashModeRGB8 &&
+	     (gray = makeGrayBitmap(bitmap))) {
+    if (gray->getMode() == splashModeMono1) {
+      ++stats.nMonoTiles;
+    } else {
+      ++stats.nGrayTiles;
+    }
+    delete tile->bitmap;
+    tile->bitmap = gray;
+  } else {
+    return;
+  }
+  updateTileData(tile, 0, 0, tile->xMax - tile->xMin,
+		 tile->yMax - tile->yMin, true);
+}
+
+// Compress the bitmap of <tile>, which isn't visible.  Drafts and
+// previews are left alone, as they will be rasterized again anyway.
+void PDFCore::packTile(PDFCoreTile *tile) {
+  SplashBitmap *bitmap;
+
+  bitmap = tile->bitmap;
+  if (!bitmap || tile->draft || tile->preview ||
+      bitmap->getWidth() != tile->xMax - tile->xMin ||
+      bitmap->getHeight() != tile->yMax - tile->yMin) {
+    return;
+  }
+  tile->packedData = packPixels(bitmap, bufPool, &tile->packedLen);
+  tile->packedMode = bitmap->getMode();
+  ++stats.nPackedTiles;
+  stats.packRawBytes += (double)bitmap->getRowSize() * bitmap->getHeight();
+  stats.packBytes += tile->packedLen;
+  delete tile->bitmap;
+  tile->bitmap = NULL;
+  updateTileData(tile, 0, 0, tile->xMax - tile->xMin,
+		 tile->yMax - tile->yMin, true);
+}
+
+// Return a new bitmap with the decompressed contents of the packed
+// <tile>.  The tile itself is not changed.  If the packed data is
+// malformed, the bitmap is left blank.
+SplashBitmap *PDFCore::decodeTile(PDFCoreTile *tile) {
+  SplashBitmap *bitmap;
+  double t0;
+  int w, h;
+
+  t0 = getTimeMs();
+  w = tile->xMax - tile->xMin;
+  h = tile->yMax - tile->yMin;
+  bitmap = new SplashBitmap(w, h, 1, tile->packedMode, false);
+  if (!unpackPixels(tile->packedData, tile->packedLen, tile->packedMode,
+		    w, h, bitmap)) {
+    memset(bitmap->getDataPtr(), 0xff, (size_t)bitmap->getRowSize() * h);
+  }
+  ++stats.nUnpackedTiles;
+  stats.unpackTime += getTimeMs() - t0;
+  return bitmap;
+}
+
+// Give a single-color or packed <tile> a real bitmap again, e.g.,
+// when it becomes visible.  If <fullColor> is set, a gray or
+// monochrome tile is also converted back to the full color mode, as
+// needed before drawing a selection into it.
+void PDFCore::expandTile(PDFCoreTile *tile, bool fullColor) {
+  SplashBitmap *rgb;
+  Splash *splash;
+
+  if (tile->solid) {
+    tile->bitmap = new SplashBitmap(tile->xMax - tile->xMin,
+				    tile->yMax - tile->yMin, 1,
+				    colorMode, false);
+    splash = new Splash(tile->bitmap, false);
+    splash->clear(tile->solidColor, 0);
+    delete splash;
+    tile->solid = false;
+  } else if (tile->packedData) {
+    tile->bitmap = decodeTile(tile);
+    gfree(tile->packedData);
+    tile->packedData = NULL;
+    tile->packedLen = 0;
+  } else if (!fullColor || tile->bitmap->getMode() == colorMode) {
+    return;
+  }
+  if (fullColor && tile->bitmap->getMode() != colorMode) {
+    rgb = makeRGBBitmap(tile->bitmap);
+    delete tile->bitmap;
+    tile->bitmap = rgb;
+  }
+  updateTileData(tile, 0, 0, tile->xMax - tile->xMin,
+		 tile->yMax - tile->yMin, true);
+}
+
+// Compress the tiles that aren't visible, and decompress the ones
+// that have come back into view.
+void PDFCore::packHiddenTiles() {
+  PDFCorePage *page;
+  PDFCoreTile *tile;
+  int i, j;
+
+  for (i = 0; i < pages->getLength(); ++i) {
+    page = (PDFCorePage *)pages->get(i);
+    for (j = 0; j < page->tiles->getLength(); ++j) {
+      tile = (PDFCoreTile *)page->tiles->get(j);
+      if (tile->xDest < drawAreaWidth &&
+	  tile->xDest + (tile->xMax - tile->xMin) > 0 &&
+	  tile->yDest < drawAreaHeight &&
+	  tile->yDest + (tile->yMax - tile->yMin) > 0) {
+	if (tile->packedData) {
+	  expandTile(tile, false);
+	}
+      } else {
+	packTile(tile);
+      }
+    }
+  }
+}
+
+// Remove <tile>, which was rasterized for page <pg> at <dpiA> and
+// <rotateA>, from the display.  If possible, it is compressed and kept
+// in the tile cache; otherwise it is deleted.
+void PDFCore::discardTile(int pg, double dpiA, int rotateA,
+			  PDFCoreTile *tile) {
+  PDFCoreCachedTile *entry;
+  int maxSize;
+
+  maxSize = globalParamsGUI->getTileCacheSize() * 1024 * 1024;
+  if (maxSize <= 0 || tile->draft || tile->preview) {
+    delete tile;
+    return;
+  }
+  packTile(tile);
+  if (!tile->solid && !tile->packedData) {
+    delete tile;
+    return;
+  }
+  entry = new PDFCoreCachedTile(pg, dpiA, rotateA, tile);
+  tileCache->insert(0, entry);
+  tileCacheBytes += entry->size;
+  while (tileCacheBytes > maxSize && tileCache->getLength() > 0) {
+    entry = (PDFCoreCachedTile *)tileCache->del(tileCache->getLength() - 1);
+    tileCacheBytes -= entry->size;
+    delete entry;
+  }
+}
+
+// Discard all of the tiles of <page>, which was rasterized at <dpiA>
+// and <rotateA>, and delete the page.
+void PDFCore::discardPage(PDFCorePage *page, double dpiA, int rotateA) {
+  while (page->tiles->getLength() > 0) {
+    discardTile(page->page, dpiA, rotateA,
+		(PDFCoreTile *)page->tiles->del(0));
+  }
+  delete page;
+}
+
+// If the tile cache has the (<x>,<y>) slot on <page>, at the current
+// resolution and rotation, return a new tile for that slot with the
+// cached contents.  Otherwise, return NULL.
+PDFCoreTile *PDFCore::takeCachedTile(PDFCorePage *page, int x, int y) {
+  PDFCoreCachedTile *entry;
+  PDFCoreTile *tile, *cachedTile;
+  int i;
+
+  for (i = 0; i < tileCache->getLength(); ++i) {
+    entry = (PDFCoreCachedTile *)tileCache->get(i);
+    cachedTile = entry->tile;
+    if (entry->page == page->page && entry->rotate == rotate &&
+	fabs(entry->dpi - dpi) <= EPSILON &&
+	cachedTile->xMin == x && cachedTile->yMin == y) {
+      break;
+    }
+  }
+  if (i == tileCache->getLength()) {
+    return NULL;
+  }
+  tileCache->del(i);
+  tileCacheBytes -= entry->size;
+  tile = makeTile(page, x, y);
+  if (tile->xMax != cachedTile->xMax || tile->yMax != cachedTile->yMax) {
+    // the tile size has changed (e.g., the window was resized)
+    delete tile;
+    delete entry;
+    return NULL;
+  }
+  memcpy(tile->ctm, cachedTile->ctm, 6 * sizeof(double));
+  memcpy(tile->ictm, cachedTile->ictm, 6 * sizeof(double));
+  tile->solid = cachedTile->solid;
+  splashColorCopy(tile->solidColor, cachedTile->solidColor);
+  tile->packedData = cachedTile->packedData;
+  tile->packedLen = cachedTile->packedLen;
+  tile->packedMode = cachedTile->packedMode;
+  cachedTile->packedData = NULL;
+  delete entry;
+  ++stats.nCachedTiles;
+  updateTileData(tile, 0, 0, tile->xMax - tile->xMin,
+		 tile->yMax - tile->yMin, true);
+  return tile;
+}
+
+// Build the on-disk tile cache key for <tile> on <page>, from the file
+// identity, the slot, and everything that affects rasterization.
+GooString *PDFCore::makeDiskTileKey(PDFCorePage *page, PDFCoreTile *tile) {
+  GooString *key;
+  char buf[256];
+
+  key = docKey->copy();
+  sprintf(buf, "|%d|%d|%.4f|%d|%d|%d|%d|%d|%d%d%d%d%d",
+	  page->page, rotate, dpi, tile->xMin, tile->yMin,
+	  tile->xMax - tile->xMin, tile->yMax - tile->yMin,
+	  (int)colorMode, out->getVectorAntialias() ? 1 : 0,
+	  globalParamsGUI->getAntialias() ? 1 : 0,
+	  globalParamsGUI->getEnableFreeTypeHinting() ? 1 : 0,
+	  globalParamsGUI->getEnableFreeTypeSlightHinting() ? 1 : 0,
+	  globalParamsGUI->getStrokeAdjust() ? 1 : 0);
+  key->append(buf);
+  return key;
+}
+
+// Look for <tile> in the on-disk tile cache.  If found, the tile is
+// filled in (solid or packed) and true is returned.  An entry whose
+// packed data is malformed is removed from the cache.
+bool PDFCore::loadDiskTile(PDFCorePage *page, PDFCoreTile *tile) {
+  GooString *key;
+  bool ok;
+
+  if (!diskCache || !docKey) {
+    return false;
+  }
+  key = makeDiskTileKey(page, tile);
+  ok = diskCache->load(key, tile);
+  if (ok && !tile->solid &&
+      !unpackPixels(tile->packedData, tile->packedLen, tile->packedMode,
+		    tile->xMax - tile->xMin, tile->yMax - tile->yMin, NULL)) {
+    gfree(tile->packedData);
+    tile->packedData = NULL;
+    tile->packedLen = 0;
+    diskCache->remove(key);
+    ok = false;
+  }
+  delete key;
+  if (ok) {
+    ++stats.nDiskTiles;
+    updateTileData(tile, 0, 0, tile->xMax - tile->xMin,
+		   tile->yMax - tile->yMin, true);
+  }
+  return ok;
+}
+
+// Queue the newly rasterized <tile> to be written to the on-disk tile
+// cache.  The pixels are copied here, and packed and written by the
+// cache's writer thread.
+void PDFCore::storeDiskTile(PDFCorePage *page, PDFCoreTile *tile) {
+  SplashBitmap *bitmap, *copy;
+  GooString *key;
+  int rowBytes, y;
+
+  if (!diskCache || !docKey) {
+    return;
+  }
+  bitmap = tile->bitmap;
+  if (tile->solid) {
+    key = makeDiskTileKey(page, tile);
+    diskCache->store(key, tile, NULL);
+    delete key;
+  } else if (bitmap &&
+	     bitmap->getWidth() == tile->xMax - tile->xMin &&
+	     bitmap->getHeight() == tile->yMax - tile->yMin) {
+    key = makeDiskTileKey(page, tile);
+    copy = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(), 1,
+			    bitmap->getMode(), false);
+    rowBytes = copy->getRowSize() < bitmap->getRowSize()
+                 ? copy->getRowSize() : bitmap->getRowSize();
+    for (y = 0; y < bitmap->getHeight(); ++y) {
+      memcpy(copy->getDataPtr() + y * copy->getRowSize(),
+	     bitmap->getDataPtr() + y * bitmap->getRowSize(), rowBytes);
+    }
+    diskCache->store(key, tile, copy);
+    delete key;
+  }
+}
+
+void PDFCore::clearTileCache() {
+  while (tileCache->getLength() > 0) {
+    delete (PDFCoreCachedTile *)tileCache->del(0);
+  }
+  tileCacheBytes = 0;
+}
+
+// Create a preview tile for the (<x>,<y>) slot on <page>, by scaling
+// the tiles from <oldPages> (rasterized at <oldDPI>) and/or the page
+// preview.  If neither is available, a draft of the page is made.
+// Returns false if there is nothing to build the preview from, or if
+// the slot is already filled.
+bool PDFCore::makePreviewTile(PDFCorePage *page, int x, int y,
+			      GooList *oldPages, double oldDPI) {
+  PDFCorePage *oldPage;
+  PDFCoreTile *tile, *oldTile;
+  PDFCorePreview *preview;
+  SplashBitmap *bitmap;
+  int i;
+
+  if (colorMode != splashModeRGB8 || findTile(page, x, y)) {
+    return false;
+  }
+  oldPage = NULL;
+  if (oldPages) {
+    for (i = 0; i < oldPages->getLength(); ++i) {
+      if (((PDFCorePage *)oldPages->get(i))->page == page->page) {
+	oldPage = (PDFCorePage *)oldPages->get(i);
+	break;
+      }
+    }
+    if (oldPage && oldPage->tiles->getLength() == 0) {
+      oldPage = NULL;
+    }
+  }
+  preview = findPreview(page->page);
+  if (!oldPage && !preview && !(preview = makeDraftPreview(page))) {
+    return false;
+  }
+
+  tile = makeTile(page, x, y);
+  tile->bitmap = makePaperBitmap(tile->xMax - tile->xMin,
+				 tile->yMax - tile->yMin);
+  if (preview) {
+    resampleBitmap(tile->bitmap, tile->xMin, tile->yMin,
+		   preview->bitmap, preview->xMin, preview->yMin,
+		   preview->dpi / dpi);
+  }
+  if (oldPage) {
+    for (i = 0; i < oldPage->tiles->getLength(); ++i) {
+      oldTile = (PDFCoreTile *)oldPage->tiles->get(i);
+      if (oldTile->solid) {
+	fillScaledRect(tile->bitmap, tile->xMin, tile->yMin,
+		       oldTile->solidColor, oldTile->xMin, oldTile->yMin,
+		       oldTile->xMax - oldTile->xMin,
+		       oldTile->yMax - oldTile->yMin, oldDPI / dpi);
+      } else if (oldTile->packedData) {
+	bitmap = decodeTile(oldTile);
+	resampleBitmap(tile->bitmap, tile->xMin, tile->yMin,
+		       bitmap, oldTile->xMin, oldTile->yMin, oldDPI / dpi);
+	delete bitmap;
+      } else {
+	resampleBitmap(tile->bitmap, tile->xMin, tile->yMin,
+		       oldTile->bitmap, oldTile->xMin, oldTile->yMin,
+		       oldDPI / dpi);
+      }
+    }
+  }
+  setTileCTM(page, tile);
+  tile->preview = true;
+  page->tiles->append(tile);
+  updateTileData(tile, 0, 0, tile->xMax - tile->xMin,
+		 tile->yMax - tile->yMin, true);
+  return true;
+}
+
+// Find the part of the (<x>,<y>,<w>,<h>) rectangle that is covered by
+// the old <tile>, rotated by <rot> degrees (90, 180, or 270) on a page
+// that was <w0> x <h0> pixels before rotation.  Returns false if
+// there is no overlap, or if the tile can't be used as a source.
+static bool getRotatedRect(PDFCoreTile *tile, int rot, int w0, int h0,
+			   int x, int y, int w, int h,
+			   int *rx0, int *ry0, int *rx1, int *ry1) {
+  if (tile->preview) {
+    return false;
+  }
+  if (!tile->solid && !tile->packedData &&
+      (!tile->bitmap ||
+       tile->bitmap->getWidth() != tile->xMax - tile->xMin ||
+       tile->bitmap->getHeight() != tile->yMax - tile->yMin)) {
+    return false;
+  }
+  switch (rot) {
+  case 90:
+  default:
+    *rx0 = h0 - tile->yMax;
+    *rx1 = h0 - tile->yMin;
+    *ry0 = tile->xMin;
+    *ry1 = tile->xMax;
+    break;
+  case 180:
+    *rx0 = w0 - tile->xMax;
+    *rx1 = w0 - tile->xMin;
+    *ry0 = h0 - tile->yMax;
+    *ry1 = h0 - tile->yMin;
+    break;
+  case 270:
+    *rx0 = tile->yMin;
+    *rx1 = tile->yMax;
+    *ry0 = w0 - tile->xMax;
+    *ry1 = w0 - tile->xMin;
+    break;
+  }
+  if (*rx0 < x) {
+    *rx0 = x;
+  }
+  if (*rx1 > x + w) {
+    *rx1 = x + w;
+  }
+  if (*ry0 < y) {
+    *ry0 = y;
+  }
+  if (*ry1 > y + h) {
+    *ry1 = y + h;
+  }
+  return *rx0 < *rx1 && *ry0 < *ry1;
+}
+
+// Read pixel (<x>,<y>) of the RGB8, Mono8, or Mono1 <bitmap>.
+static void getBitmapRGB(SplashBitmap *bitmap, int x, int y, Guchar *rgb) {
+  SplashColorPtr p;
+
+  p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+  switch (bitmap->getMode()) {
+  case splashModeMono1:
+    rgb[0] = rgb[1] = rgb[2] = (p[x >> 3] & (0x80 >> (x & 7))) ? 0xff : 0x00;
+    break;
+  case splashModeMono8:
+    rgb[0] = rgb[1] = rgb[2] = p[x];
+    break;
+  default:
+    p += 3 * x;
+    rgb[0] = p[0];
+    rgb[1] = p[1];
+    rgb[2] = p[2];
+    break;
   }
+}
 
-  // redraw the window
-  redrawWindow(0, 0, drawAreaWidth, drawAreaHeight, needUpdate);
-  updateScrollbars();
+// Create the (<x>,<y>) tile on <page> by rotating the pixels of the
+// tiles in <oldPages>, which were rasterized at the current resolution
+// but at rotation <oldRotate>.  A quarter turn of a raster is just a
+// permutation of its pixels, so the result is used as a finished tile.
+// Returns false (and creates nothing) unless the old tiles cover the
+// whole slot.
+bool PDFCore::makeRotatedTile(PDFCorePage *page, int x, int y,
+			      GooList *oldPages, int oldRotate) {
+  PDFCorePage *oldPage;
+  PDFCoreTile *tile, *oldTile;
+  SplashBitmap *src;
+  SplashColorPtr q;
+  Guchar rgb[3];
+  int rot, w0, h0, tw, th, area, i;
+  int rx0, ry0, rx1, ry1, xx, yy, sx, sy;
+  bool draft;
+
+  if (colorMode != splashModeRGB8) {
+    return false;
+  }
+  oldPage = NULL;
+  for (i = 0; i < oldPages->getLength(); ++i) {
+    if (((PDFCorePage *)oldPages->get(i))->page == page->page) {
+      oldPage = (PDFCorePage *)oldPages->get(i);
+      break;
+    }
+  }
+  if (!oldPage) {
+    return false;
+  }
+  rot = (rotate - oldRotate + 360) % 360;
+  w0 = oldPage->w;
+  h0 = oldPage->h;
+  tw = page->tileW;
+  if (x + tw > page->w) {
+    tw = page->w - x;
+  }
+  th = page->tileH;
+  if (y + th > page->h) {
+    th = page->h - y;
+  }
 
-  // add to history
-  if (addToHist) {
-    if (++historyCur == pdfHistorySize) {
-      historyCur = 0;
+  // check that the usable old tiles cover the whole slot
+  area = 0;
+  for (i = 0; i < oldPage->tiles->getLength(); ++i) {
+    oldTile = (PDFCoreTile *)oldPage->tiles->get(i);
+    if (!getRotatedRect(oldTile, rot, w0, h0, x, y, tw, th,
+			&rx0, &ry0, &rx1, &ry1)) {
+      continue;
     }
-    hist = &history[historyCur];
-    delete hist->fileName;
-    if (doc->getFileName()) {
-      hist->fileName = doc->getFileName()->copy();
+    area += (rx1 - rx0) * (ry1 - ry0);
+  }
+  if (area < tw * th) {
+    return false;
+  }
+
+  tile = makeTile(page, x, y);
+  tile->bitmap = new SplashBitmap(tw, th, 1, colorMode, false);
+  draft = false;
+  for (i = 0; i < oldPage->tiles->getLength(); ++i) {
+    oldTile = (PDFCoreTile *)oldPage->tiles->get(i);
+    if (!getRotatedRect(oldTile, rot, w0, h0, x, y, tw, th,
+			&rx0, &ry0, &rx1, &ry1)) {
+      continue;
+    }
+    draft = draft || oldTile->draft;
+    if (oldTile->solid) {
+      src = NULL;
+    } else if (oldTile->packedData) {
+      src = decodeTile(oldTile);
     } else {
-      hist->fileName = NULL;
+      src = oldTile->bitmap;
     }
-    hist->page = topPage;
-    if (historyBLen < pdfHistorySize) {
-      ++historyBLen;
+    for (yy = ry0; yy < ry1; ++yy) {
+      q = tile->bitmap->getDataPtr() + (yy - y) * tile->bitmap->getRowSize()
+	  + (rx0 - x) * 3;
+      for (xx = rx0; xx < rx1; ++xx) {
+	// map the new device space pixel back to the old device space
+	switch (rot) {
+	case 90:
+	default:
+	  sx = yy;
+	  sy = h0 - 1 - xx;
+	  break;
+	case 180:
+	  sx = w0 - 1 - xx;
+	  sy = h0 - 1 - yy;
+	  break;
+	case 270:
+	  sx = w0 - 1 - yy;
+	  sy = xx;
+	  break;
+	}
+	if (src) {
+	  getBitmapRGB(src, sx - oldTile->xMin, sy - oldTile->yMin, rgb);
+	  q[0] = rgb[0];
+	  q[1] = rgb[1];
+	  q[2] = rgb[2];
+	} else {
+	  q[0] = oldTile->solidColor[0];
+	  q[1] = oldTile->solidColor[1];
+	  q[2] = oldTile->solidColor[2];
+	}
+	q += 3;
+      }
+    }
+    if (src && src != oldTile->bitmap) {
+      delete src;
     }
-    historyFLen = 0;
   }
+
+  setTileCTM(page, tile);
+  tile->draft = draft;
+  page->tiles->append(tile);
+  updateTileData(tile, 0, 0, tw, th, true);
+  compactTile(tile);
+  needLinksAndText(page);
+  ++stats.nRotatedTiles;
+  return true;
 }
 
-void PDFCore::addPage(int pg, int rot) {
-  PDFCorePage *page;
-  int w, h, t, tileW, tileH, i;
+// Quickly rasterize the part of <page> that is visible in the window,
+// at 1/pdfCoreDraftScale of the current resolution and without
+// anti-aliasing, and add it to the preview list.  Returns NULL if
+// drafts are disabled or nothing of the page is visible.
+PDFCorePreview *PDFCore::makeDraftPreview(PDFCorePage *page) {
+  PDFCorePreview *preview;
+  double draftDPI;
+  int x0, y0, x1, y1;
 
-  w = (int)((doc->getPageCropWidth(pg) * dpi) / 72 + 0.5);
-  h = (int)((doc->getPageCropHeight(pg) * dpi) / 72 + 0.5);
-  if (rot == 90 || rot == 270) {
-    t = w; w = h; h = t;
+  if (dpi <= pdfCorePreviewDPI || !globalParamsGUI->getLowResFirstPaint()) {
+    return NULL;
   }
-  tileW = 2 * drawAreaWidth;
-  if (tileW < 1500) {
-    tileW = 1500;
+
+  // visible part of the page, in device space
+  x0 = -page->xDest;
+  if (x0 < 0) {
+    x0 = 0;
   }
-  if (tileW > w) {
-    tileW = w;
+  x1 = drawAreaWidth - page->xDest;
+  if (x1 > page->w) {
+    x1 = page->w;
   }
-  tileH = 2 * drawAreaHeight;
-  if (tileH < 1500) {
-    tileH = 1500;
+  y0 = -page->yDest;
+  if (y0 < 0) {
+    y0 = 0;
   }
-  if (tileH > h) {
-    tileH = h;
+  y1 = drawAreaHeight - page->yDest;
+  if (y1 > page->h) {
+    y1 = page->h;
   }
-  page = new PDFCorePage(pg, w, h, tileW, tileH);
-  for (i = 0;
-       i < pages->getLength() && pg > ((PDFCorePage *)pages->get(i))->page;
-       ++i) ;
-  pages->insert(i, page);
+  if (x0 >= x1 || y0 >= y1) {
+    return NULL;
+  }
+
+  draftDPI = dpi / pdfCoreDraftScale;
+  x0 = x0 / pdfCoreDraftScale;
+  y0 = y0 / pdfCoreDraftScale;
+  x1 = (x1 + pdfCoreDraftScale - 1) / pdfCoreDraftScale;
+  y1 = (y1 + pdfCoreDraftScale - 1) / pdfCoreDraftScale;
+  rasterizeSlice(draftOut, page, draftDPI, x0, y0, x1 - x0, y1 - y0);
+  preview = new PDFCorePreview(page->page, rotate, draftDPI, x0, y0,
+			       draftOut->takeBitmap());
+  previews->insert(0, preview);
+  if (previews->getLength() > pdfCoreMaxPreviews) {
+    delete (PDFCorePreview *)previews->del(previews->getLength() - 1);
+  }
+  return preview;
 }
 
-void PDFCore::needTile(PDFCorePage *page, int x, int y) {
-  PDFCoreTile *tile;
-  TextOutputDev *textOut;
-  int xDest, yDest, sliceW, sliceH;
-  int i;
+// Copy a newly rasterized tile into the page's low-res preview.
+void PDFCore::updatePreview(PDFCorePage *page, PDFCoreTile *tile) {
+  PDFCorePreview *preview;
+  int w, h;
 
-  for (i = 0; i < page->tiles->getLength(); ++i) {
-    tile = (PDFCoreTile *)page->tiles->get(i);
-    if (x == tile->xMin && y == tile->yMin) {
+  if (colorMode != splashModeRGB8 || dpi <= pdfCorePreviewDPI) {
+    return;
+  }
+  if (!(preview = findPreview(page->page))) {
+    w = (int)(page->w * pdfCorePreviewDPI / dpi + 0.5);
+    h = (int)(page->h * pdfCorePreviewDPI / dpi + 0.5);
+    if (w <= 0 || h <= 0) {
       return;
     }
+    preview = new PDFCorePreview(page->page, rotate, pdfCorePreviewDPI,
+				 0, 0, makePaperBitmap(w, h));
+    previews->insert(0, preview);
+    if (previews->getLength() > pdfCoreMaxPreviews) {
+      delete (PDFCorePreview *)previews->del(previews->getLength() - 1);
+    }
   }
+  resampleBitmap(preview->bitmap, preview->xMin, preview->yMin, tile->bitmap,
+		 tile->xMin, tile->yMin, dpi / preview->dpi);
+}
 
-  setBusyCursor(true);
+// Find the preview for page <pg> at the current rotation, and move it
+// to the front of the list.
+PDFCorePreview *PDFCore::findPreview(int pg) {
+  PDFCorePreview *preview;
+  int i;
 
-  sliceW = page->tileW;
-  if (x + sliceW > page->w) {
-    sliceW = page->w - x;
-  }
-  sliceH = page->tileH;
-  if (y + sliceH > page->h) {
-    sliceH = page->h - y;
+  for (i = 0; i < previews->getLength(); ++i) {
+    preview = (PDFCorePreview *)previews->get(i);
+    if (preview->page == pg && preview->rotate == rotate) {
+      if (i > 0) {
+	previews->del(i);
+	previews->insert(0, preview);
+      }
+      return preview;
+    }
   }
+  return NULL;
+}
 
-  xDest = x - scrollX;
-  if (continuousMode) {
-    yDest = y + pageY[page->page - 1] - scrollY;
-  } else {
-    yDest = y - scrollY;
+void PDFCore::clearPreviews() {
+  while (previews->getLength() > 0) {
+    delete (PDFCorePreview *)previews->del(0);
   }
-  if (continuousMode) {
-    if (page->w < maxPageW) {
-      xDest += (maxPageW - page->w) / 2;
+}
+
+// Add the time elapsed since <t0> to the first-paint (if <first> is
+// set) or full-paint statistics.
+void PDFCore::recordPaintTime(double t0, bool first) {
+  double t;
+
+  t = getTimeMs() - t0;
+  if (first) {
+    stats.firstPaintLast = t;
+    if (t > stats.firstPaintMax) {
+      stats.firstPaintMax = t;
     }
-    if (maxPageW < drawAreaWidth) {
-      xDest += (drawAreaWidth - maxPageW) / 2;
+    stats.firstPaintTotal += t;
+  } else {
+    ++stats.nPaints;
+    stats.fullPaintLast = t;
+    if (t > stats.fullPaintMax) {
+      stats.fullPaintMax = t;
     }
-  } else if (page->w < drawAreaWidth) {
-    xDest += (drawAreaWidth - page->w) / 2;
+    stats.fullPaintTotal += t;
   }
-  if (continuousMode && totalDocH < drawAreaHeight) {
-    yDest += (drawAreaHeight - totalDocH) / 2;
-  } else if (!continuousMode && page->h < drawAreaHeight) {
-    yDest += (drawAreaHeight - page->h) / 2;
+}
+
+void PDFCore::printStats(FILE *f) {
+  fprintf(f, "tiles:       %d rasterized (%d solid, %d gray, %d mono), "
+	  "%d from cache, %d from disk, %d rotated\n",
+	  stats.nTiles, stats.nSolidTiles, stats.nGrayTiles, stats.nMonoTiles,
+	  stats.nCachedTiles, stats.nDiskTiles, stats.nRotatedTiles);
+  if (stats.nPackedTiles > 0) {
+    fprintf(f, "packed:      %d tiles, ratio %.1f:1\n",
+	    stats.nPackedTiles, stats.packRawBytes / stats.packBytes);
   }
-  curTile = tile = newTile(xDest, yDest);
-  curPage = page;
-  tile->xMin = x;
-  tile->yMin = y;
-  tile->xMax = x + sliceW;
-  tile->yMax = y + sliceH;
-  tile->edges = 0;
-  if (tile->xMin == 0) {
-    tile->edges |= pdfCoreTileLeftEdge;
+  if (stats.nUnpackedTiles > 0) {
+    fprintf(f, "unpacked:    %d tiles, avg %.2f ms\n",
+	    stats.nUnpackedTiles, stats.unpackTime / stats.nUnpackedTiles);
   }
-  if (tile->xMax == page->w) {
-    tile->edges |= pdfCoreTileRightEdge;
+  fprintf(f, "buffers:     %d allocated, %d reused, %d mapped, "
+	  "high-water %.1f MB in use, %.1f MB pooled\n",
+	  bufPool->getNAllocs(), bufPool->getNReused(), bufPool->getNMapped(),
+	  bufPool->getMaxUsedBytes() / (1024 * 1024),
+	  bufPool->getMaxFreeBytes() / (1024 * 1024));
+  if (stats.nPaints == 0) {
+    fprintf(f, "no paints\n");
+    return;
   }
-  if (continuousMode) {
-    if (tile->yMin == 0) {
-      tile->edges |= pdfCoreTileTopSpace;
-      if (page->page == 1) {
-	tile->edges |= pdfCoreTileTopEdge;
-      }
-    }
-    if (tile->yMax == page->h) {
-      tile->edges |= pdfCoreTileBottomSpace;
-      if (page->page == doc->getNumPages()) {
-	tile->edges |= pdfCoreTileBottomEdge;
+  fprintf(f, "paints:      %d\n", stats.nPaints);
+  fprintf(f, "first paint: last %.1f ms, max %.1f ms, avg %.1f ms\n",
+	  stats.firstPaintLast, stats.firstPaintMax,
+	  stats.firstPaintTotal / stats.nPaints);
+  fprintf(f, "full paint:  last %.1f ms, max %.1f ms, avg %.1f ms\n",
+	  stats.fullPaintLast, stats.fullPaintMax,
+	  stats.fullPaintTotal / stats.nPaints);
+}
+
+// Rasterize a slice of <page> into <dev>, at the current rotation.
+// A single-image page is produced by scaling its image; if the page
+// has a display list, it is replayed; otherwise the page content is
+// interpreted as usual.
+void PDFCore::rasterizeSlice(CoreOutputDev *dev, PDFCorePage *page,
+			     double dpiA, int x, int y, int w, int h) {
+  ImagePage *imgPage;
+  DisplayList *list;
+  bool incrementalUpdate;
+
+  if (colorMode != splashModeMono1 && !dev->getReverseVideo() &&
+      (imgPage = getImagePage(page->page))) {
+    // the slice is produced all at once, so there is nothing to
+    // update incrementally
+    incrementalUpdate = dev->getIncrementalUpdate();
+    dev->setIncrementalUpdate(false);
+    imgPage->displaySlice(dev, doc->getCatalog()->getPage(page->page),
+			  dpiA, rotate, x, y, w, h);
+    dev->setIncrementalUpdate(incrementalUpdate);
+  } else if ((list = getDisplayList(page->page))) {
+    list->displaySlice(dev, doc->getCatalog()->getPage(page->page),
+		       dpiA, rotate, x, y, w, h);
+  } else {
+    doc->displayPageSlice(dev, page->page, dpiA, dpiA, rotate,
+			  false, true, false, x, y, w, h);
+  }
+}
+
+// Return the display list for page <pg>, recording it first if
+// needed.  Returns NULL if display lists are disabled, or if the page
+// can't be recorded (which is remembered, so it isn't tried again).
+DisplayList *PDFCore::getDisplayList(int pg) {
+  DisplayListOutputDev *recOut;
+  DisplayList *list;
+  size_t maxSize, totalSize, size;
+  int i;
+
+  if (!globalParamsGUI->getEnableDisplayLists()) {
+    return NULL;
+  }
+  for (i = 0; i < displayLists->getLength(); ++i) {
+    list = (DisplayList *)displayLists->get(i);
+    if (list->getPage() == pg) {
+      if (i > 0) {
+	displayLists->del(i);
+	displayLists->insert(0, list);
       }
+      return list->isOk() ? list : NULL;
     }
-  } else {
-    if (tile->yMin == 0) {
-      tile->edges |= pdfCoreTileTopEdge;
+  }
+
+  maxSize = (size_t)globalParamsGUI->getDisplayListCacheSize() << 20;
+  recOut = new DisplayListOutputDev(pg, maxSize);
+  doc->displayPage(recOut, pg, 72, 72, 0, false, true, false,
+		   &DisplayListOutputDev::abortCheckCbk, recOut);
+  list = recOut->takeDisplayList();
+  delete recOut;
+  displayLists->insert(0, list);
+
+  // drop the least recently used lists to stay under the memory cap
+  totalSize = list->getSize();
+  i = 1;
+  while (i < displayLists->getLength()) {
+    size = ((DisplayList *)displayLists->get(i))->getSize();
+    if (totalSize + size > maxSize) {
+      delete (DisplayList *)displayLists->del(i);
+    } else {
+      totalSize += size;
+      ++i;
     }
-    if (tile->yMax == page->h) {
-      tile->edges |= pdfCoreTileBottomEdge;
+  }
+
+  return list->isOk() ? list : NULL;
+}
+
+void PDFCore::clearDisplayLists() {
+  while (displayLists->getLength() > 0) {
+    delete (DisplayList *)displayLists->del(0);
+  }
+}
+
+// Return the decoded image for page <pg>, if it is a single-image
+// page (checking it first if needed).  Returns NULL otherwise; the
+// result of the check is remembered.
+ImagePage *PDFCore::getImagePage(int pg) {
+  ImagePageOutputDev *checkOut;
+  ImagePage *imgPage;
+  size_t maxSize, totalSize, size;
+  int i;
+
+  for (i = 0; i < imagePages->getLength(); ++i) {
+    imgPage = (ImagePage *)imagePages->get(i);
+    if (imgPage->getPage() == pg) {
+      if (i > 0) {
+	imagePages->del(i);
+	imagePages->insert(0, imgPage);
+      }
+      return imgPage->isOk() ? imgPage : NULL;
     }
   }
-  doc->displayPageSlice(out, page->page, dpi, dpi, rotate,
-			false, true, false, x, y, sliceW, sliceH);
-  tile->bitmap = out->takeBitmap();
-  memcpy(tile->ctm, out->getDefCTM(), 6 * sizeof(double));
-  memcpy(tile->ictm, out->getDefICTM(), 6 * sizeof(double));
-  if (!page->links) {
-    page->links = doc->getLinks(page->page);
+
+  if (!(maxSize = (size_t)globalParamsGUI->getImagePageCacheSize() << 20)) {
+    return NULL;
   }
-  if (!page->text) {
-    if ((textOut = new TextOutputDev(NULL, true, false, false))) {
-      doc->displayPage(textOut, page->page, dpi, dpi, rotate,
-		       false, true, false);
-      page->text = textOut->takeText();
-      delete textOut;
+  checkOut = new ImagePageOutputDev(pg, maxSize, imageCache);
+  doc->displayPage(checkOut, pg, 72, 72, 0, false, true, false,
+		   &ImagePageOutputDev::abortCheckCbk, checkOut);
+  imgPage = checkOut->takeImagePage();
+  delete checkOut;
+  imagePages->insert(0, imgPage);
+
+  // the check read the image through the image cache -- if the page
+  // qualified, the image is now held here, so the cached copy is
+  // dropped
+  if (imgPage->isOk() && imgPage->getImageRef().num >= 0) {
+    imageCache->remove(imgPage->getImageRef());
+  }
+
+  // drop the least recently used images to stay under the memory cap
+  totalSize = imgPage->getSize();
+  i = 1;
+  while (i < imagePages->getLength()) {
+    size = ((ImagePage *)imagePages->get(i))->getSize();
+    if (totalSize + size > maxSize) {
+      delete (ImagePage *)imagePages->del(i);
+    } else {
+      totalSize += size;
+      ++i;
     }
   }
-  page->tiles->append(tile);
-  curTile = NULL;
-  curPage = NULL;
 
-  setBusyCursor(false);
+  return imgPage->isOk() ? imgPage : NULL;
+}
+
+void PDFCore::clearImagePages() {
+  while (imagePages->getLength() > 0) {
+    delete (ImagePage *)imagePages->del(0);
+  }
+}
+
+// Compute the CTM for a tile that was not rasterized by Gfx.
+void PDFCore::setTileCTM(PDFCorePage *page, PDFCoreTile *tile) {
+  double *ctm, *ictm;
+  double det;
+
+  ctm = tile->ctm;
+  ictm = tile->ictm;
+  doc->getCatalog()->getPage(page->page)->getDefaultCTM(ctm, dpi, dpi,
+							rotate, false,
+							out->upsideDown());
+  ctm[4] -= tile->xMin;
+  ctm[5] -= tile->yMin;
+  det = 1 / (ctm[0] * ctm[3] - ctm[1] * ctm[2]);
+  ictm[0] = ctm[3] * det;
+  ictm[1] = -ctm[1] * det;
+  ictm[2] = -ctm[2] * det;
+  ictm[3] = ctm[0] * det;
+  ictm[4] = (ctm[2] * ctm[5] - ctm[3] * ctm[4]) * det;
+  ictm[5] = (ctm[1] * ctm[4] - ctm[0] * ctm[5]) * det;
 }
 
 bool PDFCore::gotoNextPage(int inc, bool top) {
@@ -892,12 +2944,11 @@ bool PDFCore::goForward() {
   }
   --historyFLen;
   ++historyBLen;
+  pg = history[historyCur].page;
   if (!doc || history[historyCur].fileName->cmp(doc->getFileName()) != 0) {
-    if (loadFile(history[historyCur].fileName) != errNone) {
-      return false;
-    }
+    loadFileAsync(history[historyCur].fileName, pg, NULL, NULL, false);
+    return true;
   }
-  pg = history[historyCur].page;
   update(pg, scrollX, continuousMode ? -1 : scrollY,
 	 zoom, rotate, false, false);
   return true;
@@ -914,30 +2965,33 @@ bool PDFCore::goBackward() {
   }
   --historyBLen;
   ++historyFLen;
+  pg = history[historyCur].page;
   if (!doc || history[historyCur].fileName->cmp(doc->getFileName()) != 0) {
-    if (loadFile(history[historyCur].fileName) != errNone) {
-      return false;
-    }
+    loadFileAsync(history[historyCur].fileName, pg, NULL, NULL, false);
+    return true;
   }
-  pg = history[historyCur].page;
   update(pg, scrollX, continuousMode ? -1 : scrollY,
 	 zoom, rotate, false, false);
   return true;
 }
 
 void PDFCore::scrollLeft(int nCols) {
+  startInteraction();
   scrollTo(scrollX - nCols, scrollY);
 }
 
 void PDFCore::scrollRight(int nCols) {
+  startInteraction();
   scrollTo(scrollX + nCols, scrollY);
 }
 
 void PDFCore::scrollUp(int nLines) {
+  startInteraction();
   scrollTo(scrollX, scrollY - nLines);
 }
 
 void PDFCore::scrollUpPrevPage(int nLines) {
+  startInteraction();
   if (!continuousMode && scrollY == 0) {
     gotoPrevPage(1, false, true);
   } else {
@@ -946,10 +3000,12 @@ void PDFCore::scrollUpPrevPage(int nLines) {
 }
 
 void PDFCore::scrollDown(int nLines) {
+  startInteraction();
   scrollTo(scrollX, scrollY + nLines);
 }
 
 void PDFCore::scrollDownNextPage(int nLines) {
+  startInteraction();
   if (!continuousMode &&
       scrollY >= ((PDFCorePage *)pages->get(0))->h - drawAreaHeight) {
     gotoNextPage(1, true);
@@ -1115,14 +3171,14 @@ void PDFCore::zoomCentered(double zoomA) {
       pageW = (rotate == 90 || rotate == 270) ? maxUnscaledPageH
 	                                      : maxUnscaledPageW;
     } else {
-      rot = rotate + doc->getPageRotate(topPage);
+      rot = rotate + getPageRotate(topPage);
       if (rot >= 360) {
 	rot -= 360;
       } else if (rot < 0) {
 	rot += 360;
       }
-      pageW = (rot == 90 || rot == 270) ? doc->getPageCropHeight(topPage)
-	                                : doc->getPageCropWidth(topPage);
+      pageW = (rot == 90 || rot == 270) ? getPageCropHeight(topPage)
+	                                : getPageCropWidth(topPage);
     }
     dpi1 = (72.0 * drawAreaWidth) / pageW;
     sx = 0;
@@ -1150,16 +3206,16 @@ void PDFCore::zoomCentered(double zoomA) {
     // we compute the pageY values at the new zoom level instead
     sy = 0;
     for (i = 1; i < topPage; ++i) {
-      rot = rotate + doc->getPageRotate(i);
+      rot = rotate + getPageRotate(i);
       if (rot >= 360) {
 	rot -= 360;
       } else if (rot < 0) {
 	rot += 360;
       }
       if (rot == 90 || rot == 270) {
-	sy += (int)((doc->getPageCropWidth(i) * dpi1) / 72 + 0.5);
+	sy += (int)((getPageCropWidth(i) * dpi1) / 72 + 0.5);
       } else {
-	sy += (int)((doc->getPageCropHeight(i) * dpi1) / 72 + 0.5);
+	sy += (int)((getPageCropHeight(i) * dpi1) / 72 + 0.5);
       }
     }
     vAdjust = (topPage - 1) * continuousModePageSpacing;
@@ -1181,31 +3237,31 @@ void PDFCore::zoomToCurrentWidth() {
   int sx, sy, vAdjust, rot, i;
 
   // compute the maximum page width of visible pages
-  rot = rotate + doc->getPageRotate(topPage);
+  rot = rotate + getPageRotate(topPage);
   if (rot >= 360) {
     rot -= 360;
   } else if (rot < 0) {
     rot += 360;
   }
   if (rot == 90 || rot == 270) {
-    maxW = doc->getPageCropHeight(topPage);
+    maxW = getPageCropHeight(topPage);
   } else {
-    maxW = doc->getPageCropWidth(topPage);
+    maxW = getPageCropWidth(topPage);
   }
   if (continuousMode) {
     for (i = topPage + 1;
 	 i < doc->getNumPages() && pageY[i-1] < scrollY + drawAreaHeight;
 	 ++i) {
-      rot = rotate + doc->getPageRotate(i);
+      rot = rotate + getPageRotate(i);
       if (rot >= 360) {
 	rot -= 360;
       } else if (rot < 0) {
 	rot += 360;
       }
       if (rot == 90 || rot == 270) {
-	w = doc->getPageCropHeight(i);
+	w = getPageCropHeight(i);
       } else {
-	w = doc->getPageCropWidth(i);
+	w = getPageCropWidth(i);
       }
       if (w > maxW) {
 	maxW = w;
@@ -1230,16 +3286,16 @@ void PDFCore::zoomToCurrentWidth() {
     // we compute the pageY values at the new zoom level instead
     sy = 0;
     for (i = 1; i < topPage; ++i) {
-      rot = rotate + doc->getPageRotate(i);
+      rot = rotate + getPageRotate(i);
       if (rot >= 360) {
 	rot -= 360;
       } else if (rot < 0) {
 	rot += 360;
       }
       if (rot == 90 || rot == 270) {
-	sy += (int)((doc->getPageCropWidth(i) * dpi1) / 72 + 0.5);
+	sy += (int)((getPageCropWidth(i) * dpi1) / 72 + 0.5);
       } else {
-	sy += (int)((doc->getPageCropHeight(i) * dpi1) / 72 + 0.5);
+	sy += (int)((getPageCropHeight(i) * dpi1) / 72 + 0.5);
       }
     }
     vAdjust = (topPage - 1) * continuousModePageSpacing;
@@ -1261,6 +3317,20 @@ void PDFCore::setContinuousMode(bool cm) {
   }
 }
 
+void PDFCore::startInteraction() {
+  if (globalParamsGUI->getInteractiveDraft()) {
+    interactive = true;
+  }
+}
+
+void PDFCore::endInteraction() {
+  if (!interactive) {
+    return;
+  }
+  interactive = false;
+  update(topPage, scrollX, scrollY, zoom, rotate, false, false);
+}
+
 void PDFCore::setSelection(int newSelectPage,
 			   int newSelectULX, int newSelectULY,
 			   int newSelectLRX, int newSelectLRY) {
@@ -1465,13 +3535,44 @@ void PDFCore::xorRectangle(int pg, int x0, int y0, int x1, int y1,
   PDFCorePage *page;
   PDFCoreTile *tile;
   SplashCoord xx0, yy0, xx1, yy1;
-  int xi, yi, wi, hi;
+  int xi, yi, wi, hi, tw, th;
   int i;
 
   if ((page = findPage(pg))) {
     for (i = 0; i < page->tiles->getLength(); ++i) {
       tile = (PDFCoreTile *)page->tiles->get(i);
       if (!oneTile || tile == oneTile) {
+	if (tile->bitmap) {
+	  tw = tile->bitmap->getWidth();
+	  th = tile->bitmap->getHeight();
+	} else {
+	  tw = tile->xMax - tile->xMin;
+	  th = tile->yMax - tile->yMin;
+	}
+	xi = x0 - tile->xMin;
+	wi = x1 - x0;
+	if (xi < 0) {
+	  wi += xi;
+	  xi = 0;
+	}
+	if (xi + wi > tw) {
+	  wi = tw - xi;
+	}
+	yi = y0 - tile->yMin;
+	hi = y1 - y0;
+	if (yi < 0) {
+	  hi += yi;
+	  yi = 0;
+	}
+	if (yi + hi > th) {
+	  hi = th - yi;
+	}
+	if (!tile->bitmap || tile->bitmap->getMode() != colorMode) {
+	  if (wi <= 0 || hi <= 0) {
+	    continue;
+	  }
+	  expandTile(tile, true);
+	}
 	splash = new Splash(tile->bitmap, false);
 	splash->setFillPattern(pattern->copy());
 	xx0 = x0 - tile->xMin;
@@ -1487,24 +3588,6 @@ void PDFCore::xorRectangle(int pg, int x0, int y0, int x1, int y1,
 	splash->xorFill(path, true);
 	delete path;
 	delete splash;
-	xi = x0 - tile->xMin;
-	wi = x1 - x0;
-	if (xi < 0) {
-	  wi += xi;
-	  xi = 0;
-	}
-	if (xi + wi > tile->bitmap->getWidth()) {
-	  wi = tile->bitmap->getWidth() - xi;
-	}
-	yi = y0 - tile->yMin;
-	hi = y1 - y0;
-	if (yi < 0) {
-	  hi += yi;
-	  yi = 0;
-	}
-	if (yi + hi > tile->bitmap->getHeight()) {
-	  hi = tile->bitmap->getHeight() - yi;
-	}
 	updateTileData(tile, xi, yi, wi, hi, true);
       }
     }
@@ -1833,9 +3916,46 @@ void PDFCore::cvtDevToUser(int pg, int xd, int yd, double *xu, double *yu) {
   }
 }
 
-void PDFCore::setReverseVideo(bool reverseVideoA) {
-  out->setReverseVideo(reverseVideoA);
-  update(topPage, scrollX, scrollY, zoom, rotate, true, false);
+// Reverse video and the paper color only change the way tiles are
+// converted for display, so the existing tiles are converted again,
+// but not rasterized again.
+void PDFCore::setReverseVideo(bool reverseVideoA,
+			      SplashColorPtr paperColorA) {
+  PDFCorePage *page;
+  PDFCoreTile *tile;
+  int i, j;
+
+  reverseVideo = reverseVideoA;
+  splashColorCopy(paperColor, paperColorA);
+  updateDisplayLUT();
+  for (i = 0; i < pages->getLength(); ++i) {
+    page = (PDFCorePage *)pages->get(i);
+    for (j = 0; j < page->tiles->getLength(); ++j) {
+      tile = (PDFCoreTile *)page->tiles->get(j);
+      if (tile->bitmap || tile->solid) {
+	updateTileData(tile, 0, 0, tile->xMax - tile->xMin,
+		       tile->yMax - tile->yMin, true);
+      }
+    }
+  }
+  redrawWindow(0, 0, drawAreaWidth, drawAreaHeight, false);
+}
+
+// Build the display transform: white (the rasterization paper color)
+// maps to the paper color, and black maps to black -- or to white, in
+// reverse video -- with the values in between interpolated.  With
+// reverse video and black paper, this simply inverts each component.
+void PDFCore::updateDisplayLUT() {
+  int ink, paper, i, c;
+
+  for (i = 0; i < 3; ++i) {
+    ink = reverseVideo ? 0xff : 0x00;
+    paper = colorMode == splashModeMono1 || colorMode == splashModeMono8
+              ? paperColor[0] : paperColor[i];
+    for (c = 0; c < 256; ++c) {
+      displayLUT[i][c] = (Guchar)(ink + ((paper - ink) * c) / 255);
+    }
+  }
 }
 
 LinkAction *PDFCore::findLink(int pg, double x, double y) {
@@ -1892,7 +4012,7 @@ void PDFCore::redrawWindow(int x, int y, int width, int height,
 			   bool needUpdate) {
   PDFCorePage *page;
   PDFCoreTile *tile;
-  int xDest, yDest, w, i, j;
+  int xDest, yDest, w, h, i, j;
 
   if (pages->getLength() == 0) {
     redrawRect(NULL, 0, 0, x, y, width, height, true);
@@ -1964,8 +4084,14 @@ void PDFCore::redrawWindow(int x, int y, int width, int height,
 			  drawAreaWidth - xDest, tile->yMax - tile->yMin,
 			  x, y, width, height, false);
       }
-      clippedRedrawRect(tile, 0, 0, tile->xDest, tile->yDest,
-			tile->bitmap->getWidth(), tile->bitmap->getHeight(),
+      if (tile->bitmap) {
+	w = tile->bitmap->getWidth();
+	h = tile->bitmap->getHeight();
+      } else {
+	w = tile->xMax - tile->xMin;
+	h = tile->yMax - tile->yMin;
+      }
+      clippedRedrawRect(tile, 0, 0, tile->xDest, tile->yDest, w, h,
 			x, y, width, height, needUpdate);
     }
   }
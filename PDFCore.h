@@ -15,6 +15,7 @@
 #pragma interface
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include "poppler/splash/SplashTypes.h"
 #include "poppler/CharTypes.h"
@@ -30,7 +31,19 @@ class LinkDest;
 class LinkAction;
 class TextPage;
 class HighlightFile;
+class SplashOutputDev;
 class CoreOutputDev;
+class CoreImageCache;
+class CoreFormCache;
+class DisplayList;
+class ImagePage;
+class TileDiskCache;
+class DocInfoCache;
+class PageFingerprints;
+class BufferPool;
+class WorkerPool;
+class ProgressiveFile;
+class DocLoader;
 class PDFCore;
 
 //------------------------------------------------------------------------
@@ -50,6 +63,45 @@ class PDFCore;
 // Number of pixels of matte color between pages in continuous mode.
 #define continuousModePageSpacing 3
 
+// Resolution of the low-res page previews, and the max number of
+// previews kept around.
+#define pdfCorePreviewDPI  36
+#define pdfCoreMaxPreviews 32
+
+// Resolution divisor for the quick draft that is put up when a page
+// is first displayed.
+#define pdfCoreDraftScale 3
+
+// Gray level of the placeholder tiles shown for pages whose data
+// hasn't arrived yet.
+#define pdfCorePlaceholderGray 0xd0
+
+// Only documents with at least this many pages have their page
+// geometry cached on disk.
+#define pdfCoreDocInfoMinPages 64
+
+// When a document is reloaded, an unchanged page is looked for up to
+// this many pages before and after its old position.
+#define pdfCoreReloadSearchPages 8
+
+// Error code passed to loadFileDone if an open started by
+// loadFileAsync was cancelled.
+#define pdfCoreErrCancelled 100
+
+//------------------------------------------------------------------------
+// PDFCorePageGeom
+//------------------------------------------------------------------------
+
+// Geometry of one page, read when the document is loaded, so laying
+// out the pages doesn't need to go back to the Page objects.
+struct PDFCorePageGeom {
+  double cropW, cropH;		// crop box size, in points
+  int rotate;			// page rotation, in degrees
+  bool placeholder;		// set if the page's data hasn't arrived
+				//   yet -- the size and rotation are
+				//   then copied from the first page
+};
+
 //------------------------------------------------------------------------
 // PDFCorePage
 //------------------------------------------------------------------------
@@ -83,10 +135,22 @@ public:
   int xMin, yMin, xMax, yMax;
   int xDest, yDest;
   unsigned edges;
-  SplashBitmap *bitmap;
+  SplashBitmap *bitmap;		// in splashModeMono8 or splashModeMono1
+				//   if the tile has no chroma
   double ctm[6];		// coordinate transform matrix:
 				//   default user space -> device space
   double ictm[6];		// inverse CTM
+  bool preview;			// set if bitmap is a scaled stand-in,
+				//   waiting to be rasterized
+  bool draft;			// set if bitmap was rasterized in draft
+				//   quality, during scrolling/zooming
+  bool solid;			// set if every pixel of the tile is
+				//   <solidColor> -- <bitmap> is then NULL
+  SplashColor solidColor;
+  Guchar *packedData;		// compressed bitmap, for a tile that
+				//   isn't visible -- <bitmap> is then NULL
+  int packedLen;		// length of <packedData>, in bytes
+  SplashColorMode packedMode;	// color mode of the packed bitmap
 };
 
 #define pdfCoreTileTopEdge      0x01
@@ -96,6 +160,78 @@ public:
 #define pdfCoreTileTopSpace     0x10
 #define pdfCoreTileBottomSpace  0x20
 
+//------------------------------------------------------------------------
+// PDFCorePreview
+//------------------------------------------------------------------------
+
+// Low-resolution rendering of (part of) a page: either a reduced copy
+// of the whole page, filled in from the real tiles as they are
+// rasterized, or a quick draft of the area that was visible when the
+// page was first displayed.
+class PDFCorePreview {
+public:
+
+  PDFCorePreview(int pageA, int rotateA, double dpiA, int xMinA, int yMinA,
+		 SplashBitmap *bitmapA);
+  ~PDFCorePreview();
+
+  int page;
+  int rotate;			// rotation used for this preview
+  double dpi;			// resolution of the preview bitmap
+  int xMin, yMin;		// upper-left corner of the bitmap, in
+				//   device space at <dpi>
+  SplashBitmap *bitmap;
+};
+
+//------------------------------------------------------------------------
+// PDFCoreCachedTile
+//------------------------------------------------------------------------
+
+// A tile that has been dropped from the display (scrolled away, or
+// left behind by a page or zoom change), kept in compressed form so
+// it can be reused without rasterizing it again.
+class PDFCoreCachedTile {
+public:
+
+  PDFCoreCachedTile(int pageA, double dpiA, int rotateA,
+		    PDFCoreTile *tileA);
+  ~PDFCoreCachedTile();
+
+  int page;
+  double dpi;			// resolution the tile was rasterized at
+  int rotate;			// rotation the tile was rasterized at
+  PDFCoreTile *tile;		// the tile (packed or solid)
+  int size;			// approximate memory used, in bytes
+};
+
+//------------------------------------------------------------------------
+// PDFCoreStats
+//------------------------------------------------------------------------
+
+// Paint timings, in milliseconds, for the updates that had to fill an
+// empty part of the window.  "First paint" is the time until something
+// (a draft or a finished tile) covered the empty area; "full paint" is
+// the time until all of the tiles were rasterized.  Also counts the
+// rasterized tiles that turned out to be a single color, and the
+// tiles that were compressed while they weren't visible.
+struct PDFCoreStats {
+  int nPaints;
+  double firstPaintLast, firstPaintMax, firstPaintTotal;
+  double fullPaintLast, fullPaintMax, fullPaintTotal;
+  int nTiles;			// tiles rasterized
+  int nSolidTiles;		// ... of which were stored as a single color
+  int nGrayTiles;		// ... or as 8-bit gray
+  int nMonoTiles;		// ... or as 1-bit monochrome
+  int nCachedTiles;		// tiles taken from the tile cache
+  int nDiskTiles;		// tiles read from the on-disk tile cache
+  int nRotatedTiles;		// tiles made by rotating old tiles
+  int nPackedTiles;		// tiles compressed
+  double packRawBytes,		// total size of the compressed tiles,
+         packBytes;		//   before and after compression
+  int nUnpackedTiles;		// tiles decompressed
+  double unpackTime;		// total decompression time, in ms
+};
+
 //------------------------------------------------------------------------
 // PDFHistory
 //------------------------------------------------------------------------
@@ -122,10 +258,26 @@ public:
 
   //----- loadFile / displayPage / displayDest
 
-  // Load a new file.  Returns pdfOk or error code.
+  // Load a new file, waiting for it to be opened.  Returns pdfOk or
+  // error code.
   virtual int loadFile(GooString *fileName, GooString *ownerPassword = NULL,
 		       GooString *userPassword = NULL);
 
+  // Start loading a new file, and return without waiting for it.  The
+  // file is opened on a separate thread (see docLoaderStarted), and the
+  // current document stays up until the new one is ready.  Then
+  // loadFileDone is called, and the new document is displayed at
+  // <dest>, or at the named destination <destName>, or else at page
+  // <pg>; <addToHist> is passed on to displayDest/displayPage.  Takes
+  // ownership of <dest> and <destName>.  An open that is already in
+  // progress is cancelled.
+  void loadFileAsync(GooString *fileName, int pg, LinkDest *dest,
+		     GooString *destName, bool addToHist);
+
+  // Cancel the open started by loadFileAsync, if any, leaving the
+  // current document in place.
+  virtual void cancelLoadFile();
+
   // Load a new file, via a Stream instead of a file name.  Returns
   // pdfOk or error code.
   virtual int loadFile(BaseStream *stream, GooString *ownerPassword = NULL,
@@ -134,6 +286,15 @@ public:
   // Load an already-created PDFDoc object.
   virtual void loadDoc(PDFDoc *docA);
 
+  // Returns true if the current document is still arriving (see
+  // ProgressiveFile).
+  bool isLoadingProgressively() { return progFile != NULL; }
+
+  // Read any newly arrived data for a document that is still
+  // arriving, and display the pages that are now complete.  This
+  // should be called periodically as long as it returns true.
+  bool updateProgressiveLoad();
+
   // Clear out the current document, if any.
   virtual void clear();
 
@@ -184,6 +345,16 @@ public:
   virtual void zoomToCurrentWidth();
   virtual void setContinuousMode(bool cm);
 
+  //----- interactive rendering
+
+  // Called on each scroll or zoom input event.  Until endInteraction()
+  // is called, new tiles are rasterized in draft quality.
+  virtual void startInteraction();
+
+  // Called once input has been idle for a while: re-rasterizes the
+  // draft tiles at full quality.
+  virtual void endInteraction();
+
   //----- selection
 
   // Current selected region.
@@ -222,12 +393,18 @@ public:
   //----- misc access
 
   PDFDoc *getDoc() { return doc; }
+  double getPageCropWidth(int pg) { return pageGeom[pg-1].cropW; }
+  double getPageCropHeight(int pg) { return pageGeom[pg-1].cropH; }
+  int getPageRotate(int pg) { return pageGeom[pg-1].rotate; }
   int getPageNum() { return topPage; }
   double getZoom() { return zoom; }
   double getZoomDPI() { return dpi; }
   int getRotate() { return rotate; }
   bool getContinuousMode() { return continuousMode; }
-  virtual void setReverseVideo(bool reverseVideoA);
+  virtual void setReverseVideo(bool reverseVideoA,
+			       SplashColorPtr paperColorA);
+  bool getReverseVideo() { return reverseVideo; }
+  SplashColorPtr getPaperColor() { return paperColor; }
   bool canGoBack() { return historyBLen > 1; }
   bool canGoForward() { return historyFLen > 0; }
   int getScrollX() { return scrollX; }
@@ -237,11 +414,64 @@ public:
   virtual void setBusyCursor(bool busy) = 0;
   LinkAction *findLink(int pg, double x, double y);
 
+  //----- statistics
+
+  PDFCoreStats *getStats() { return &stats; }
+  void printStats(FILE *f);
+
 protected:
 
-  int loadFile2(PDFDoc *newDoc);
+  int loadFile2(PDFDoc *newDoc, ProgressiveFile *progFileA = NULL);
+  virtual void docLoaderStarted();
+  void finishLoadFile();
+  virtual void loadFileDone(int err) {}
+  void clearLoadTarget();
+  void readPageGeom(int pg);
+  void readAllPageGeom(GooString *path);
+  void remapReloadedPages(PageFingerprints *oldFingerprints, int oldNPages);
+  int findReloadedPage(int oldPg, PageFingerprints *oldFingerprints,
+		       int oldNPages, int *pageMap, char *taken);
+  void setMaxPageSize();
+  bool updatePageGeom(bool *relayout);
   void addPage(int pg, int rot);
+  PDFCoreTile *makeTile(PDFCorePage *page, int x, int y);
+  PDFCoreTile *findTile(PDFCorePage *page, int x, int y);
+  void setColorMode(SplashColorMode colorModeA);
+  void makeOutputDevs(bool incrementalUpdate);
+  void updateDisplayLUT();
   void needTile(PDFCorePage *page, int x, int y);
+  void makePlaceholderTile(PDFCorePage *page, int x, int y);
+  void needLinksAndText(PDFCorePage *page);
+  void drawDraftTile(PDFCorePage *page, PDFCoreTile *tile);
+  SplashBitmap *makePaperBitmap(int w, int h);
+  void compactTile(PDFCoreTile *tile);
+  void packTile(PDFCoreTile *tile);
+  SplashBitmap *decodeTile(PDFCoreTile *tile);
+  void expandTile(PDFCoreTile *tile, bool fullColor);
+  void packHiddenTiles();
+  void discardTile(int pg, double dpiA, int rotateA, PDFCoreTile *tile);
+  void discardPage(PDFCorePage *page, double dpiA, int rotateA);
+  PDFCoreTile *takeCachedTile(PDFCorePage *page, int x, int y);
+  void clearTileCache();
+  GooString *makeDiskTileKey(PDFCorePage *page, PDFCoreTile *tile);
+  bool loadDiskTile(PDFCorePage *page, PDFCoreTile *tile);
+  void storeDiskTile(PDFCorePage *page, PDFCoreTile *tile);
+  bool makePreviewTile(PDFCorePage *page, int x, int y,
+		       GooList *oldPages, double oldDPI);
+  bool makeRotatedTile(PDFCorePage *page, int x, int y,
+		       GooList *oldPages, int oldRotate);
+  PDFCorePreview *makeDraftPreview(PDFCorePage *page);
+  void updatePreview(PDFCorePage *page, PDFCoreTile *tile);
+  PDFCorePreview *findPreview(int pg);
+  void clearPreviews();
+  void setTileCTM(PDFCorePage *page, PDFCoreTile *tile);
+  void rasterizeSlice(CoreOutputDev *dev, PDFCorePage *page, double dpiA,
+		      int x, int y, int w, int h);
+  DisplayList *getDisplayList(int pg);
+  ImagePage *getImagePage(int pg);
+  void clearDisplayLists();
+  void clearImagePages();
+  void recordPaintTime(double t0, bool first);
   void xorRectangle(int pg, int x0, int y0, int x1, int y1,
 		    SplashPattern *pattern, PDFCoreTile *oneTile = NULL);
   int loadHighlightFile(HighlightFile *hf, SplashColorPtr color,
@@ -254,6 +484,7 @@ protected:
   virtual PDFCoreTile *newTile(int xDestA, int yDestA);
   virtual void updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
 			      int width, int height, bool composited);
+  virtual bool canFillTile(SplashColorPtr color) { return true; }
   virtual void redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
 			  int xDest, int yDest, int width, int height,
 			  bool composited) = 0;
@@ -264,7 +495,29 @@ protected:
   virtual void updateScrollbars() = 0;
   virtual bool checkForNewFile() { return false; }
 
+  // Returns true if changes to the PDF file are watched for, in which
+  // case the displayed pages are fingerprinted, so that their tiles
+  // can be kept when the file is reloaded.
+  virtual bool wantPageFingerprints() { return false; }
+
+  // Fingerprint one of the displayed pages that hasn't been
+  // fingerprinted yet.  Returns true if there are more.  The GUI calls
+  // this when it is idle, and drops the pending pages when the file
+  // changes.
+  bool fingerprintNextPage();
+  bool hasPendingFingerprints();
+  void dropPendingFingerprints();
+
   PDFDoc *doc;			// current PDF file
+  PDFCorePageGeom *pageGeom;	// geometry of each page of <doc>
+  ProgressiveFile *progFile;	// source of <doc>, if it's still
+				//   arriving (owned by <doc>'s stream)
+  DocLoader *docLoader;		// set while loadFileAsync is opening a
+				//   file
+  int loadPage;			// where to display the file being opened
+  LinkDest *loadDest;		//   by loadFileAsync
+  GooString *loadDestName;
+  bool loadAddToHist;
   bool continuousMode;		// false for single-page mode, true for
 				//   continuous mode
   int drawAreaWidth,		// size of the PDF display area
@@ -283,6 +536,7 @@ protected:
   double zoom;			// current zoom level, in percent of 72 dpi
   double dpi;			// current zoom level, in DPI
   int rotate;			// current page rotation
+  bool interactive;		// set while scroll/zoom input is active
 
   int selectPage;		// page number of current selection
   int selectULX,		// coordinates of current selection,
@@ -305,9 +559,47 @@ protected:
   GooList *pages;			// cached pages [PDFCorePage]
   PDFCoreTile *curTile;		// tile currently being rasterized
   PDFCorePage *curPage;		// page to which curTile belongs
-
+  GooList *previews;		// low-res page previews [PDFCorePreview],
+				//   most recently used first
+  GooList *displayLists;	// recorded pages [DisplayList], most
+				//   recently used first
+  GooList *imagePages;		// single-image pages [ImagePage], most
+				//   recently used first
+  GooList *tileCache;		// tiles dropped from the display
+				//   [PDFCoreCachedTile], most recently
+				//   used first
+  int tileCacheBytes;		// total size of the tiles in <tileCache>
+  TileDiskCache *diskCache;	// on-disk tile cache (NULL if disabled)
+  DocInfoCache *docInfoCache;	// on-disk page geometry cache (NULL if
+				//   disabled)
+  BufferPool *bufPool;		// recycled pixel buffers (XImage data,
+				//   compression buffers)
+  WorkerPool *workers;		// threads for splitting up per-tile work
+  GooString *docKey;		// identity of the current file, for
+				//   <diskCache> (NULL if the document
+				//   isn't a file)
+  PageFingerprints *fingerprints;	// content hashes of the displayed
+				//   pages, for reloads (NULL if the
+				//   document isn't a file, or changes
+				//   to it aren't watched for)
+
+  SplashColorMode colorMode;
+  int bitmapRowPad;
+  bool reverseVideo;
   SplashColor paperColor;
+  Guchar displayLUT[3][256];	// maps rasterized color components to
+				//   displayed ones -- tiles are always
+				//   rasterized on white paper, in normal
+				//   video
   CoreOutputDev *out;
+  CoreOutputDev *draftOut;	// non-anti-aliased output device for
+				//   first-paint drafts
+  CoreImageCache *imageCache;	// decoded images, shared by <out> and
+				//   <draftOut>
+  CoreFormCache *formCache;	// rasterized forms, shared by <out> and
+				//   <draftOut>
+
+  PDFCoreStats stats;
 
   friend class PDFCoreTile;
 };
@@ -0,0 +1,521 @@
+//========================================================================
+//
+// PageFingerprints.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "poppler/goo/gmem.h"
+#include "poppler/goo/GooString.h"
+#include "poppler/Object.h"
+#include "poppler/Stream.h"
+#include "poppler/XRef.h"
+#include "poppler/Catalog.h"
+#include "poppler/Page.h"
+#include "poppler/PDFDoc.h"
+#include "PageFingerprints.h"
+
+//------------------------------------------------------------------------
+
+// 64-bit FNV-1a.
+#define fnvBasis 14695981039346656037ULL
+#define fnvPrime 1099511628211ULL
+
+// Max chain of indirect references followed from a page.  A page that
+// goes deeper than this isn't fingerprinted.
+#define pageFingerprintMaxDepth 100
+
+// Number of bytes at the end of the file searched for "startxref".
+#define pageFingerprintTailSize 1024
+
+#define pageHashUnknown 0
+#define pageHashDone    1
+#define pageHashFailed  2
+
+#define objHashUnknown 0
+#define objHashBusy    1
+#define objHashDone    2
+
+struct PageFingerprintObj {
+  int state;			// objHashUnknown/Busy/Done
+  int gen;
+  int depth;			// reference depth, while <state> is
+				//   objHashBusy
+  long long offset;		// file offset, or -1 if the object is
+				//   in an object stream
+  unsigned long long hash;
+  int *children;		// numbers of the indirect objects this
+				//   object refers to
+  int nChildren, childrenSize;
+};
+
+static void hashBytes(unsigned long long *h, const void *p, int n) {
+  const unsigned char *s = (const unsigned char *)p;
+  unsigned long long x;
+  int i;
+
+  x = *h;
+  for (i = 0; i < n; ++i) {
+    x ^= s[i];
+    x *= fnvPrime;
+  }
+  *h = x;
+}
+
+static void hashChar(unsigned long long *h, char c) {
+  hashBytes(h, &c, 1);
+}
+
+static void hashInt(unsigned long long *h, int x) {
+  hashBytes(h, &x, sizeof(int));
+}
+
+static void hashDouble(unsigned long long *h, double x) {
+  hashBytes(h, &x, sizeof(double));
+}
+
+static void hashName(unsigned long long *h, const char *s) {
+  hashBytes(h, s, strlen(s) + 1);
+}
+
+//------------------------------------------------------------------------
+// PageFingerprints
+//------------------------------------------------------------------------
+
+PageFingerprints::PageFingerprints(PDFDoc *docA) {
+  doc = docA;
+  nPages = doc->getNumPages();
+  pageHashes = (unsigned long long *)gmallocn(nPages,
+					     sizeof(unsigned long long));
+  pageState = (char *)gmalloc(nPages);
+  memset(pageState, pageHashUnknown, nPages);
+  requests = NULL;
+  nRequests = requestsSize = 0;
+  requestsDropped = false;
+  nObjs = doc->getXRef()->getNumObjects();
+  objs = (PageFingerprintObj *)gmallocn(nObjs, sizeof(PageFingerprintObj));
+  memset(objs, 0, nObjs * sizeof(PageFingerprintObj));
+  curObj = -1;
+  cycleDepth = INT_MAX;
+  startXRef = readStartXRef();
+}
+
+PageFingerprints::~PageFingerprints() {
+  int i;
+
+  for (i = 0; i < nObjs; ++i) {
+    gfree(objs[i].children);
+  }
+  gfree(objs);
+  gfree(pageHashes);
+  gfree(pageState);
+  gfree(requests);
+}
+
+void PageFingerprints::inheritFrom(PageFingerprints *old) {
+  PageFingerprintObj *obj, *oldObj;
+  XRefEntry *entry;
+  bool changed;
+  int n, i, j;
+
+  if (!isUpdateOf(old)) {
+    return;
+  }
+
+  // take the hashes of the objects whose xref entries are the same --
+  // i.e., the ones the update didn't replace
+  n = nObjs < old->nObjs ? nObjs : old->nObjs;
+  for (i = 0; i < n; ++i) {
+    oldObj = &old->objs[i];
+    if (oldObj->state != objHashDone || oldObj->offset < 0) {
+      continue;
+    }
+    entry = doc->getXRef()->getEntry(i);
+    if (entry->type != xrefEntryUncompressed ||
+	entry->gen != oldObj->gen ||
+	(long long)entry->offset != oldObj->offset) {
+      continue;
+    }
+    obj = &objs[i];
+    *obj = *oldObj;
+    obj->children = (int *)gmallocn(oldObj->nChildren, sizeof(int));
+    memcpy(obj->children, oldObj->children, oldObj->nChildren * sizeof(int));
+    obj->childrenSize = oldObj->nChildren;
+  }
+
+  // then drop the ones that lead to a replaced object -- their hashes
+  // include its old contents
+  do {
+    changed = false;
+    for (i = 0; i < nObjs; ++i) {
+      obj = &objs[i];
+      if (obj->state != objHashDone) {
+	continue;
+      }
+      for (j = 0; j < obj->nChildren; ++j) {
+	if (obj->children[j] < 0 || obj->children[j] >= nObjs ||
+	    objs[obj->children[j]].state != objHashDone) {
+	  break;
+	}
+      }
+      if (j < obj->nChildren) {
+	obj->state = objHashUnknown;
+	obj->nChildren = 0;
+	changed = true;
+      }
+    }
+  } while (changed);
+}
+
+bool PageFingerprints::getFingerprint(int pg, unsigned long long *fp) {
+  if (pg < 1 || pg > nPages) {
+    return false;
+  }
+  if (pageState[pg-1] == pageHashUnknown) {
+    hashPage(pg);
+  }
+  if (pageState[pg-1] != pageHashDone) {
+    return false;
+  }
+  *fp = pageHashes[pg-1];
+  return true;
+}
+
+bool PageFingerprints::isComputed(int pg) {
+  return pg >= 1 && pg <= nPages && pageState[pg-1] != pageHashUnknown;
+}
+
+void PageFingerprints::request(int pg) {
+  int i;
+
+  if (requestsDropped || pg < 1 || pg > nPages ||
+      pageState[pg-1] != pageHashUnknown) {
+    return;
+  }
+  for (i = 0; i < nRequests; ++i) {
+    if (requests[i] == pg) {
+      return;
+    }
+  }
+  if (nRequests == requestsSize) {
+    requestsSize = requestsSize ? 2 * requestsSize : 16;
+    requests = (int *)greallocn(requests, requestsSize, sizeof(int));
+  }
+  requests[nRequests++] = pg;
+}
+
+bool PageFingerprints::computeNext() {
+  int pg;
+
+  if (nRequests > 0) {
+    pg = requests[--nRequests];
+    if (pageState[pg-1] == pageHashUnknown) {
+      hashPage(pg);
+    }
+  }
+  return nRequests > 0;
+}
+
+void PageFingerprints::hashPage(int pg) {
+  Catalog *catalog;
+  XRef *xref;
+  Page *page;
+  Ref *pageRef;
+  PDFRectangle *box;
+  Object pageObj, rootObj, obj;
+  Dict *resDict;
+  unsigned long long h;
+
+  catalog = doc->getCatalog();
+  xref = doc->getXRef();
+  if (!(page = catalog->getPage(pg)) ||
+      !(pageRef = catalog->getPageRef(pg))) {
+    pageState[pg-1] = pageHashFailed;
+    return;
+  }
+  h = fnvBasis;
+  curObj = -1;
+  cycleDepth = INT_MAX;
+
+  box = page->getMediaBox();
+  hashDouble(&h, box->x1);
+  hashDouble(&h, box->y1);
+  hashDouble(&h, box->x2);
+  hashDouble(&h, box->y2);
+  box = page->getCropBox();
+  hashDouble(&h, box->x1);
+  hashDouble(&h, box->y1);
+  hashDouble(&h, box->x2);
+  hashDouble(&h, box->y2);
+  hashInt(&h, page->getRotate());
+
+  // the parts of the page dictionary that affect what is drawn
+  xref->fetch(pageRef->num, pageRef->gen, &pageObj);
+  if (pageObj.isDict()) {
+    pageObj.dictLookupNF("Contents", &obj);
+    hashObj(&h, &obj, 0);
+    obj.free();
+    pageObj.dictLookupNF("Annots", &obj);
+    hashObj(&h, &obj, 0);
+    obj.free();
+    pageObj.dictLookupNF("Group", &obj);
+    hashObj(&h, &obj, 0);
+    obj.free();
+  }
+  pageObj.free();
+
+  // the resources may be inherited from the page tree
+  if ((resDict = page->getResourceDict())) {
+    hashDict(&h, resDict, 0);
+  } else {
+    hashChar(&h, 'n');
+  }
+
+  // optional content visibility applies to every page
+  xref->fetch(xref->getRootNum(), xref->getRootGen(), &rootObj);
+  if (rootObj.isDict()) {
+    rootObj.dictLookupNF("OCProperties", &obj);
+    hashObj(&h, &obj, 0);
+    obj.free();
+  }
+  rootObj.free();
+
+  if (cycleDepth < 0) {
+    pageState[pg-1] = pageHashFailed;
+  } else {
+    pageHashes[pg-1] = h;
+    pageState[pg-1] = pageHashDone;
+  }
+}
+
+// Return the hash of indirect object <num>/<gen>, which is <depth>
+// references away from the page.  The result is remembered, unless it
+// depends on an object further up the chain (i.e., there is a cycle
+// above this object), since then it also depends on where the chain
+// started.
+unsigned long long PageFingerprints::hashRef(int num, int gen, int depth) {
+  PageFingerprintObj *obj;
+  XRefEntry *entry;
+  Object fetched;
+  unsigned long long h;
+  int savedObj, savedCycleDepth;
+
+  h = fnvBasis;
+  if (depth > pageFingerprintMaxDepth) {
+    cycleDepth = -1;
+    return h;
+  }
+  if (num < 0 || num >= nObjs) {
+    hashChar(&h, 'x');
+    return h;
+  }
+  obj = &objs[num];
+  if (obj->state == objHashBusy) {
+    if (obj->depth < cycleDepth) {
+      cycleDepth = obj->depth;
+    }
+    hashChar(&h, 'c');
+    return h;
+  }
+  if (obj->state == objHashDone && obj->gen == gen) {
+    return obj->hash;
+  }
+
+  obj->state = objHashBusy;
+  obj->gen = gen;
+  obj->depth = depth;
+  obj->nChildren = 0;
+  entry = doc->getXRef()->getEntry(num);
+  obj->offset = entry->type == xrefEntryUncompressed ? (long long)entry->offset
+                                                     : -1;
+  savedObj = curObj;
+  savedCycleDepth = cycleDepth;
+  curObj = num;
+  cycleDepth = INT_MAX;
+
+  doc->getXRef()->fetch(num, gen, &fetched);
+  if (fetched.isDict("Page")) {
+    // link destinations point to pages -- where a link goes doesn't
+    // change what is drawn, and following the reference would pull
+    // in the whole document
+    hashChar(&h, 'p');
+  } else {
+    hashObj(&h, &fetched, depth);
+  }
+  fetched.free();
+
+  curObj = savedObj;
+  if (cycleDepth >= depth) {
+    obj->state = objHashDone;
+    obj->hash = h;
+    cycleDepth = savedCycleDepth;
+  } else {
+    obj->state = objHashUnknown;
+    if (savedCycleDepth < cycleDepth) {
+      cycleDepth = savedCycleDepth;
+    }
+  }
+  return h;
+}
+
+void PageFingerprints::hashObj(unsigned long long *h, Object *obj,
+			       int depth) {
+  Object obj2;
+  GooString *s;
+  unsigned long long h2;
+  int i;
+
+  hashChar(h, (char)obj->getType());
+  switch (obj->getType()) {
+  case objBool:
+    hashInt(h, obj->getBool());
+    break;
+  case objInt:
+    hashInt(h, obj->getInt());
+    break;
+  case objReal:
+    hashDouble(h, obj->getReal());
+    break;
+  case objString:
+    s = obj->getString();
+    hashInt(h, s->getLength());
+    hashBytes(h, s->getCString(), s->getLength());
+    break;
+  case objName:
+    hashName(h, obj->getName());
+    break;
+  case objArray:
+    hashInt(h, obj->arrayGetLength());
+    for (i = 0; i < obj->arrayGetLength(); ++i) {
+      obj->arrayGetNF(i, &obj2);
+      hashObj(h, &obj2, depth);
+      obj2.free();
+    }
+    break;
+  case objDict:
+    hashDict(h, obj->getDict(), depth);
+    break;
+  case objStream:
+    hashDict(h, obj->streamGetDict(), depth);
+    hashStreamData(h, obj->getStream());
+    break;
+  case objRef:
+    addChild(obj->getRefNum());
+    h2 = hashRef(obj->getRefNum(), obj->getRefGen(), depth + 1);
+    hashBytes(h, &h2, sizeof(h2));
+    break;
+  default:
+    break;
+  }
+}
+
+void PageFingerprints::hashDict(unsigned long long *h, Dict *dict,
+				int depth) {
+  Object obj;
+  char *key;
+  int i;
+
+  hashInt(h, dict->getLength());
+  for (i = 0; i < dict->getLength(); ++i) {
+    key = dict->getKey(i);
+    // back references (to a parent annotation or form field, or to
+    // the page) don't affect what is drawn
+    if (!strcmp(key, "Parent") || !strcmp(key, "P")) {
+      continue;
+    }
+    hashName(h, key);
+    dict->getValNF(i, &obj);
+    hashObj(h, &obj, depth);
+    obj.free();
+  }
+}
+
+// Hash the raw (still encoded) data of <str>.
+void PageFingerprints::hashStreamData(unsigned long long *h, Stream *str) {
+  Guchar buf[4096];
+  int n;
+
+  str = str->getUndecodedStream();
+  str->reset();
+  while ((n = str->doGetChars((int)sizeof(buf), buf)) > 0) {
+    hashBytes(h, buf, n);
+  }
+  str->close();
+}
+
+// Record that the object being hashed refers to object <num>.
+void PageFingerprints::addChild(int num) {
+  PageFingerprintObj *obj;
+
+  if (curObj < 0) {
+    return;
+  }
+  obj = &objs[curObj];
+  if (obj->nChildren == obj->childrenSize) {
+    obj->childrenSize = obj->childrenSize ? 2 * obj->childrenSize : 8;
+    obj->children = (int *)greallocn(obj->children, obj->childrenSize,
+				     sizeof(int));
+  }
+  obj->children[obj->nChildren++] = num;
+}
+
+// An incremental update appends objects and a new xref section to the
+// file, and the new trailer points back to the old xref section.
+bool PageFingerprints::isUpdateOf(PageFingerprints *old) {
+  Object *trailer, obj;
+  bool ok;
+
+  if (old->startXRef < 0 || startXRef <= old->startXRef) {
+    return false;
+  }
+  trailer = doc->getXRef()->getTrailerDict();
+  if (!trailer->isDict()) {
+    return false;
+  }
+  trailer->dictLookup("Prev", &obj);
+  ok = obj.isInt() && obj.getInt() == old->startXRef;
+  obj.free();
+  return ok;
+}
+
+// Find the offset of the last xref section, from the "startxref" line
+// at the end of the file.
+long long PageFingerprints::readStartXRef() {
+  BaseStream *str;
+  char buf[pageFingerprintTailSize + 1];
+  char *p;
+  int n, c, i;
+
+  str = doc->getBaseStream();
+  str->setPos(pageFingerprintTailSize, -1);
+  for (n = 0; n < pageFingerprintTailSize; ++n) {
+    if ((c = str->getChar()) == EOF) {
+      break;
+    }
+    buf[n] = (char)c;
+  }
+  buf[n] = '\0';
+  for (i = n - 9; i >= 0; --i) {
+    if (!memcmp(buf + i, "startxref", 9)) {
+      break;
+    }
+  }
+  if (i < 0) {
+    return -1;
+  }
+  for (p = buf + i + 9; isspace(*p & 0xff); ++p) ;
+  if (!isdigit(*p & 0xff)) {
+    return -1;
+  }
+  return strtoll(p, NULL, 10);
+}
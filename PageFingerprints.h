@@ -0,0 +1,100 @@
+//========================================================================
+//
+// PageFingerprints.h
+//
+//========================================================================
+
+#ifndef PAGEFINGERPRINTS_H
+#define PAGEFINGERPRINTS_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+class PDFDoc;
+class Object;
+class Dict;
+class Stream;
+struct PageFingerprintObj;
+
+//------------------------------------------------------------------------
+// PageFingerprints
+//------------------------------------------------------------------------
+
+// Content hashes of the pages of a document, used when the document is
+// reloaded to find the pages that haven't changed, so their rasterized
+// tiles can be kept.  A page's fingerprint covers its boxes, rotation,
+// content streams, resources, and annotations.  Indirect objects are
+// hashed by value, not by object number, since the numbering usually
+// changes when a document is regenerated; the hash of each indirect
+// object is remembered, so shared resources are only read once.
+class PageFingerprints {
+public:
+
+  PageFingerprints(PDFDoc *docA);
+  ~PageFingerprints();
+
+  // If this document is an incremental update of <old>'s document,
+  // reuse the hashes of the objects that the update didn't replace
+  // (and that don't refer to replaced objects), so they don't have to
+  // be read again.  Must be called before any fingerprints are
+  // computed.
+  void inheritFrom(PageFingerprints *old);
+
+  // Get the fingerprint of page <pg>, computing it if needed.  Returns
+  // false if the page couldn't be fingerprinted.
+  bool getFingerprint(int pg, unsigned long long *fp);
+
+  // Returns true if page <pg>'s fingerprint has already been computed.
+  bool isComputed(int pg);
+
+  // Ask for page <pg> to be fingerprinted later, by computeNext().
+  void request(int pg);
+
+  // Compute the fingerprint of one of the requested pages.  Returns
+  // true if there are more requested pages.
+  bool computeNext();
+
+  // Returns true if there are requested pages that haven't been
+  // fingerprinted yet.
+  bool hasRequests() { return nRequests > 0; }
+
+  // Forget the requested pages that haven't been fingerprinted yet,
+  // and ignore any further requests -- e.g., because the file has
+  // changed.
+  void dropRequests() { nRequests = 0; requestsDropped = true; }
+
+private:
+
+  void hashPage(int pg);
+  unsigned long long hashRef(int num, int gen, int depth);
+  void hashObj(unsigned long long *h, Object *obj, int depth);
+  void hashDict(unsigned long long *h, Dict *dict, int depth);
+  void hashStreamData(unsigned long long *h, Stream *str);
+  void addChild(int num);
+  bool isUpdateOf(PageFingerprints *old);
+  long long readStartXRef();
+
+  PDFDoc *doc;
+  int nPages;
+  unsigned long long *pageHashes;
+  char *pageState;		// pageHashUnknown/Done/Failed, for each
+				//   page
+  int *requests;		// requested pages, not yet fingerprinted
+  int nRequests;
+  int requestsSize;
+  bool requestsDropped;		// set by dropRequests
+  PageFingerprintObj *objs;	// hash of each indirect object, indexed
+				//   by object number
+  int nObjs;
+  int curObj;			// object being hashed, or -1
+  int cycleDepth;		// depth of the shallowest object that the
+				//   current one leads back to, or -1 if
+				//   the depth limit was hit
+  long long startXRef;		// offset of the last xref section, or
+				//   -1 if unknown
+};
+
+#endif
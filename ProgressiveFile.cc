@@ -0,0 +1,332 @@
+//========================================================================
+//
+// ProgressiveFile.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "poppler/goo/gmem.h"
+#include "poppler/goo/GooString.h"
+#include "poppler/Object.h"
+#include "poppler/Stream.h"
+#include "poppler/Linearization.h"
+#include "ProgressiveFile.h"
+
+//------------------------------------------------------------------------
+
+// The linearization dictionary must be within this many bytes of the
+// start of the file.
+#define progressiveLinSearchSize 1024
+
+// A regular file that is shorter than its linearization dictionary
+// says is only read progressively if it grows within this long (in
+// ms) -- otherwise it's a truncated file (e.g., a partial download),
+// which is opened normally.
+#define progressiveGrowthWait 250
+
+// Give up on the data if nothing arrives for this long (in seconds).
+#define progressiveStallTimeout 30
+
+// Time to sleep between reads while waiting for data (in ms).
+#define progressiveWaitInterval 20
+
+//------------------------------------------------------------------------
+// ProgressiveFileStream
+//------------------------------------------------------------------------
+
+// A CachedFileStream that reports the file name (which PDFDoc copies
+// for its getFileName()).
+class ProgressiveFileStream: public CachedFileStream {
+public:
+
+  ProgressiveFileStream(CachedFile *ccA, GooString *fileNameA,
+			Object *dictA):
+    CachedFileStream(ccA, 0, gFalse, ccA->getLength(), dictA)
+    { fileName = fileNameA; }
+  virtual ~ProgressiveFileStream() { delete fileName; }
+  virtual GooString *getFileName() { return fileName; }
+
+private:
+
+  GooString *fileName;
+};
+
+//------------------------------------------------------------------------
+// ProgressiveFile
+//------------------------------------------------------------------------
+
+ProgressiveFile *ProgressiveFile::open(GooString *fileNameA) {
+  Linearization *linA;
+  char data[progressiveLinSearchSize];
+  struct stat st, st2;
+  bool partial;
+  int fd, n;
+
+  if ((fd = ::open(fileNameA->getCString(), O_RDONLY)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return NULL;
+  }
+  if (S_ISFIFO(st.st_mode)) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return new ProgressiveFile(fileNameA, fd, true);
+  }
+
+  // a regular file is only read progressively if it's a linearized
+  // file that is still being written
+  partial = false;
+  if (S_ISREG(st.st_mode) &&
+      (n = pread(fd, data, progressiveLinSearchSize, 0)) > 0 &&
+      (linA = readLinearization(data, n))) {
+    partial = linA->getLength() > (Guint)st.st_size;
+    delete linA;
+  }
+  if (partial) {
+    usleep(progressiveGrowthWait * 1000);
+    partial = fstat(fd, &st2) == 0 && st2.st_size > st.st_size;
+  }
+  if (!partial) {
+    ::close(fd);
+    return NULL;
+  }
+  return new ProgressiveFile(fileNameA, fd, false);
+}
+
+ProgressiveFile::ProgressiveFile(GooString *fileNameA, int fdA, bool fifoA) {
+  fileName = fileNameA->copy();
+  fd = fdA;
+  fifo = fifoA;
+  bufSize = 65536;
+  buf = (char *)gmalloc(bufSize);
+  avail = 0;
+  ended = false;
+  truncated = false;
+  aborted = false;
+  lastDataTime = time(NULL);
+  linChecked = false;
+  lin = NULL;
+  length = 0;
+  firstPageEnd = 0;
+  firstPage = 1;
+}
+
+ProgressiveFile::~ProgressiveFile() {
+  closeFile();
+  delete lin;
+  gfree(buf);
+  delete fileName;
+}
+
+// Parse the linearization dictionary at the start of <data>.  Returns
+// NULL if there isn't one.
+Linearization *ProgressiveFile::readLinearization(char *data, int len) {
+  Linearization *linA;
+  MemStream *str;
+  Object obj;
+
+  obj.initNull();
+  str = new MemStream(data, 0, len, &obj);
+  linA = new Linearization(str);
+  delete str;
+  if (linA->getLength() == 0) {
+    delete linA;
+    return NULL;
+  }
+  return linA;
+}
+
+// Once the start of the file is in, look for the linearization
+// dictionary, which gives the total length, and the amount of data
+// needed to display the first page.
+void ProgressiveFile::checkLinearization() {
+  Guint end;
+
+  if (linChecked || (avail < progressiveLinSearchSize && !ended)) {
+    return;
+  }
+  linChecked = true;
+  if (!(lin = readLinearization(buf, avail < progressiveLinSearchSize
+				       ? avail : progressiveLinSearchSize)) ||
+      lin->getLength() < avail) {
+    delete lin;
+    lin = NULL;
+    return;
+  }
+  length = lin->getLength();
+  firstPageEnd = lin->getEndFirstPage();
+  end = lin->getHintsOffset() + lin->getHintsLength();
+  if (end > firstPageEnd) {
+    firstPageEnd = end;
+  }
+  end = lin->getHintsOffset2() + lin->getHintsLength2();
+  if (end > firstPageEnd) {
+    firstPageEnd = end;
+  }
+  if (firstPageEnd > length) {
+    firstPageEnd = length;
+  }
+  firstPage = lin->getPageFirst() + 1;
+
+  // the whole file will be read, so allocate it all now
+  if (length > bufSize) {
+    bufSize = length;
+    buf = (char *)grealloc(buf, bufSize);
+  }
+}
+
+bool ProgressiveFile::poll() {
+  bool got;
+  int n;
+
+  if (ended) {
+    return false;
+  }
+  got = false;
+  while (1) {
+    if (avail == bufSize) {
+      if (length && avail >= length) {
+	break;
+      }
+      bufSize *= 2;
+      buf = (char *)grealloc(buf, bufSize);
+    }
+    n = read(fd, buf + avail, bufSize - avail);
+    if (n > 0) {
+      avail += n;
+      got = true;
+    } else if (n == 0) {
+      // EOF on a FIFO means the writer is done; a regular file may
+      // still grow
+      if (fifo) {
+	ended = true;
+      }
+      break;
+    } else if (errno != EINTR) {
+      if (errno != EAGAIN) {
+	ended = true;
+      }
+      break;
+    }
+  }
+  if (got) {
+    lastDataTime = time(NULL);
+  } else if (time(NULL) - lastDataTime > progressiveStallTimeout) {
+    ended = true;
+  }
+  checkLinearization();
+  if (length && avail >= length) {
+    ended = true;
+  }
+  if (ended) {
+    // if the data stopped short, whatever did arrive is all there is
+    if (length && avail < length) {
+      truncated = !fifo;
+      length = avail;
+    } else if (!length) {
+      length = avail;
+    }
+    closeFile();
+  }
+  return got;
+}
+
+// Wait until at least <n> bytes have arrived.  Returns false if the
+// data ends before that, or if abort() is called.
+bool ProgressiveFile::waitFor(Guint n) {
+  while (avail < n && !ended) {
+    if (isAborted()) {
+      return false;
+    }
+    if (!poll()) {
+      usleep(progressiveWaitInterval * 1000);
+    }
+  }
+  return avail >= n;
+}
+
+bool ProgressiveFile::waitForFirstPage() {
+  // wait for the linearization dictionary (or EOF)
+  while (!linChecked) {
+    if (isAborted()) {
+      return false;
+    }
+    if (!poll() && !linChecked) {
+      usleep(progressiveWaitInterval * 1000);
+    }
+  }
+
+  // a file that isn't linearized has to be read completely
+  if (!lin) {
+    while (!ended) {
+      if (isAborted()) {
+	return false;
+      }
+      if (!poll()) {
+	usleep(progressiveWaitInterval * 1000);
+      }
+    }
+    return avail > 0;
+  }
+  return waitFor(firstPageEnd);
+}
+
+BaseStream *ProgressiveFile::makeStream() {
+  CachedFile *cachedFile;
+  Object obj;
+
+  cachedFile = new CachedFile(this, fileName->copy());
+  obj.initNull();
+  return new ProgressiveFileStream(cachedFile, fileName->copy(), &obj);
+}
+
+bool ProgressiveFile::isPageAvailable(int pg) {
+  if (length && avail >= length) {
+    return true;
+  }
+  return lin && pg == firstPage && avail >= firstPageEnd;
+}
+
+void ProgressiveFile::closeFile() {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+size_t ProgressiveFile::init(GooString *uri, CachedFile *cachedFile) {
+  return length ? length : avail;
+}
+
+// Copy the requested ranges to <writer>, waiting for any data that
+// hasn't arrived yet.
+int ProgressiveFile::load(const std::vector<ByteRange> &ranges,
+			  CachedFileWriter *writer) {
+  Guint end, i;
+
+  for (i = 0; i < ranges.size(); ++i) {
+    end = ranges[i].offset + ranges[i].length;
+    if (length && end > length) {
+      end = length;
+    }
+    if (end <= ranges[i].offset) {
+      continue;
+    }
+    if (!waitFor(end)) {
+      return -1;
+    }
+    writer->write(buf + ranges[i].offset, end - ranges[i].offset);
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+//========================================================================
+//
+// ProgressiveFile.h
+//
+//========================================================================
+
+#ifndef PROGRESSIVEFILE_H
+#define PROGRESSIVEFILE_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <time.h>
+#include <vector>
+#include "poppler/CachedFile.h"
+
+class GooString;
+class BaseStream;
+class Linearization;
+
+//------------------------------------------------------------------------
+// ProgressiveFile
+//------------------------------------------------------------------------
+
+// A PDF file that is still arriving: a FIFO, or a linearized file
+// that is shorter than its linearization dictionary says, and is
+// still growing (i.e., it's being copied in).  The data is read into
+// memory as it arrives, and handed to poppler through a CachedFile, so
+// a linearized document can be opened, and its first page displayed,
+// as soon as the first-page section is there.  The objects of the other
+// pages can only be found through the main xref table, at the end of
+// the file, so those pages become available once all of the data has
+// arrived.  Reads of data that hasn't arrived yet block until it does.
+class ProgressiveFile: public CachedFileLoader {
+public:
+
+  // If <fileNameA> is a FIFO, or a linearized file that is still being
+  // written, start reading it and return a new ProgressiveFile.  Otherwise,
+  // return NULL, and the file should be opened normally.
+  static ProgressiveFile *open(GooString *fileNameA);
+
+  virtual ~ProgressiveFile();
+
+  // Wait until the document can be opened: the first page and the
+  // hint tables of a linearized file, or all of any other file.
+  // Returns false if the data stops before that.
+  bool waitForFirstPage();
+
+  // Create the document's base stream.  This object is then owned by
+  // the stream (via its CachedFile).
+  BaseStream *makeStream();
+
+  // Make the waits (waitForFirstPage, and reads of data that hasn't
+  // arrived yet) give up, as if the data had stopped.  This can be
+  // called from another thread.
+  void abort() { __atomic_store_n(&aborted, true, __ATOMIC_RELAXED); }
+
+  // Read whatever data has arrived, without blocking.  Returns true
+  // if there was any.
+  bool poll();
+
+  // Returns true once all of the data has arrived, or it has stopped
+  // arriving (EOF on a FIFO, or nothing new for a while).
+  bool isDone() { return ended; }
+
+  // Returns true if the data of a regular file stopped before the end
+  // given by its linearization dictionary.  The pages that did arrive
+  // can be read, but the file should be reopened normally (so its
+  // xref table is reconstructed).
+  bool isTruncated() { return truncated; }
+
+  // Returns true if all of the data for page <pg> has arrived.
+  bool isPageAvailable(int pg);
+
+  // Returns the first page of a linearized file (the one that can be
+  // displayed first), or 1.
+  int getFirstPage() { return firstPage; }
+
+  //----- CachedFileLoader
+
+  virtual size_t init(GooString *uri, CachedFile *cachedFile);
+  virtual int load(const std::vector<ByteRange> &ranges,
+		   CachedFileWriter *writer);
+
+private:
+
+  ProgressiveFile(GooString *fileNameA, int fdA, bool fifoA);
+  static Linearization *readLinearization(char *data, int len);
+  void checkLinearization();
+  bool isAborted() { return __atomic_load_n(&aborted, __ATOMIC_RELAXED); }
+  bool waitFor(Guint n);
+  void closeFile();
+
+  GooString *fileName;
+  int fd;			// input file (-1 once the data is done)
+  bool fifo;			// set if <fd> is a FIFO
+  char *buf;			// data read so far
+  Guint bufSize;		// allocated size of <buf>
+  Guint avail;			// number of bytes in <buf>
+  bool ended;			// set once no more data will be read
+  bool truncated;		// set if the data ended short of the
+				//   linearization dictionary's length
+  bool aborted;			// set by abort()
+  time_t lastDataTime;		// time of the last read that got data
+  bool linChecked;		// set once the linearization dictionary
+				//   has been looked for
+  Linearization *lin;		// linearization info (NULL if the file
+				//   isn't linearized)
+  Guint length;			// total length of the file (0 if not
+				//   yet known)
+  Guint firstPageEnd;		// bytes needed to open a linearized file
+  int firstPage;
+};
+
+#endif
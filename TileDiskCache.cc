@@ -0,0 +1,265 @@
+//========================================================================
+//
+// TileDiskCache.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "poppler/goo/gmem.h"
+#include "poppler/goo/GooString.h"
+#include "poppler/splash/SplashBitmap.h"
+#include "PDFCore.h"
+#include "CacheDir.h"
+#include "TileDiskCache.h"
+
+//------------------------------------------------------------------------
+
+#define tileDiskCacheMagic "xpdfTC01"
+#define tileDiskCacheSuffix ".tile"
+
+// Max number of tiles waiting to be written.  New tiles are dropped
+// when the queue is full, which bounds the memory held by the bitmap
+// copies if the disk is slow.
+#define tileDiskCacheMaxJobs 64
+
+struct TileDiskCacheHeader {
+  char magic[8];		// tileDiskCacheMagic
+  int keyLen;			// length of the key, which follows the
+				//   header
+  int w, h;			// tile size
+  int mode;			// SplashColorMode of the packed data
+  int solid;			// set for a single-color tile
+  SplashColor solidColor;
+  double ctm[6], ictm[6];
+  int dataLen;			// length of the packed data, which follows
+				//   the key
+};
+
+struct TileDiskCacheJob {
+  GooString *key;
+  TileDiskCacheHeader hdr;	// everything but dataLen is filled in
+  SplashBitmap *bitmap;		// pixels to pack, or NULL for a solid
+				//   tile
+  TileDiskCacheJob *next;
+};
+
+//------------------------------------------------------------------------
+// TileDiskCache
+//------------------------------------------------------------------------
+
+TileDiskCache::TileDiskCache(GooString *dirA, double maxSizeA,
+			     TileDiskCachePackFunc packFuncA) {
+  cacheDir = new CacheDir(dirA, tileDiskCacheSuffix, maxSizeA, 0);
+  maxSize = maxSizeA;
+  packFunc = packFuncA;
+  jobHead = jobTail = NULL;
+  nJobs = 0;
+  quit = false;
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&cond, NULL);
+  writerRunning = maxSize > 0 &&
+                  !pthread_create(&writer, NULL, &writerMain, this);
+}
+
+TileDiskCache::~TileDiskCache() {
+  TileDiskCacheJob *job;
+
+  // tiles that haven't been written yet are dropped
+  if (writerRunning) {
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(writer, NULL);
+  }
+  while ((job = jobHead)) {
+    jobHead = job->next;
+    delete job->key;
+    delete job->bitmap;
+    delete job;
+  }
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&mutex);
+  delete cacheDir;
+}
+
+bool TileDiskCache::load(GooString *key, PDFCoreTile *tile) {
+  TileDiskCacheHeader *hdr;
+  GooString *path;
+  struct stat st;
+  char *map;
+  bool ok;
+  int fd;
+
+  path = cacheDir->getPath(key);
+  if ((fd = open(path->getCString(), O_RDONLY)) < 0) {
+    delete path;
+    return false;
+  }
+  map = NULL;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(TileDiskCacheHeader)) {
+    map = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == (char *)MAP_FAILED) {
+      map = NULL;
+    }
+  }
+  close(fd);
+  if (!map) {
+    delete path;
+    return false;
+  }
+
+  // check that this is really the requested tile (and not a file
+  // from an older version, or a hash collision)
+  hdr = (TileDiskCacheHeader *)map;
+  ok = !memcmp(hdr->magic, tileDiskCacheMagic, 8) &&
+       hdr->keyLen == key->getLength() &&
+       hdr->dataLen >= 0 &&
+       (off_t)sizeof(TileDiskCacheHeader) + hdr->keyLen + hdr->dataLen ==
+         st.st_size &&
+       !memcmp(map + sizeof(TileDiskCacheHeader), key->getCString(),
+	       hdr->keyLen) &&
+       hdr->w == tile->xMax - tile->xMin &&
+       hdr->h == tile->yMax - tile->yMin &&
+       (hdr->solid ? hdr->dataLen == 0
+	           : (hdr->dataLen > 0 &&
+		      (hdr->mode == splashModeMono1 ||
+		       hdr->mode == splashModeMono8 ||
+		       hdr->mode == splashModeRGB8)));
+  if (ok) {
+    tile->solid = hdr->solid != 0;
+    memcpy(tile->solidColor, hdr->solidColor, sizeof(SplashColor));
+    if (!tile->solid) {
+      tile->packedLen = hdr->dataLen;
+      tile->packedData = (Guchar *)gmalloc(hdr->dataLen);
+      memcpy(tile->packedData,
+	     map + sizeof(TileDiskCacheHeader) + hdr->keyLen, hdr->dataLen);
+      tile->packedMode = (SplashColorMode)hdr->mode;
+    }
+    memcpy(tile->ctm, hdr->ctm, 6 * sizeof(double));
+    memcpy(tile->ictm, hdr->ictm, 6 * sizeof(double));
+
+    // mark the file as recently used
+    cacheDir->touch(key);
+  }
+  munmap(map, st.st_size);
+  delete path;
+  return ok;
+}
+
+void TileDiskCache::store(GooString *key, PDFCoreTile *tile,
+			  SplashBitmap *bitmap) {
+  TileDiskCacheJob *job;
+
+  if (maxSize <= 0) {
+    delete bitmap;
+    return;
+  }
+  job = new TileDiskCacheJob;
+  job->key = key->copy();
+  memset(&job->hdr, 0, sizeof(job->hdr));
+  memcpy(job->hdr.magic, tileDiskCacheMagic, 8);
+  job->hdr.keyLen = key->getLength();
+  job->hdr.w = tile->xMax - tile->xMin;
+  job->hdr.h = tile->yMax - tile->yMin;
+  job->hdr.mode = bitmap ? bitmap->getMode() : splashModeRGB8;
+  job->hdr.solid = tile->solid ? 1 : 0;
+  memcpy(job->hdr.solidColor, tile->solidColor, sizeof(SplashColor));
+  memcpy(job->hdr.ctm, tile->ctm, 6 * sizeof(double));
+  memcpy(job->hdr.ictm, tile->ictm, 6 * sizeof(double));
+  job->bitmap = tile->solid ? (SplashBitmap *)NULL : bitmap;
+  job->next = NULL;
+  if (tile->solid) {
+    delete bitmap;
+  }
+
+  // if the writer thread couldn't be started, write the tile here
+  if (!writerRunning) {
+    writeTile(job);
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  if (nJobs >= tileDiskCacheMaxJobs) {
+    pthread_mutex_unlock(&mutex);
+    delete job->key;
+    delete job->bitmap;
+    delete job;
+    return;
+  }
+  if (jobTail) {
+    jobTail->next = job;
+  } else {
+    jobHead = job;
+  }
+  jobTail = job;
+  ++nJobs;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&mutex);
+}
+
+void TileDiskCache::remove(GooString *key) {
+  cacheDir->remove(key);
+}
+
+void *TileDiskCache::writerMain(void *arg) {
+  TileDiskCache *cache = (TileDiskCache *)arg;
+  TileDiskCacheJob *job;
+
+  pthread_mutex_lock(&cache->mutex);
+  while (1) {
+    while (!cache->quit && !cache->jobHead) {
+      pthread_cond_wait(&cache->cond, &cache->mutex);
+    }
+    if (cache->quit) {
+      break;
+    }
+    job = cache->jobHead;
+    if (!(cache->jobHead = job->next)) {
+      cache->jobTail = NULL;
+    }
+    --cache->nJobs;
+    pthread_mutex_unlock(&cache->mutex);
+    cache->writeTile(job);
+    pthread_mutex_lock(&cache->mutex);
+  }
+  pthread_mutex_unlock(&cache->mutex);
+  return NULL;
+}
+
+// Pack the tile in <job>, write it to its file, and free the job.
+void TileDiskCache::writeTile(TileDiskCacheJob *job) {
+  const void *bufs[3];
+  size_t lens[3];
+  Guchar *data;
+  int len;
+
+  data = NULL;
+  len = 0;
+  if (job->bitmap) {
+    data = (*packFunc)(job->bitmap, &len);
+  }
+  job->hdr.dataLen = len;
+  bufs[0] = &job->hdr;
+  lens[0] = sizeof(job->hdr);
+  bufs[1] = job->key->getCString();
+  lens[1] = job->hdr.keyLen;
+  bufs[2] = data;
+  lens[2] = len;
+  cacheDir->write(job->key, bufs, lens, 3);
+  gfree(data);
+  delete job->key;
+  delete job->bitmap;
+  delete job;
+}
@@ -0,0 +1,89 @@
+//========================================================================
+//
+// TileDiskCache.h
+//
+//========================================================================
+
+#ifndef TILEDISKCACHE_H
+#define TILEDISKCACHE_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <pthread.h>
+#include "poppler/goo/gtypes.h"
+#include "poppler/splash/SplashTypes.h"
+
+class GooString;
+class SplashBitmap;
+class PDFCoreTile;
+class CacheDir;
+struct TileDiskCacheJob;
+
+// Compress <bitmap> for the disk cache.  Returns the packed data
+// (allocated with gmalloc), and sets *<len>.  Called on the writer
+// thread.
+typedef Guchar *(*TileDiskCachePackFunc)(SplashBitmap *bitmap, int *len);
+
+//------------------------------------------------------------------------
+// TileDiskCache
+//------------------------------------------------------------------------
+
+// A directory of rasterized tiles, kept across sessions.  Each tile is
+// stored in its own file, named after a hash of its key (which
+// identifies the PDF file, the page, the slot, and all of the
+// rendering settings), in the same run-length format that PDFCore
+// uses for off-screen tiles.  Files are read with mmap.  The least
+// recently used files (by modification time, which is updated on
+// each hit) are removed to keep the directory under the size limit.
+// New tiles are packed and written by a background thread, so storing
+// a tile doesn't hold up the caller.
+class TileDiskCache {
+public:
+
+  // Use directory <dirA> (which is created if needed), and keep it
+  // under <maxSizeA> bytes.  Tiles are packed with <packFuncA>.  Takes
+  // ownership of <dirA>.
+  TileDiskCache(GooString *dirA, double maxSizeA,
+		TileDiskCachePackFunc packFuncA);
+  ~TileDiskCache();
+
+  // Look for the tile with <key>.  If found, fill in <tile>'s
+  // contents (solid color, or packed data), and its CTM, and return
+  // true.  <tile>'s position and size must already be set up.
+  bool load(GooString *key, PDFCoreTile *tile);
+
+  // Queue <tile> to be stored under <key>.  For a tile that isn't
+  // solid, <bitmap> is a copy of its pixels, which is taken over by
+  // the cache.  If the writer thread is too far behind, the tile is
+  // dropped.
+  void store(GooString *key, PDFCoreTile *tile, SplashBitmap *bitmap);
+
+  // Remove the tile with <key>, e.g., if its contents turned out to be
+  // bad.
+  void remove(GooString *key);
+
+private:
+
+  static void *writerMain(void *arg);
+  void writeTile(TileDiskCacheJob *job);
+
+  CacheDir *cacheDir;
+  double maxSize;		// size limit, in bytes
+  TileDiskCachePackFunc packFunc;
+
+  TileDiskCacheJob *jobHead;	// queue of tiles waiting to be written
+  TileDiskCacheJob *jobTail;
+  int nJobs;			// number of tiles in the queue
+  bool quit;			// set to stop the writer thread
+  bool writerRunning;		// set if the writer thread was started
+  pthread_t writer;
+  pthread_mutex_t mutex;	// protects the queue and <quit>
+  pthread_cond_t cond;		// signaled when a tile is queued, or
+				//   <quit> is set
+};
+
+#endif
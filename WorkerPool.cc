@@ -0,0 +1,117 @@
+//========================================================================
+//
+// WorkerPool.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "poppler/goo/gmem.h"
+#include "WorkerPool.h"
+
+//------------------------------------------------------------------------
+// WorkerPool
+//------------------------------------------------------------------------
+
+WorkerPool::WorkerPool(int nWorkersA) {
+  int i;
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&startCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+  func = NULL;
+  data = NULL;
+  nJobs = nextJob = nDone = 0;
+  quit = false;
+  threads = NULL;
+  nWorkers = 0;
+  if (nWorkersA > 0) {
+    threads = (pthread_t *)gmallocn(nWorkersA, sizeof(pthread_t));
+    for (i = 0; i < nWorkersA; ++i) {
+      if (pthread_create(&threads[nWorkers], NULL, &threadMain, this)) {
+	break;
+      }
+      ++nWorkers;
+    }
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  int i;
+
+  pthread_mutex_lock(&mutex);
+  quit = true;
+  pthread_cond_broadcast(&startCond);
+  pthread_mutex_unlock(&mutex);
+  for (i = 0; i < nWorkers; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  gfree(threads);
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&startCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+void WorkerPool::run(WorkerPoolFunc funcA, void *dataA, int nJobsA) {
+  int job;
+
+  if (nWorkers == 0 || nJobsA == 1) {
+    for (job = 0; job < nJobsA; ++job) {
+      (*funcA)(dataA, job);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  func = funcA;
+  data = dataA;
+  nJobs = nJobsA;
+  nextJob = 0;
+  nDone = 0;
+  pthread_cond_broadcast(&startCond);
+
+  // the calling thread takes jobs too
+  while (nextJob < nJobs) {
+    job = nextJob++;
+    pthread_mutex_unlock(&mutex);
+    (*funcA)(dataA, job);
+    pthread_mutex_lock(&mutex);
+    ++nDone;
+  }
+  while (nDone < nJobs) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void *WorkerPool::threadMain(void *arg) {
+  WorkerPool *pool = (WorkerPool *)arg;
+  WorkerPoolFunc funcA;
+  void *dataA;
+  int job;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    while (!pool->quit && pool->nextJob >= pool->nJobs) {
+      pthread_cond_wait(&pool->startCond, &pool->mutex);
+    }
+    if (pool->quit) {
+      break;
+    }
+    job = pool->nextJob++;
+    funcA = pool->func;
+    dataA = pool->data;
+    pthread_mutex_unlock(&pool->mutex);
+    (*funcA)(dataA, job);
+    pthread_mutex_lock(&pool->mutex);
+    if (++pool->nDone == pool->nJobs) {
+      pthread_cond_signal(&pool->doneCond);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return NULL;
+}
@@ -0,0 +1,61 @@
+//========================================================================
+//
+// WorkerPool.h
+//
+//========================================================================
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <poppler-config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <pthread.h>
+
+typedef void (*WorkerPoolFunc)(void *data, int job);
+
+//------------------------------------------------------------------------
+// WorkerPool
+//------------------------------------------------------------------------
+
+// A small set of threads for splitting one job (e.g., converting a
+// tile) into parallel pieces.  run() is synchronous, so the pool can
+// only be used from one thread at a time.
+class WorkerPool {
+public:
+
+  // Start <nWorkersA> worker threads (which may be zero, in which case
+  // everything runs in the calling thread).
+  WorkerPool(int nWorkersA);
+  ~WorkerPool();
+
+  // Total number of threads used by run(), including the calling one.
+  int getNThreads() { return nWorkers + 1; }
+
+  // Call <func>(<data>, i) for i = 0 .. <nJobsA>-1, spread over the
+  // workers and the calling thread, and return when all of the calls
+  // are done.  If <nJobsA> is no more than getNThreads(), all of the
+  // jobs run concurrently, so they may wait on each other.
+  void run(WorkerPoolFunc funcA, void *dataA, int nJobsA);
+
+private:
+
+  static void *threadMain(void *arg);
+
+  pthread_t *threads;
+  int nWorkers;
+  pthread_mutex_t mutex;
+  pthread_cond_t startCond;	// signalled when jobs are queued
+  pthread_cond_t doneCond;	// signalled when the last job finishes
+  WorkerPoolFunc func;
+  void *data;
+  int nJobs;			// number of jobs in the current run
+  int nextJob;			// next job to start
+  int nDone;			// number of finished jobs
+  bool quit;
+};
+
+#endif
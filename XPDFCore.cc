@@ -16,7 +16,13 @@
 
 #include <X11/keysym.h>
 #include <X11/cursorfont.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 #include "poppler/goo/gmem.h"
 #include "poppler/goo/GooString.h"
 #include "poppler/goo/GooList.h"
@@ -28,6 +34,9 @@
 #include "poppler/ErrorCodes.h"
 #include "poppler/GfxState.h"
 #include "CoreOutputDev.h"
+#include "BufferPool.h"
+#include "WorkerPool.h"
+#include "DocLoader.h"
 #include "poppler/PSOutputDev.h"
 #include "poppler/TextOutputDev.h"
 #include "poppler/splash/SplashBitmap.h"
@@ -51,6 +60,54 @@ static inline unsigned char div255(int x) {
   return (unsigned char)((x + (x >> 8) + 0x80) >> 8);
 }
 
+// Rectangles with fewer pixels than this are converted by a single
+// thread.
+#define convertMinParallelPixels (128 * 128)
+
+// Interval between checks for new data, while a document is still
+// arriving (in ms).
+#define progressivePollInterval 100
+
+// Put up the "loading" dialog only if opening a file takes longer than
+// this (in ms), and update it at this interval (in ms).
+#define loadDialogDelay  500
+#define loadDialogUpdate 100
+
+// Reload a changed file once it has been left alone for this long (in
+// ms), so a burst of writes (e.g., from pdflatex) causes one reload.
+#define fileChangeDelay 300
+
+// When dithering in parallel, each row reports its progress every
+// convertDitherChunk pixels.
+#define convertDitherChunk 64
+
+// 8x8 ordered dithering matrix.
+static int bayerMatrix[64] = {
+   0, 32,  8, 40,  2, 34, 10, 42,
+  48, 16, 56, 24, 50, 18, 58, 26,
+  12, 44,  4, 36, 14, 46,  6, 38,
+  60, 28, 52, 20, 62, 30, 54, 22,
+   3, 35, 11, 43,  1, 33,  9, 41,
+  51, 19, 59, 27, 49, 17, 57, 25,
+  15, 47,  7, 39, 13, 45,  5, 37,
+  63, 31, 55, 23, 61, 29, 53, 21
+};
+
+// A bitmap-to-XImage conversion, shared by the bands working on it.
+struct XPDFCoreConvert {
+  XPDFCore *core;
+  SplashBitmap *bitmap;
+  int xSrc, ySrc, width, height;
+  bool composited;
+  XImage *image;
+  int xImg, yImg;
+  int nBands;
+  Guchar *rowBufs;		// two RGB8 row buffers per band
+  int *errDown;			// dithering: error rows, nBands + 1 sets
+				//   of R, G, B rows of width + 2 entries
+  int *progress;		// dithering: pixels finished, per row
+};
+
 //------------------------------------------------------------------------
 
 GooString *XPDFCore::currentSelection = NULL;
@@ -63,20 +120,24 @@ Atom XPDFCore::targetsAtom;
 
 class XPDFCoreTile: public PDFCoreTile {
 public:
-  XPDFCoreTile(int xDestA, int yDestA);
+  XPDFCoreTile(int xDestA, int yDestA, BufferPool *poolA);
   virtual ~XPDFCoreTile();
-  XImage *image;
+  XImage *image;		// image->data comes from <pool>
+  BufferPool *pool;
+  unsigned long solidPixel;	// pixel value for a solid tile
 };
 
-XPDFCoreTile::XPDFCoreTile(int xDestA, int yDestA):
+XPDFCoreTile::XPDFCoreTile(int xDestA, int yDestA, BufferPool *poolA):
   PDFCoreTile(xDestA, yDestA)
 {
   image = NULL;
+  pool = poolA;
+  solidPixel = 0;
 }
 
 XPDFCoreTile::~XPDFCoreTile() {
   if (image) {
-    gfree(image->data);
+    pool->release(image->data);
     image->data = NULL;
     XDestroyImage(image);
   }
@@ -106,6 +167,12 @@ XPDFCore::XPDFCore(Widget shellA, Widget parentWidgetA,
 
   setupX(installCmap, rgbCubeSizeA);
 
+  // on a monochrome display, rasterize straight to 1-bit bitmaps,
+  // halftoned by Splash
+  if (!trueColor && rgbCubeSize == 1) {
+    setColorMode(splashModeMono1);
+  }
+
   scrolledWin = NULL;
   hScrollBar = NULL;
   vScrollBar = NULL;
@@ -134,6 +201,19 @@ XPDFCore::XPDFCore(Widget shellA, Widget parentWidgetA,
 
   panning = false;
 
+  idleTimer = 0;
+  progressiveTimer = 0;
+  loadTimer = 0;
+  loadInput = 0;
+  reloadTimer = 0;
+  fingerprintProc = 0;
+  modTime = 0;
+  fileChanged = false;
+  inotifyFD = -1;
+  inotifyInput = 0;
+  watchDesc = -1;
+  watchName = NULL;
+
   updateCbk = NULL;
   actionCbk = NULL;
   keyPressCbk = NULL;
@@ -145,10 +225,46 @@ XPDFCore::XPDFCore(Widget shellA, Widget parentWidgetA,
 
   // do X-specific initialization and create the widgets
   initWindow();
+  initLoadDialog();
   initPasswordDialog();
+
+#ifdef HAVE_SYS_INOTIFY_H
+  // watch for changes to the PDF file
+  if ((inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) >= 0) {
+    inotifyInput = XtAppAddInput(XtWidgetToApplicationContext(drawArea),
+				 inotifyFD, (XtPointer)XtInputReadMask,
+				 &fileChangeCbk, this);
+  }
+#endif
 }
 
 XPDFCore::~XPDFCore() {
+  if (idleTimer) {
+    XtRemoveTimeOut(idleTimer);
+  }
+  if (progressiveTimer) {
+    XtRemoveTimeOut(progressiveTimer);
+  }
+  if (loadTimer) {
+    XtRemoveTimeOut(loadTimer);
+  }
+  // the pending open, if any, is cancelled by ~PDFCore
+  if (loadInput) {
+    XtRemoveInput(loadInput);
+  }
+  if (reloadTimer) {
+    XtRemoveTimeOut(reloadTimer);
+  }
+  if (fingerprintProc) {
+    XtRemoveWorkProc(fingerprintProc);
+  }
+  if (inotifyInput) {
+    XtRemoveInput(inotifyInput);
+  }
+  if (inotifyFD >= 0) {
+    close(inotifyFD);
+  }
+  delete watchName;
   if (currentSelectionOwner == this && currentSelection) {
     delete currentSelection;
     currentSelection = NULL;
@@ -181,18 +297,28 @@ int XPDFCore::loadFile(GooString *fileName, GooString *ownerPassword,
 
   err = PDFCore::loadFile(fileName, ownerPassword, userPassword);
   if (err == errNone) {
-    // save the modification time
-    modTime = getModTime(doc->getFileName()->getCString());
-
-    // update the parent window
-    if (updateCbk) {
-      (*updateCbk)(updateCbkData, doc->getFileName(), -1,
-		   doc->getNumPages(), NULL);
-    }
+    fileOpened();
   }
   return err;
 }
 
+// Finish setting up a document that was loaded from a file.
+void XPDFCore::fileOpened() {
+  // watch for changes to the file
+  watchFile(doc->getFileName());
+
+  // update the parent window
+  if (updateCbk) {
+    (*updateCbk)(updateCbkData, doc->getFileName(), -1,
+		 doc->getNumPages(), NULL);
+  }
+
+  // keep reading a file that is still arriving
+  if (isLoadingProgressively()) {
+    startProgressiveTimer();
+  }
+}
+
 int XPDFCore::loadFile(BaseStream *stream, GooString *ownerPassword,
 		       GooString *userPassword) {
   int err;
@@ -200,7 +326,7 @@ int XPDFCore::loadFile(BaseStream *stream, GooString *ownerPassword,
   err = PDFCore::loadFile(stream, ownerPassword, userPassword);
   if (err == errNone) {
     // no file
-    modTime = 0;
+    watchFile(NULL);
 
     // update the parent window
     if (updateCbk) {
@@ -214,10 +340,8 @@ int XPDFCore::loadFile(BaseStream *stream, GooString *ownerPassword,
 void XPDFCore::loadDoc(PDFDoc *docA) {
   PDFCore::loadDoc(docA);
 
-  // save the modification time
-  if (doc->getFileName()) {
-    modTime = getModTime(doc->getFileName()->getCString());
-  }
+  // watch for changes to the file
+  watchFile(doc->getFileName());
 
   // update the parent window
   if (updateCbk) {
@@ -241,13 +365,13 @@ void XPDFCore::resizeToPage(int pg) {
     if (!doc || pg <= 0 || pg > doc->getNumPages()) {
       width1 = 612;
       height1 = 792;
-    } else if (doc->getPageRotate(pg) == 90 ||
-	       doc->getPageRotate(pg) == 270) {
-      width1 = doc->getPageCropHeight(pg);
-      height1 = doc->getPageCropWidth(pg);
+    } else if (getPageRotate(pg) == 90 ||
+	       getPageRotate(pg) == 270) {
+      width1 = getPageCropHeight(pg);
+      height1 = getPageCropWidth(pg);
     } else {
-      width1 = doc->getPageCropWidth(pg);
-      height1 = doc->getPageCropHeight(pg);
+      width1 = getPageCropWidth(pg);
+      height1 = getPageCropHeight(pg);
     }
     if (zoom == zoomPage || zoom == zoomWidth) {
       width = (Dimension)(width1 * 0.01 * defZoom + 0.5);
@@ -287,6 +411,11 @@ void XPDFCore::update(int topPageA, int scrollXA, int scrollYA,
   PDFCore::update(topPageA, scrollXA, scrollYA, zoomA, rotateA,
 		  force, addToHist);
   linkAction = NULL;
+  if (!fingerprintProc && hasPendingFingerprints()) {
+    fingerprintProc =
+      XtAppAddWorkProc(XtWidgetToApplicationContext(drawArea),
+		       &fingerprintWorkProc, this);
+  }
   if (doc && topPage != oldPage) {
     if (updateCbk) {
       (*updateCbk)(updateCbkData, NULL, topPage, -1, "");
@@ -297,6 +426,15 @@ void XPDFCore::update(int topPageA, int scrollXA, int scrollYA,
 bool XPDFCore::checkForNewFile() {
   time_t newModTime;
 
+  // changes to a watched file are reported by fileChangeCbk
+  if (watchDesc >= 0) {
+    if (fileChanged) {
+      fileChanged = false;
+      return true;
+    }
+    return false;
+  }
+
   if (doc->getFileName()) {
     newModTime = getModTime(doc->getFileName()->getCString());
     if (newModTime != modTime) {
@@ -353,6 +491,197 @@ void XPDFCore::endPan(int wx, int wy) {
   panning = false;
 }
 
+//------------------------------------------------------------------------
+// interactive rendering
+//------------------------------------------------------------------------
+
+void XPDFCore::startInteraction() {
+  PDFCore::startInteraction();
+  if (!interactive) {
+    return;
+  }
+  if (idleTimer) {
+    XtRemoveTimeOut(idleTimer);
+  }
+  idleTimer = XtAppAddTimeOut(XtWidgetToApplicationContext(drawArea),
+			      globalParamsGUI->getInteractiveIdleTime(),
+			      &idleTimerCbk, this);
+}
+
+void XPDFCore::idleTimerCbk(XtPointer ptr, XtIntervalId *id) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  core->idleTimer = 0;
+  core->endInteraction();
+}
+
+//------------------------------------------------------------------------
+// progressive loading
+//------------------------------------------------------------------------
+
+void XPDFCore::startProgressiveTimer() {
+  if (progressiveTimer) {
+    return;
+  }
+  progressiveTimer = XtAppAddTimeOut(XtWidgetToApplicationContext(drawArea),
+				     progressivePollInterval,
+				     &progressiveTimerCbk, this);
+}
+
+void XPDFCore::progressiveTimerCbk(XtPointer ptr, XtIntervalId *id) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  core->progressiveTimer = 0;
+  if (core->updateProgressiveLoad()) {
+    core->startProgressiveTimer();
+    return;
+  }
+
+  // the data is complete -- the writer has finished with the file, so
+  // don't treat its changes as a new version
+  if (core->doc && core->doc->getFileName()) {
+    core->watchFile(core->doc->getFileName());
+
+    // let the parent window set up the things (e.g., the outline) that
+    // had to wait for the rest of the file
+    if (core->updateCbk) {
+      (*core->updateCbk)(core->updateCbkData, core->doc->getFileName(), -1,
+			 core->doc->getNumPages(), NULL);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// file change detection
+//------------------------------------------------------------------------
+
+// Start watching <fileName> (NULL if the document isn't a file) for
+// changes, replacing any previous watch.  Changes made before this are
+// part of the current version.  Without inotify, the modification time
+// is saved, for checkForNewFile.
+void XPDFCore::watchFile(GooString *fileName) {
+#ifdef HAVE_SYS_INOTIFY_H
+  GooString *dir;
+  char *name, *p;
+#endif
+
+  fileChanged = false;
+  if (reloadTimer) {
+    XtRemoveTimeOut(reloadTimer);
+    reloadTimer = 0;
+  }
+  modTime = fileName ? getModTime(fileName->getCString()) : 0;
+
+#ifdef HAVE_SYS_INOTIFY_H
+  if (inotifyFD < 0) {
+    return;
+  }
+  if (watchDesc >= 0) {
+    inotify_rm_watch(inotifyFD, watchDesc);
+    watchDesc = -1;
+  }
+  delete watchName;
+  watchName = NULL;
+  if (!fileName) {
+    return;
+  }
+
+  // watch the directory, so that a new file renamed over this one is
+  // seen, as well as writes to the file itself
+  name = fileName->getCString();
+  if ((p = strrchr(name, '/'))) {
+    dir = new GooString(name, p == name ? 1 : (int)(p - name));
+    name = p + 1;
+  } else {
+    dir = new GooString(".");
+  }
+  watchDesc = inotify_add_watch(inotifyFD, dir->getCString(),
+				IN_MODIFY | IN_CLOSE_WRITE |
+				IN_MOVED_TO | IN_CREATE);
+  if (watchDesc >= 0) {
+    watchName = new GooString(name);
+  }
+  delete dir;
+#endif
+}
+
+void XPDFCore::fileChangeCbk(XtPointer ptr, int *source, XtInputId *id) {
+#ifdef HAVE_SYS_INOTIFY_H
+  XPDFCore *core = (XPDFCore *)ptr;
+  char buf[4096]
+      __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event *event;
+  bool changed;
+  char *p;
+  int n;
+
+  changed = false;
+  while ((n = read(core->inotifyFD, buf, sizeof(buf))) > 0) {
+    for (p = buf; p < buf + n;
+	 p += sizeof(struct inotify_event) + event->len) {
+      event = (struct inotify_event *)p;
+      if ((event->mask & IN_Q_OVERFLOW) ||
+	  (event->wd == core->watchDesc && event->len > 0 &&
+	   core->watchName &&
+	   !strcmp(event->name, core->watchName->getCString()))) {
+	changed = true;
+      }
+    }
+  }
+
+  // (re)start the timer -- the reload happens once the writes stop;
+  // pages that haven't been fingerprinted yet can't be anymore, since
+  // the file no longer has their old contents
+  if (changed) {
+    core->dropPendingFingerprints();
+    if (core->reloadTimer) {
+      XtRemoveTimeOut(core->reloadTimer);
+    }
+    core->reloadTimer =
+      XtAppAddTimeOut(XtWidgetToApplicationContext(core->drawArea),
+		      fileChangeDelay, &reloadTimerCbk, core);
+  }
+#endif
+}
+
+void XPDFCore::reloadTimerCbk(XtPointer ptr, XtIntervalId *id) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  core->reloadTimer = 0;
+
+  // wait for a file that is being opened, or is still arriving
+  if (core->docLoader || core->progFile) {
+    core->reloadTimer =
+      XtAppAddTimeOut(XtWidgetToApplicationContext(core->drawArea),
+		      fileChangeDelay, &reloadTimerCbk, core);
+    return;
+  }
+
+  // the reload itself happens in PDFCore::update, via checkForNewFile
+  core->fileChanged = true;
+  if (core->doc) {
+    core->update(core->topPage, core->scrollX, core->scrollY,
+		 core->zoom, core->rotate, true, false);
+  }
+}
+
+bool XPDFCore::wantPageFingerprints() {
+  return inotifyFD >= 0;
+}
+
+// Fingerprint one displayed page per call, so that events are handled
+// in between.  Returns True (i.e., remove this work procedure) when
+// they are all done.
+Boolean XPDFCore::fingerprintWorkProc(XtPointer ptr) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  if (core->fingerprintNextPage()) {
+    return False;
+  }
+  core->fingerprintProc = 0;
+  return True;
+}
+
 //------------------------------------------------------------------------
 // selection
 //------------------------------------------------------------------------
@@ -489,13 +818,10 @@ void XPDFCore::doAction(LinkAction *action) {
       } else {
 	fileName = appendToPath(grabPath(doc->getFileName()->getCString()), s);
       }
-      if (loadFile(fileName) != errNone) {
-        delete dest;
-	delete namedDest;
-	delete fileName;
-	return;
-      }
+      // the destination is displayed once the file has been opened
+      loadFileAsync(fileName, 1, dest, namedDest, true);
       delete fileName;
+      return;
     }
     if (namedDest) {
       dest = doc->findDest(namedDest);
@@ -504,10 +830,6 @@ void XPDFCore::doAction(LinkAction *action) {
     if (dest) {
       displayDest(dest, zoom, rotate, true);
       delete dest;
-    } else {
-      if (kind == actionGoToR) {
-	displayPage(1, zoom, 0, false, true);
-      }
     }
     break;
 
@@ -523,12 +845,8 @@ void XPDFCore::doAction(LinkAction *action) {
       } else {
 	fileName = appendToPath(grabPath(doc->getFileName()->getCString()), s);
       }
-      if (loadFile(fileName) != errNone) {
-	delete fileName;
-	return;
-      }
+      loadFileAsync(fileName, 1, NULL, NULL, true);
       delete fileName;
-      displayPage(1, zoom, rotate, false, true);
     } else {
       fileName = fileName->copy();
       if (((LinkLaunch *)action)->getParams()) {
@@ -859,6 +1177,33 @@ void XPDFCore::setupX(bool installCmap, int rgbCubeSizeA) {
       }
     }
   }
+  initDitherTables();
+}
+
+// Precompute the quantization tables for the color cube.  A monochrome
+// display is handled as a two-level gray ramp.
+void XPDFCore::initDitherTables() {
+  int n, i, c;
+
+  orderedDither = globalParamsGUI->getOrderedDither();
+  if (trueColor) {
+    return;
+  }
+  n = rgbCubeSize > 1 ? rgbCubeSize : 2;
+  for (c = 0; c < 256; ++c) {
+    cubeQuant[c] = div255(c * (n - 1));
+  }
+  for (i = 0; i < n; ++i) {
+    cubeLevel[i] = ((i << 8) - i) / (n - 1);
+  }
+  // orderedQuant[i][c] = floor(c * (n-1) / 255 + (bayer[i] + 0.5) / 64)
+  for (i = 0; i < 64; ++i) {
+    for (c = 0; c < 256; ++c) {
+      orderedQuant[i][c] = (Guchar)((c * (n - 1) * 128 +
+				     (2 * bayerMatrix[i] + 1) * 255) /
+				    (255 * 128));
+    }
+  }
 }
 
 void XPDFCore::initWindow() {
@@ -951,6 +1296,7 @@ void XPDFCore::hScrollChangeCbk(Widget widget, XtPointer ptr,
   XPDFCore *core = (XPDFCore *)ptr;
   XmScrollBarCallbackStruct *data = (XmScrollBarCallbackStruct *)callData;
 
+  core->startInteraction();
   core->scrollTo(data->value, core->scrollY);
 }
 
@@ -959,6 +1305,7 @@ void XPDFCore::hScrollDragCbk(Widget widget, XtPointer ptr,
   XPDFCore *core = (XPDFCore *)ptr;
   XmScrollBarCallbackStruct *data = (XmScrollBarCallbackStruct *)callData;
 
+  core->startInteraction();
   core->scrollTo(data->value, core->scrollY);
 }
 
@@ -967,6 +1314,7 @@ void XPDFCore::vScrollChangeCbk(Widget widget, XtPointer ptr,
   XPDFCore *core = (XPDFCore *)ptr;
   XmScrollBarCallbackStruct *data = (XmScrollBarCallbackStruct *)callData;
 
+  core->startInteraction();
   core->scrollTo(core->scrollX, data->value);
 }
 
@@ -975,6 +1323,7 @@ void XPDFCore::vScrollDragCbk(Widget widget, XtPointer ptr,
   XPDFCore *core = (XPDFCore *)ptr;
   XmScrollBarCallbackStruct *data = (XmScrollBarCallbackStruct *)callData;
 
+  core->startInteraction();
   core->scrollTo(core->scrollX, data->value);
 }
 
@@ -1126,6 +1475,7 @@ void XPDFCore::inputCbk(Widget widget, XtPointer ptr, XtPointer callData) {
       }
     }
     if (core->panning) {
+      core->startInteraction();
       core->scrollTo(core->scrollX - (data->event->xmotion.x - core->panMX),
 		     core->scrollY - (data->event->xmotion.y - core->panMY));
       core->panMX = data->event->xmotion.x;
@@ -1144,183 +1494,407 @@ void XPDFCore::inputCbk(Widget widget, XtPointer ptr, XtPointer callData) {
 }
 
 PDFCoreTile *XPDFCore::newTile(int xDestA, int yDestA) {
-  return new XPDFCoreTile(xDestA, yDestA);
+  return new XPDFCoreTile(xDestA, yDestA, bufPool);
 }
 
 void XPDFCore::updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
 			      int width, int height, bool composited) {
   XPDFCoreTile *tile = (XPDFCoreTile *)tileA;
   XImage *image;
-  SplashColorPtr dataPtr, p;
-  unsigned long pixel;
-  unsigned char *ap;
-  unsigned char alpha, alpha1;
-  int w, h, bw, x, y, r, g, b, gray;
-  int *errDownR, *errDownG, *errDownB;
-  int errRightR, errRightG, errRightB;
-  int errDownRightR, errDownRightG, errDownRightB;
-  int r0, g0, b0, re, ge, be;
+  int w, h, r, g, b, gray;
+
+  // a solid tile is drawn with XFillRectangle, a packed tile isn't
+  // visible, and a gray or monochrome tile is converted when it is
+  // drawn, so none of them needs an XImage
+  if (!tile->bitmap || tile->bitmap->getMode() != colorMode) {
+    if (tile->image) {
+      bufPool->release(tile->image->data);
+      tile->image->data = NULL;
+      XDestroyImage(tile->image);
+      tile->image = NULL;
+    }
+    if (!tile->solid) {
+      return;
+    }
+    r = displayLUT[0][tile->solidColor[0]];
+    g = displayLUT[1][tile->solidColor[1]];
+    b = displayLUT[2][tile->solidColor[2]];
+    if (trueColor) {
+      tile->solidPixel = ((unsigned long)(r >> rDiv) << rShift) +
+	                 ((unsigned long)(g >> gDiv) << gShift) +
+	                 ((unsigned long)(b >> bDiv) << bShift);
+    } else if (rgbCubeSize == 1) {
+      gray = (int)(0.299 * r + 0.587 * g + 0.114 * b + 0.5);
+      tile->solidPixel = colors[gray < 128 ? 0 : 1];
+    } else {
+      r = div255(r * (rgbCubeSize - 1));
+      g = div255(g * (rgbCubeSize - 1));
+      b = div255(b * (rgbCubeSize - 1));
+      tile->solidPixel = colors[(r * rgbCubeSize + g) * rgbCubeSize + b];
+    }
+    return;
+  }
 
   if (!tile->image) {
     w = tile->xMax - tile->xMin;
     h = tile->yMax - tile->yMin;
     image = XCreateImage(display, visual, depth, ZPixmap, 0, NULL, w, h, 8, 0);
-    image->data = (char *)gmalloc(h * image->bytes_per_line);
+    image->data = (char *)bufPool->alloc(h * image->bytes_per_line);
     tile->image = image;
   } else {
     image = (XImage *)tile->image;
   }
+  convertBitmap(tile->bitmap, xSrc, ySrc, width, height, composited,
+		image, xSrc, ySrc);
+}
 
-  //~ optimize for known XImage formats
-  bw = tile->bitmap->getRowSize();
-  dataPtr = tile->bitmap->getDataPtr();
+// Return a pointer to <width> RGB8 pixels from row <y> of <bitmap>,
+// starting at <x>.  Gray and monochrome bitmaps are expanded into
+// <buf>.
+static SplashColorPtr getRGBRow(SplashBitmap *bitmap, int x, int y,
+				int width, SplashColorPtr buf) {
+  SplashColorPtr p, q;
+  int i;
 
-  if (trueColor) {
-    for (y = 0; y < height; ++y) {
-      p = dataPtr + (ySrc + y) * bw + xSrc * 3;
-      if (!composited && tile->bitmap->getAlphaPtr()) {
-	ap = tile->bitmap->getAlphaPtr() +
-	       (ySrc + y) * tile->bitmap->getWidth() + xSrc;
-      } else {
-	ap = NULL;
+  p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+  switch (bitmap->getMode()) {
+  case splashModeMono1:
+    for (i = 0, q = buf; i < width; ++i, q += 3) {
+      q[0] = q[1] = q[2] = (p[(x + i) >> 3] & (0x80 >> ((x + i) & 7)))
+	                     ? 0xff : 0x00;
+    }
+    return buf;
+  case splashModeMono8:
+    for (i = 0, q = buf; i < width; ++i, q += 3) {
+      q[0] = q[1] = q[2] = p[x + i];
+    }
+    return buf;
+  default:
+    return p + x * 3;
+  }
+}
+
+// Convert a <width> x <height> rectangle of <bitmap>, with its
+// upper-left corner at (<xSrc>, <ySrc>), to X pixels, and store them
+// in <image> at (<xImg>, <yImg>).  This is where the display transform
+// (reverse video and the paper color) is applied.
+//
+// Large rectangles are split into bands of rows, which are converted
+// in parallel.  For TrueColor and monochrome displays, each band is a
+// contiguous set of rows.  Floyd-Steinberg dithering carries error
+// from each row into the next, so the rows are dealt out round-robin
+// instead, and each row follows just behind the one above it (a
+// wavefront); the result is the same as with a single band.
+void XPDFCore::convertBitmap(SplashBitmap *bitmap, int xSrc, int ySrc,
+			     int width, int height, bool composited,
+			     XImage *image, int xImg, int yImg) {
+  XPDFCoreConvert cvt;
+
+  if (bitmap->getMode() == splashModeMono1 && image->bits_per_pixel == 1) {
+    convertMono1(bitmap, xSrc, ySrc, width, height, image, xImg, yImg);
+    return;
+  }
+
+  cvt.core = this;
+  cvt.bitmap = bitmap;
+  cvt.xSrc = xSrc;
+  cvt.ySrc = ySrc;
+  cvt.width = width;
+  cvt.height = height;
+  cvt.composited = composited;
+  cvt.image = image;
+  cvt.xImg = xImg;
+  cvt.yImg = yImg;
+  if (width * height >= convertMinParallelPixels) {
+    cvt.nBands = workers->getNThreads();
+    if (cvt.nBands > height) {
+      cvt.nBands = height;
+    }
+  } else {
+    cvt.nBands = 1;
+  }
+  // the buffers come from the (non-thread-safe) pool, so they are all
+  // allocated here, rather than in the bands
+  cvt.rowBufs = (Guchar *)bufPool->alloc(cvt.nBands * 6 * width);
+  if (!trueColor && rgbCubeSize > 1 && !orderedDither) {
+    // one error row (R, G, and B) per band, plus one for the row
+    // being read
+    cvt.errDown = (int *)bufPool->alloc(3 * (cvt.nBands + 1) * (width + 2)
+					* sizeof(int));
+    memset(cvt.errDown, 0, 3 * (cvt.nBands + 1) * (width + 2) * sizeof(int));
+    cvt.progress = (int *)bufPool->alloc(height * sizeof(int));
+    memset(cvt.progress, 0, height * sizeof(int));
+  } else {
+    cvt.errDown = NULL;
+    cvt.progress = NULL;
+  }
+  if (cvt.nBands > 1) {
+    workers->run(&convertBitmapBand, &cvt, cvt.nBands);
+  } else {
+    convertBitmapBand(&cvt, 0);
+  }
+  bufPool->release(cvt.rowBufs);
+  bufPool->release(cvt.errDown);
+  bufPool->release(cvt.progress);
+}
+
+// Convert a Mono1 bitmap to a 1-bit XImage, mapping whole bytes (eight
+// pixels) at a time where the source and destination are aligned.
+void XPDFCore::convertMono1(SplashBitmap *bitmap, int xSrc, int ySrc,
+			    int width, int height,
+			    XImage *image, int xImg, int yImg) {
+  unsigned long pix[2];
+  Guchar byteMap[256];
+  SplashColorPtr p;
+  Guchar *q;
+  int c, v, gray, i, n, x, y;
+
+  // X pixel values for black and white source pixels, with the
+  // display transform applied
+  for (c = 0; c < 2; ++c) {
+    v = c ? 0xff : 0x00;
+    gray = (19595 * displayLUT[0][v] + 38470 * displayLUT[1][v] +
+	    7471 * displayLUT[2][v] + 0x8000) >> 16;
+    pix[c] = colors[gray < 128 ? 0 : 1] & 1;
+  }
+  for (i = 0; i < 256; ++i) {
+    byteMap[i] = 0;
+    for (x = 0; x < 8; ++x) {
+      if (pix[(i >> (7 - x)) & 1]) {
+	byteMap[i] |= image->bitmap_bit_order == MSBFirst ? 0x80 >> x
+	                                                  : 0x01 << x;
+      }
+    }
+  }
+
+  for (y = 0; y < height; ++y) {
+    p = bitmap->getDataPtr() + (ySrc + y) * bitmap->getRowSize();
+    x = 0;
+    if (!(xSrc & 7) && !(xImg & 7)) {
+      q = (Guchar *)image->data + (yImg + y) * image->bytes_per_line
+	  + (xImg >> 3);
+      n = width >> 3;
+      for (i = 0; i < n; ++i) {
+	q[i] = byteMap[p[(xSrc >> 3) + i]];
       }
+      x = n << 3;
+    }
+    for (; x < width; ++x) {
+      c = (p[(xSrc + x) >> 3] >> (7 - ((xSrc + x) & 7))) & 1;
+      XPutPixel(image, xImg + x, yImg + y, pix[c]);
+    }
+  }
+}
+
+void XPDFCore::convertBitmapBand(void *data, int band) {
+  XPDFCoreConvert *cvt = (XPDFCoreConvert *)data;
+
+  cvt->core->convertBand(cvt, band);
+}
+
+// Return a pointer to row <y> of the rectangle being converted by
+// <cvt>, as RGB8, composited with the paper, and with the display
+// transform applied.  Uses <rgbBuf> and <outBuf> (<width> pixels
+// each).
+SplashColorPtr XPDFCore::getDisplayRow(XPDFCoreConvert *cvt, int y,
+				       SplashColorPtr rgbBuf,
+				       SplashColorPtr outBuf) {
+  SplashBitmap *bitmap;
+  SplashColorPtr p, q;
+  unsigned char *ap;
+  unsigned char alpha, alpha1;
+  int x;
+
+  bitmap = cvt->bitmap;
+  p = getRGBRow(bitmap, cvt->xSrc, cvt->ySrc + y, cvt->width, rgbBuf);
+  if (!cvt->composited && bitmap->getAlphaPtr()) {
+    ap = bitmap->getAlphaPtr() +
+           (cvt->ySrc + y) * bitmap->getWidth() + cvt->xSrc;
+  } else {
+    ap = NULL;
+  }
+  q = outBuf;
+  for (x = 0; x < cvt->width; ++x) {
+    if (ap) {
+      alpha = *ap++;
+      alpha1 = 255 - alpha;
+      q[0] = displayLUT[0][div255(alpha1 * 0xff + alpha * p[0])];
+      q[1] = displayLUT[1][div255(alpha1 * 0xff + alpha * p[1])];
+      q[2] = displayLUT[2][div255(alpha1 * 0xff + alpha * p[2])];
+    } else {
+      q[0] = displayLUT[0][p[0]];
+      q[1] = displayLUT[1][p[1]];
+      q[2] = displayLUT[2][p[2]];
+    }
+    p += 3;
+    q += 3;
+  }
+  return outBuf;
+}
+
+// Convert one band of the rectangle described by <cvt>.
+void XPDFCore::convertBand(XPDFCoreConvert *cvt, int band) {
+  SplashColorPtr rgbBuf, outBuf, p;
+  Guchar *quant;
+  unsigned long pixel;
+  XImage *image;
+  int width, height, x, y, y0, y1, r, g, b, gray;
+  int *errDownR, *errDownG, *errDownB;
+  int *errInR, *errInG, *errInB;
+  int errRightR, errRightG, errRightB;
+  int errDownRightR, errDownRightG, errDownRightB;
+  int r0, g0, b0, re, ge, be;
+  int x0, x1, need, nSlots;
+
+  width = cvt->width;
+  height = cvt->height;
+  image = cvt->image;
+  rgbBuf = cvt->rowBufs + band * 6 * width;
+  outBuf = rgbBuf + 3 * width;
+
+  //~ optimize for known XImage formats
+  if (trueColor) {
+    y0 = (height * band) / cvt->nBands;
+    y1 = (height * (band + 1)) / cvt->nBands;
+    for (y = y0; y < y1; ++y) {
+      p = getDisplayRow(cvt, y, rgbBuf, outBuf);
       for (x = 0; x < width; ++x) {
-	r = splashRGB8R(p);
-	g = splashRGB8G(p);
-	b = splashRGB8B(p);
-	if (ap) {
-	  alpha = *ap++;
-	  alpha1 = 255 - alpha;
-	  r = div255(alpha1 * paperColor[0] + alpha * r);
-	  g = div255(alpha1 * paperColor[1] + alpha * g);
-	  b = div255(alpha1 * paperColor[2] + alpha * b);
-	}
-	r >>= rDiv;
-	g >>= gDiv;
-	b >>= bDiv;
+	r = splashRGB8R(p) >> rDiv;
+	g = splashRGB8G(p) >> gDiv;
+	b = splashRGB8B(p) >> bDiv;
 	pixel = ((unsigned long)r << rShift) +
 	        ((unsigned long)g << gShift) +
 	        ((unsigned long)b << bShift);
-	XPutPixel(image, xSrc + x, ySrc + y, pixel);
+	XPutPixel(image, cvt->xImg + x, cvt->yImg + y, pixel);
 	p += 3;
       }
     }
-  } else if (rgbCubeSize == 1) {
-    //~ this should really use splashModeMono, with non-clustered dithering
-    for (y = 0; y < height; ++y) {
-      p = dataPtr + (ySrc + y) * bw + xSrc * 3;
-      if (!composited && tile->bitmap->getAlphaPtr()) {
-	ap = tile->bitmap->getAlphaPtr() +
-	       (ySrc + y) * tile->bitmap->getWidth() + xSrc;
-      } else {
-	ap = NULL;
+  } else if (orderedDither) {
+    // every pixel is independent, so this uses contiguous bands, like
+    // the TrueColor case
+    y0 = (height * band) / cvt->nBands;
+    y1 = (height * (band + 1)) / cvt->nBands;
+    for (y = y0; y < y1; ++y) {
+      p = getDisplayRow(cvt, y, rgbBuf, outBuf);
+      for (x = 0; x < width; ++x) {
+	quant = orderedQuant[((y & 7) << 3) + (x & 7)];
+	if (rgbCubeSize == 1) {
+	  gray = (19595 * splashRGB8R(p) + 38470 * splashRGB8G(p) +
+		  7471 * splashRGB8B(p) + 0x8000) >> 16;
+	  pixel = colors[quant[gray]];
+	} else {
+	  pixel = colors[(quant[splashRGB8R(p)] * rgbCubeSize +
+			  quant[splashRGB8G(p)]) * rgbCubeSize +
+			 quant[splashRGB8B(p)]];
+	}
+	XPutPixel(image, cvt->xImg + x, cvt->yImg + y, pixel);
+	p += 3;
       }
+    }
+  } else if (rgbCubeSize == 1) {
+    // monochrome display (the bitmaps are halftoned by Splash, so this
+    // is only a threshold)
+    y0 = (height * band) / cvt->nBands;
+    y1 = (height * (band + 1)) / cvt->nBands;
+    for (y = y0; y < y1; ++y) {
+      p = getDisplayRow(cvt, y, rgbBuf, outBuf);
       for (x = 0; x < width; ++x) {
 	r = splashRGB8R(p);
 	g = splashRGB8G(p);
 	b = splashRGB8B(p);
-	if (ap) {
-	  alpha = *ap++;
-	  alpha1 = 255 - alpha;
-	  r = div255(alpha1 * paperColor[0] + alpha * r);
-	  g = div255(alpha1 * paperColor[1] + alpha * g);
-	  b = div255(alpha1 * paperColor[2] + alpha * b);
-	}
 	gray = (int)(0.299 * r + 0.587 * g + 0.114 * b + 0.5);
 	if (gray < 128) {
 	  pixel = colors[0];
 	} else {
 	  pixel = colors[1];
 	}
-	XPutPixel(image, xSrc + x, ySrc + y, pixel);
+	XPutPixel(image, cvt->xImg + x, cvt->yImg + y, pixel);
 	p += 3;
       }
     }
   } else {
-    // do Floyd-Steinberg dithering on the whole bitmap
-    errDownR = (int *)gmallocn(width + 2, sizeof(int));
-    errDownG = (int *)gmallocn(width + 2, sizeof(int));
-    errDownB = (int *)gmallocn(width + 2, sizeof(int));
-    errRightR = errRightG = errRightB = 0;
-    errDownRightR = errDownRightG = errDownRightB = 0;
-    memset(errDownR, 0, (width + 2) * sizeof(int));
-    memset(errDownG, 0, (width + 2) * sizeof(int));
-    memset(errDownB, 0, (width + 2) * sizeof(int));
-    for (y = 0; y < height; ++y) {
-      p = dataPtr + (ySrc + y) * bw + xSrc * 3;
-      if (!composited && tile->bitmap->getAlphaPtr()) {
-	ap = tile->bitmap->getAlphaPtr() +
-	       (ySrc + y) * tile->bitmap->getWidth() + xSrc;
-      } else {
-	ap = NULL;
-      }
-      for (x = 0; x < width; ++x) {
-	r = splashRGB8R(p);
-	g = splashRGB8G(p);
-	b = splashRGB8B(p);
-	if (ap) {
-	  alpha = *ap++;
-	  alpha1 = 255 - alpha;
-	  r = div255(alpha1 * paperColor[0] + alpha * r);
-	  g = div255(alpha1 * paperColor[1] + alpha * g);
-	  b = div255(alpha1 * paperColor[2] + alpha * b);
-	}
-	r0 = r + errRightR + errDownR[x+1];
-	g0 = g + errRightG + errDownG[x+1];
-	b0 = b + errRightB + errDownB[x+1];
-	if (r0 < 0) {
-	  r = 0;
-	} else if (r0 >= 255) {
-	  r = rgbCubeSize - 1;
-	} else {
-	  r = div255(r0 * (rgbCubeSize - 1));
+    // Floyd-Steinberg dithering: row y adds its error to error row
+    // (y mod nSlots), and reads the error left by row y-1 -- before
+    // converting pixel x, it waits until row y-1 has finished pixel
+    // x+1, which is the last one to add to that entry
+    nSlots = cvt->nBands + 1;
+    for (y = band; y < height; y += cvt->nBands) {
+      p = getDisplayRow(cvt, y, rgbBuf, outBuf);
+      errDownR = cvt->errDown + 3 * (y % nSlots) * (width + 2);
+      errDownG = errDownR + (width + 2);
+      errDownB = errDownG + (width + 2);
+      errInR = cvt->errDown + 3 * ((y + nSlots - 1) % nSlots) * (width + 2);
+      errInG = errInR + (width + 2);
+      errInB = errInG + (width + 2);
+      errRightR = errRightG = errRightB = 0;
+      errDownRightR = errDownRightG = errDownRightB = 0;
+      for (x0 = 0; x0 < width; x0 = x1) {
+	x1 = x0 + convertDitherChunk;
+	if (x1 > width) {
+	  x1 = width;
 	}
-	if (g0 < 0) {
-	  g = 0;
-	} else if (g0 >= 255) {
-	  g = rgbCubeSize - 1;
-	} else {
-	  g = div255(g0 * (rgbCubeSize - 1));
+	if (y > 0) {
+	  need = x1 + 1 < width ? x1 + 1 : width;
+	  while (__atomic_load_n(&cvt->progress[y - 1], __ATOMIC_ACQUIRE)
+		 < need) {
+	    sched_yield();
+	  }
 	}
-	if (b0 < 0) {
-	  b = 0;
-	} else if (b0 >= 255) {
-	  b = rgbCubeSize - 1;
-	} else {
-	  b = div255(b0 * (rgbCubeSize - 1));
+	for (x = x0; x < x1; ++x) {
+	  r0 = splashRGB8R(p) + errRightR + errInR[x+1];
+	  g0 = splashRGB8G(p) + errRightG + errInG[x+1];
+	  b0 = splashRGB8B(p) + errRightB + errInB[x+1];
+	  r = r0 < 0 ? 0 : r0 > 255 ? rgbCubeSize - 1 : cubeQuant[r0];
+	  g = g0 < 0 ? 0 : g0 > 255 ? rgbCubeSize - 1 : cubeQuant[g0];
+	  b = b0 < 0 ? 0 : b0 > 255 ? rgbCubeSize - 1 : cubeQuant[b0];
+	  re = r0 - cubeLevel[r];
+	  ge = g0 - cubeLevel[g];
+	  be = b0 - cubeLevel[b];
+	  errRightR = (re * 7) >> 4;
+	  errRightG = (ge * 7) >> 4;
+	  errRightB = (be * 7) >> 4;
+	  errDownR[x] += (re * 3) >> 4;
+	  errDownG[x] += (ge * 3) >> 4;
+	  errDownB[x] += (be * 3) >> 4;
+	  errDownR[x+1] = ((re * 5) >> 4) + errDownRightR;
+	  errDownG[x+1] = ((ge * 5) >> 4) + errDownRightG;
+	  errDownB[x+1] = ((be * 5) >> 4) + errDownRightB;
+	  errDownRightR = re >> 4;
+	  errDownRightG = ge >> 4;
+	  errDownRightB = be >> 4;
+	  pixel = colors[(r * rgbCubeSize + g) * rgbCubeSize + b];
+	  XPutPixel(image, cvt->xImg + x, cvt->yImg + y, pixel);
+	  p += 3;
 	}
-	re = r0 - ((r << 8) - r) / (rgbCubeSize - 1);
-	ge = g0 - ((g << 8) - g) / (rgbCubeSize - 1);
-	be = b0 - ((b << 8) - b) / (rgbCubeSize - 1);
-	errRightR = (re * 7) >> 4;
-	errRightG = (ge * 7) >> 4;
-	errRightB = (be * 7) >> 4;
-	errDownR[x] += (re * 3) >> 4;
-	errDownG[x] += (ge * 3) >> 4;
-	errDownB[x] += (be * 3) >> 4;
-	errDownR[x+1] = ((re * 5) >> 4) + errDownRightR;
-	errDownG[x+1] = ((ge * 5) >> 4) + errDownRightG;
-	errDownB[x+1] = ((be * 5) >> 4) + errDownRightB;
-	errDownRightR = re >> 4;
-	errDownRightG = ge >> 4;
-	errDownRightB = be >> 4;
-	pixel = colors[(r * rgbCubeSize + g) * rgbCubeSize + b];
-	XPutPixel(image, xSrc + x, ySrc + y, pixel);
-	p += 3;
+	__atomic_store_n(&cvt->progress[y], x1, __ATOMIC_RELEASE);
       }
     }
-    gfree(errDownR);
-    gfree(errDownG);
-    gfree(errDownB);
   }
 }
 
+// With a dithered color cube, a uniform area is only drawn as a
+// single pixel value if its color is exactly one of the cube colors.
+bool XPDFCore::canFillTile(SplashColorPtr color) {
+  int i;
+
+  if (trueColor || rgbCubeSize == 1) {
+    return true;
+  }
+  for (i = 0; i < 3; ++i) {
+    if ((displayLUT[i][color[i]] * (rgbCubeSize - 1)) % 255) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void XPDFCore::redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
 			  int xDest, int yDest, int width, int height,
 			  bool composited) {
   XPDFCoreTile *tile = (XPDFCoreTile *)tileA;
   Window drawAreaWin;
   XGCValues gcValues;
+  XImage *image;
 
   // create a GC for the drawing area
   drawAreaWin = XtWindow(drawArea);
@@ -1331,11 +1905,28 @@ void XPDFCore::redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
 
   // draw the document
   if (tile) {
-    if (tile->image)
-    XPutImage(display, drawAreaWin, drawAreaGC, tile->image,
-	      xSrc, ySrc, xDest, yDest, width, height);
-    else
+    if (tile->solid) {
+      XSetForeground(display, drawAreaGC, tile->solidPixel);
+      XFillRectangle(display, drawAreaWin, drawAreaGC,
+		     xDest, yDest, width, height);
+      XSetForeground(display, drawAreaGC, mattePixel);
+    } else if (tile->bitmap && tile->bitmap->getMode() != colorMode) {
+      image = XCreateImage(display, visual, depth, ZPixmap, 0, NULL,
+			   width, height, 8, 0);
+      image->data = (char *)bufPool->alloc(height * image->bytes_per_line);
+      convertBitmap(tile->bitmap, xSrc, ySrc, width, height, composited,
+		    image, 0, 0);
+      XPutImage(display, drawAreaWin, drawAreaGC, image,
+		0, 0, xDest, yDest, width, height);
+      bufPool->release(image->data);
+      image->data = NULL;
+      XDestroyImage(image);
+    } else if (tile->image) {
+      XPutImage(display, drawAreaWin, drawAreaGC, tile->image,
+		xSrc, ySrc, xDest, yDest, width, height);
+    } else {
       error(errInternal, -1, "tile->image NULL in tile @ %p", tile);
+    }
 
   // draw the background
   } else {
@@ -1498,6 +2089,123 @@ void XPDFCore::dialogCancelCbk(Widget widget, XtPointer ptr,
   core->dialogDone = -1;
 }
 
+//------------------------------------------------------------------------
+// "loading" dialog
+//------------------------------------------------------------------------
+
+void XPDFCore::initLoadDialog() {
+  Arg args[20];
+  int n;
+  XmString s;
+
+  n = 0;
+  s = XmStringCreateLocalized(xpdfAppName ": Loading");
+  XtSetArg(args[n], XmNdialogTitle, s); ++n;
+  XtSetArg(args[n], XmNdialogStyle, XmDIALOG_PRIMARY_APPLICATION_MODAL); ++n;
+  loadDialog = XmCreateWorkingDialog(drawArea, "loadDialog", args, n);
+  XmStringFree(s);
+  XtUnmanageChild(XmMessageBoxGetChild(loadDialog, XmDIALOG_OK_BUTTON));
+  XtUnmanageChild(XmMessageBoxGetChild(loadDialog, XmDIALOG_HELP_BUTTON));
+  XtAddCallback(loadDialog, XmNcancelCallback,
+		&loadCancelCbk, (XtPointer)this);
+}
+
+// Wait for the loader thread from the event loop: docLoaderDoneCbk
+// finishes the open.  If it takes a while, put up a dialog showing the
+// progress, with a button to cancel the open (leaving the current
+// document in place).
+void XPDFCore::docLoaderStarted() {
+  XtAppContext appContext;
+  int fd;
+
+  // the first file is loaded before the window is up
+  if (!XtIsRealized(drawArea)) {
+    PDFCore::docLoaderStarted();
+    return;
+  }
+
+  appContext = XtWidgetToApplicationContext(drawArea);
+  if ((fd = docLoader->getDoneFD()) >= 0) {
+    loadInput = XtAppAddInput(appContext, fd, (XtPointer)XtInputReadMask,
+			      &docLoaderDoneCbk, this);
+  }
+  // most files open quickly -- don't flash the dialog up for those
+  loadTimer = XtAppAddTimeOut(appContext, loadDialogDelay,
+			      &loadTimerCbk, this);
+}
+
+void XPDFCore::docLoaderDoneCbk(XtPointer ptr, int *source, XtInputId *id) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  // the pipe is closed along with the loader
+  XtRemoveInput(core->loadInput);
+  core->loadInput = 0;
+  core->finishLoadFile();
+}
+
+void XPDFCore::cancelLoadFile() {
+  if (loadInput) {
+    XtRemoveInput(loadInput);
+    loadInput = 0;
+  }
+  PDFCore::cancelLoadFile();
+}
+
+void XPDFCore::loadFileDone(int err) {
+  if (loadTimer) {
+    XtRemoveTimeOut(loadTimer);
+    loadTimer = 0;
+  }
+  XtUnmanageChild(loadDialog);
+  if (err == errNone) {
+    fileOpened();
+  }
+}
+
+void XPDFCore::setLoadDialogMsg() {
+  GooString *msg;
+  double progress;
+  char buf[16];
+  Arg args[2];
+  XmString s;
+
+  msg = new GooString("Loading ");
+  msg->append(docLoader->getFileName());
+  msg->append("...");
+  if ((progress = docLoader->getProgress()) >= 0) {
+    sprintf(buf, " %d%%", (int)(progress * 100));
+    msg->append(buf);
+  }
+  s = XmStringCreateLocalized(msg->getCString());
+  XtSetArg(args[0], XmNmessageString, s);
+  XtSetValues(loadDialog, args, 1);
+  XmStringFree(s);
+  delete msg;
+}
+
+void XPDFCore::loadTimerCbk(XtPointer ptr, XtIntervalId *id) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  core->loadTimer = 0;
+  // without the loader's pipe, the thread has to be polled
+  if (!core->loadInput && core->docLoader->isDone()) {
+    core->finishLoadFile();
+    return;
+  }
+  core->setLoadDialogMsg();
+  XtManageChild(core->loadDialog);
+  core->loadTimer =
+      XtAppAddTimeOut(XtWidgetToApplicationContext(core->drawArea),
+		      loadDialogUpdate, &loadTimerCbk, core);
+}
+
+void XPDFCore::loadCancelCbk(Widget widget, XtPointer ptr,
+			     XtPointer callData) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  core->cancelLoadFile();
+}
+
 //------------------------------------------------------------------------
 // password dialog
 //------------------------------------------------------------------------
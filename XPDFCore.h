@@ -26,6 +26,7 @@ class GooString;
 class BaseStream;
 class PDFDoc;
 class LinkAction;
+struct XPDFCoreConvert;
 
 //------------------------------------------------------------------------
 
@@ -74,6 +75,9 @@ public:
   // Load an already-created PDFDoc object.
   virtual void loadDoc(PDFDoc *docA);
 
+  // Cancel the open started by loadFileAsync, if any.
+  virtual void cancelLoadFile();
+
   // Resize the window to fit page <pg> of the current document.
   void resizeToPage(int pg);
 
@@ -89,6 +93,10 @@ public:
   virtual bool goForward();
   virtual bool goBackward();
 
+  //----- interactive rendering
+
+  virtual void startInteraction();
+
   //----- selection
 
   void startSelection(int wx, int wy);
@@ -142,7 +150,13 @@ public:
 
 private:
 
+  void fileOpened();
   virtual bool checkForNewFile();
+  void watchFile(GooString *fileName);
+  static void fileChangeCbk(XtPointer ptr, int *source, XtInputId *id);
+  static void reloadTimerCbk(XtPointer ptr, XtIntervalId *id);
+  virtual bool wantPageFingerprints();
+  static Boolean fingerprintWorkProc(XtPointer ptr);
 
   //----- hyperlinks
   void runCommand(GooString *cmdFmt, GooString *arg);
@@ -155,6 +169,7 @@ private:
 
   //----- GUI code
   void setupX(bool installCmap, int rgbCubeSizeA);
+  void initDitherTables();
   void initWindow();
   static void hScrollChangeCbk(Widget widget, XtPointer ptr,
 			       XtPointer callData);
@@ -167,9 +182,30 @@ private:
   static void resizeCbk(Widget widget, XtPointer ptr, XtPointer callData);
   static void redrawCbk(Widget widget, XtPointer ptr, XtPointer callData);
   static void inputCbk(Widget widget, XtPointer ptr, XtPointer callData);
+  static void idleTimerCbk(XtPointer ptr, XtIntervalId *id);
+  void startProgressiveTimer();
+  static void progressiveTimerCbk(XtPointer ptr, XtIntervalId *id);
+  virtual void docLoaderStarted();
+  static void docLoaderDoneCbk(XtPointer ptr, int *source, XtInputId *id);
+  virtual void loadFileDone(int err);
+  void setLoadDialogMsg();
+  static void loadTimerCbk(XtPointer ptr, XtIntervalId *id);
+  static void loadCancelCbk(Widget widget, XtPointer ptr,
+			    XtPointer callData);
   virtual PDFCoreTile *newTile(int xDestA, int yDestA);
   virtual void updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
 			      int width, int height, bool composited);
+  void convertBitmap(SplashBitmap *bitmap, int xSrc, int ySrc,
+		     int width, int height, bool composited,
+		     XImage *image, int xImg, int yImg);
+  void convertMono1(SplashBitmap *bitmap, int xSrc, int ySrc,
+		    int width, int height,
+		    XImage *image, int xImg, int yImg);
+  static void convertBitmapBand(void *data, int band);
+  SplashColorPtr getDisplayRow(XPDFCoreConvert *cvt, int y,
+			       SplashColorPtr rgbBuf, SplashColorPtr outBuf);
+  void convertBand(XPDFCoreConvert *cvt, int band);
+  virtual bool canFillTile(SplashColorPtr color);
   virtual void redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
 			  int xDest, int yDest, int width, int height,
 			  bool composited);
@@ -181,6 +217,7 @@ private:
 			  XtPointer callData);
   static void dialogCancelCbk(Widget widget, XtPointer ptr,
 			      XtPointer callData);
+  void initLoadDialog();
   void initPasswordDialog();
   static void passwordTextVerifyCbk(Widget widget, XtPointer ptr,
 				    XtPointer callData);
@@ -205,6 +242,12 @@ private:
   int rgbCubeSize;              // size of color cube (for non-TrueColor)
   unsigned long                        // color cube (for non-TrueColor)
     colors[xMaxRGBCube * xMaxRGBCube * xMaxRGBCube];
+  Guchar cubeQuant[256];	// component value -> color cube index
+  int cubeLevel[xMaxRGBCube];	// color cube index -> component value
+  bool orderedDither;		// use ordered dithering, instead of
+				//   Floyd-Steinberg?
+  Guchar orderedQuant[64][256];	// ordered dithering: [matrix position]
+				//   [component value] -> cube index
 
   Widget shell;			// top-level shell containing the widget
   Widget parentWidget;		// parent widget (not created by XPDFCore)
@@ -224,7 +267,25 @@ private:
   bool panning;
   int panMX, panMY;
 
+  XtIntervalId idleTimer;	// fires when scroll/zoom input goes idle
+  XtIntervalId progressiveTimer;	// polls a document that is still
+					//   arriving
+  XtIntervalId loadTimer;	// puts up, and updates, the "loading"
+				//   dialog
+  XtInputId loadInput;		// waits for the loader thread to finish
+
   time_t modTime;		// last modification time of PDF file
+  bool fileChanged;		// set when a change to the PDF file is
+				//   detected (with inotify)
+  int inotifyFD;		// inotify instance (-1 if unavailable)
+  XtInputId inotifyInput;
+  int watchDesc;		// watch on the PDF file's directory (-1
+				//   if none)
+  GooString *watchName;		// name of the PDF file in that directory
+  XtIntervalId reloadTimer;	// reloads the PDF file once the writes
+				//   to it stop
+  XtWorkProcId fingerprintProc;	// fingerprints the displayed pages
+				//   when there are no events to handle
 
   LinkAction *linkAction;	// mouse cursor is over this link
 
@@ -242,6 +303,8 @@ private:
 
   int dialogDone;
 
+  Widget loadDialog;
+
   Widget passwordDialog;
   Widget passwordText;
   GooString *password;
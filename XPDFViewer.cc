@@ -205,6 +205,7 @@ XPDFViewerCmd XPDFViewer::cmdTab[] = {
   { "prevPage",                0, true,  false, &XPDFViewer::cmdPrevPage },
   { "prevPageNoScroll",        0, true,  false, &XPDFViewer::cmdPrevPageNoScroll },
   { "print",                   0, true,  false, &XPDFViewer::cmdPrint },
+  { "printStats",              0, false, false, &XPDFViewer::cmdPrintStats },
   { "quit",                    0, false, false, &XPDFViewer::cmdQuit },
   { "raise",                   0, false, false, &XPDFViewer::cmdRaise },
   { "redraw",                  0, true,  false, &XPDFViewer::cmdRedraw },
@@ -230,6 +231,7 @@ XPDFViewerCmd XPDFViewer::cmdTab[] = {
   { "toggleContinuousMode",    0, false, false, &XPDFViewer::cmdToggleContinuousMode },
   { "toggleFullScreenMode",    0, false, false, &XPDFViewer::cmdToggleFullScreenMode },
   { "toggleOutline",           0, false, false, &XPDFViewer::cmdToggleOutline },
+  { "toggleReverseVideo",      0, false, false, &XPDFViewer::cmdToggleReverseVideo },
   { "windowMode",              0, false, false, &XPDFViewer::cmdWindowMode },
   { "zoomFitPage",             0, false, false, &XPDFViewer::cmdZoomFitPage },
   { "zoomFitWidth",            0, false, false, &XPDFViewer::cmdZoomFitWidth },
@@ -270,7 +272,7 @@ XPDFViewer::XPDFViewer(XPDFApp *appA, GooString *fileName,
     if (loadFile(fileName, ownerPassword, userPassword)) {
       getPageAndDest(pageA, destName, &pg, &dest);
 #ifndef DISABLE_OUTLINE
-      if (outlineScroll != None &&
+      if (outlineScroll != None && !core->isLoadingProgressively() &&
 	  core->getDoc()->getOutline()->getItems() &&
 	  core->getDoc()->getOutline()->getItems()->getLength() > 0) {
 	XtVaSetValues(outlineScroll, XmNwidth, outlinePaneWidth, NULL);
@@ -370,10 +372,11 @@ void XPDFViewer::open(GooString *fileName, int pageA, GooString *destName) {
   int pg;
   double z;
 
+  // the page/destination is displayed once the file has been opened
   if (!core->getDoc() || fileName->cmp(core->getDoc()->getFileName())) {
-    if (!loadFile(fileName, NULL, NULL)) {
-      return;
-    }
+    core->loadFileAsync(fileName, pageA, NULL,
+			destName ? destName->copy() : NULL, true);
+    return;
   }
   getPageAndDest(pageA, destName, &pg, &dest);
   z = core->getZoom();
@@ -427,17 +430,11 @@ bool XPDFViewer::loadFile(GooString *fileName, GooString *ownerPassword,
 }
 
 void XPDFViewer::reloadFile() {
-  int pg;
-
   if (!core->getDoc()) {
     return;
   }
-  pg = core->getPageNum();
-  loadFile(core->getDoc()->getFileName());
-  if (pg > core->getDoc()->getNumPages()) {
-    pg = core->getDoc()->getNumPages();
-  }
-  displayPage(pg, core->getZoom(), core->getRotate(), false, false);
+  core->loadFileAsync(core->getDoc()->getFileName(), core->getPageNum(),
+		      NULL, NULL, false);
 }
 
 void XPDFViewer::displayPage(int pageA, double zoomA, int rotateA,
@@ -1041,6 +1038,11 @@ void XPDFViewer::cmdPrint(GooString *args[], int nArgs,
   XtManageChild(printDialog);
 }
 
+void XPDFViewer::cmdPrintStats(GooString *args[], int nArgs,
+			       XEvent *event) {
+  core->printStats(stdout);
+}
+
 void XPDFViewer::cmdQuit(GooString *args[], int nArgs,
 			 XEvent *event) {
   app->quit();
@@ -1299,6 +1301,20 @@ void XPDFViewer::cmdToggleOutline(GooString *args[], int nArgs,
 #endif
 }
 
+// Switch to or from reverse video.  The paper color is inverted too,
+// so the default white paper becomes black (as with the -rv option).
+void XPDFViewer::cmdToggleReverseVideo(GooString *args[], int nArgs,
+				       XEvent *event) {
+  SplashColor paperColor;
+  SplashColorPtr p;
+
+  p = core->getPaperColor();
+  paperColor[0] = 0xff - p[0];
+  paperColor[1] = 0xff - p[1];
+  paperColor[2] = 0xff - p[2];
+  core->setReverseVideo(!core->getReverseVideo(), paperColor);
+}
+
 void XPDFViewer::cmdWindowMode(GooString *args[], int nArgs,
 			       XEvent *event) {
   PDFDoc *doc;
@@ -1342,6 +1358,7 @@ void XPDFViewer::cmdZoomIn(GooString *args[], int nArgs,
   int z = getZoomIdx();
 
   if (z <= minZoomIdx && z > maxZoomIdx) {
+    core->startInteraction();
     --z;
     setZoomIdx(z);
     displayPage(core->getPageNum(), zoomMenuInfo[z].zoom,
@@ -1355,6 +1372,7 @@ void XPDFViewer::cmdZoomOut(GooString *args[], int nArgs,
   int z = getZoomIdx();
 
   if (z < minZoomIdx && z >= maxZoomIdx) {
+    core->startInteraction();
     ++z;
     setZoomIdx(z);
     displayPage(core->getPageNum(), zoomMenuInfo[z].zoom,
@@ -2632,7 +2650,9 @@ void XPDFViewer::setupOutline() {
     outlineLabelsLength = outlineLabelsSize = 0;
   }
 
-  if (core->getDoc()) {
+  // the outline of a document that is still arriving is set up once
+  // all of its data is there
+  if (core->getDoc() && !core->isLoadingProgressively()) {
 
     // create the new labels
     items = core->getDoc()->getOutline()->getItems();
@@ -2894,10 +2914,7 @@ void XPDFViewer::openOkCbk(Widget widget, XtPointer ptr,
     if (viewer->openInNewWindow) {
       viewer->app->open(fileNameStr);
     } else {
-      if (viewer->loadFile(fileNameStr)) {
-	viewer->displayPage(1, viewer->core->getZoom(),
-			    viewer->core->getRotate(), true, true);
-      }
+      viewer->core->loadFileAsync(fileNameStr, 1, NULL, NULL, true);
     }
     delete fileNameStr;
     XtFree(charSet);
@@ -135,6 +135,7 @@ private:
   void cmdPrevPage(GooString *args[], int nArgs, XEvent *event);
   void cmdPrevPageNoScroll(GooString *args[], int nArgs, XEvent *event);
   void cmdPrint(GooString *args[], int nArgs, XEvent *event);
+  void cmdPrintStats(GooString *args[], int nArgs, XEvent *event);
   void cmdQuit(GooString *args[], int nArgs, XEvent *event);
   void cmdRaise(GooString *args[], int nArgs, XEvent *event);
   void cmdRedraw(GooString *args[], int nArgs, XEvent *event);
@@ -160,6 +161,7 @@ private:
   void cmdToggleContinuousMode(GooString *args[], int nArgs, XEvent *event);
   void cmdToggleFullScreenMode(GooString *args[], int nArgs, XEvent *event);
   void cmdToggleOutline(GooString *args[], int nArgs, XEvent *event);
+  void cmdToggleReverseVideo(GooString *args[], int nArgs, XEvent *event);
   void cmdWindowMode(GooString *args[], int nArgs, XEvent *event);
   void cmdZoomFitPage(GooString *args[], int nArgs, XEvent *event);
   void cmdZoomFitWidth(GooString *args[], int nArgs, XEvent *event);
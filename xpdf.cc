@@ -7,6 +7,10 @@
 //========================================================================
 
 #include <poppler-config.h>
+#include <stdlib.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #include "poppler/goo/GooString.h"
 #include "parseargs.h"
 #include "poppler/goo/gfile.h"
@@ -225,6 +229,17 @@ int main(int argc, char *argv[]) {
     globalParamsGUI->setErrQuiet(quiet);
   }
 
+#ifdef __GLIBC__
+  // tile bitmaps are allocated by Splash with malloc; a fixed mmap
+  // threshold (instead of glibc's adaptive one) keeps the big ones
+  // mapped separately -- but it affects every allocation in the
+  // process, so it is only set if requested
+  if (globalParamsGUI->getMallocMmapThreshold() > 0) {
+    mallopt(M_MMAP_THRESHOLD,
+	    globalParamsGUI->getMallocMmapThreshold() * 1024);
+  }
+#endif
+
   // create the XPDFApp object
   app = new XPDFApp(&argc, argv);
 